@@ -65,8 +65,33 @@ const unsigned long SERIAL_BAUDRATE = 115200;
 // MIDI configuration
 const unsigned long MIDI_BAUDRATE = 31250;
 const int MIDI_SETTINGS_EEPROM_ADDR = 0;
+// Control ticks between handling the coalesced CC, pitch bend and aftertouch values.
+// At 1 they are handled every tick (~1 ms at MOZZI_CONTROL_RATE 1024). Larger values
+// save handler calls on dense controller streams and add that many ticks of latency.
+const uint8_t MIDI_CONTROLLER_FLUSH_TICKS = 1;
 
 // EEPROM
 const size_t EEPROM_SIZE = 64;
 
+// Task topology: audio/MIDI owns one core, UI, display and persistence run on the other
+const int AUDIO_TASK_CORE = 1;
+const int AUDIO_TASK_PRIORITY = 5;
+const int UI_TASK_CORE = 0;
+const int UI_TASK_PRIORITY = 1;
+const uint32_t UI_TASK_STACK_SIZE = 8192;
+const uint32_t UI_FRAME_MS = 20; // Default frame cap of a screen, 50 fps
+const uint32_t UI_REFRESH_MS = 100; // Default update interval of a screen without input or settings changes
+const uint32_t STORE_TASK_STACK_SIZE = 4096; // Settings persistence, runs next to the UI task
+const int SETTINGS_TASK_PRIORITY = 3; // Applies preset and tempo requests of the audio task, above UI, display and store
+const uint32_t SETTINGS_TASK_STACK_SIZE = 3072;
+const int DISPLAY_TASK_PRIORITY = 2; // Above the UI task, so a presented frame goes out at once
+const uint32_t DISPLAY_TASK_STACK_SIZE = 3072;
+// The 400 kHz fast mode of the SSD1306 datasheet. Faster rates have not been
+// measured on the module, raise it only after checking the picture and frame times.
+const uint32_t DISPLAY_I2C_CLOCK = 400000;
+
 const bool DEBUG_MIDI_PROCESSOR = false;
+const bool DEBUG_TASK_LOAD = false; // Print per-task CPU load every TASK_LOAD_REPORT_MS
+const bool DEBUG_FRAME_TIMES = false; // Print display frame counts and send times every TASK_LOAD_REPORT_MS
+const bool DEBUG_UI_REDRAW_ALWAYS = false; // Redraw every UI_FRAME_MS like before redraw on change, to measure against it
+const unsigned long TASK_LOAD_REPORT_MS = 2000;
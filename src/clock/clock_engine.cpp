@@ -0,0 +1,253 @@
+#include "clock_engine.h"
+
+ClockEngine::ClockEngine() {
+    bpm = 0;
+    internal = true;
+    interval_q16 = 0;
+    next_tick_q16 = 0;
+    tick_count = 0;
+    tick_events = 0;
+    external_count = 0;
+    external_time_us = 0;
+    predicting = false;
+    output_mask = 0;
+    gate_mask = 0;
+    changed_mask = 0;
+
+    for (size_t i = 0; i < MAX_OUTPUTS; i++) {
+        outputs[i].mul = 0;
+        outputs[i].div = 0;
+        outputs[i].offset = 0;
+        outputs[i].pulse_us = 0;
+        outputs[i].next_pos = 0;
+        outputs[i].gate_on_us = NO_EVENT;
+        outputs[i].gate_off_us = 0;
+    }
+
+    set_bpm(120);
+}
+
+void ClockEngine::set_bpm(float new_bpm) {
+    if (new_bpm <= 0) return;
+
+    uint64_t last_tick_q16 = next_tick_q16 - interval_q16;
+
+    bpm = new_bpm;
+    // 60 s per minute in 1/65536 us units, divided by ticks per minute
+    interval_q16 = (uint64_t)(60e6 * (double)(1 << FRAC_BITS) / ((double)new_bpm * PPQN) + 0.5);
+
+    // Keep the last tick, the next one follows at the new interval
+    if (tick_count > 0) {
+        next_tick_q16 = last_tick_q16 + interval_q16;
+    }
+}
+
+void ClockEngine::set_internal(bool new_internal, uint64_t now_us) {
+    if (internal == new_internal) return;
+    internal = new_internal;
+    predicting = false;
+    reset(now_us);
+}
+
+void ClockEngine::set_output(size_t idx, uint8_t mul, uint8_t div, uint32_t offset, uint32_t pulse_us) {
+    if (idx >= MAX_OUTPUTS) return;
+
+    uint32_t bit = 1u << idx;
+    Output& output = outputs[idx];
+    output.pulse_us = pulse_us;
+
+    if (mul == 0 || div == 0) {
+        // The output is owned by someone else now, forget its gate without reporting it
+        output.mul = 0;
+        output.gate_on_us = NO_EVENT;
+        output_mask &= ~bit;
+        gate_mask &= ~bit;
+        changed_mask &= ~bit;
+        return;
+    }
+
+    offset %= get_period_units(div);
+    if (!(output_mask & bit) || output.mul != mul || output.div != div || output.offset != offset) {
+        output.mul = mul;
+        output.div = div;
+        output.offset = offset;
+        output.gate_on_us = NO_EVENT;
+        align_output(output);
+    }
+    output_mask |= bit;
+}
+
+void ClockEngine::align_output(Output& output) {
+    // First pulse at or after the current tick
+    uint64_t period = get_period_units(output.div);
+    uint64_t pos = (uint64_t)tick_count * output.mul;
+    uint64_t n = (pos > output.offset) ? (pos - output.offset + period - 1) / period : 0;
+    output.next_pos = output.offset + n * period;
+}
+
+void ClockEngine::reset(uint64_t now_us) {
+    locate(0, now_us);
+}
+
+void ClockEngine::locate(uint32_t tick, uint64_t now_us) {
+    tick_count = tick;
+    external_count = tick;
+    predicting = false; // The first tick after a locate is never predicted
+    next_tick_q16 = now_us << FRAC_BITS;
+    changed_mask |= gate_mask;
+    gate_mask = 0;
+
+    for (uint32_t mask = output_mask; mask != 0; mask &= mask - 1) {
+        Output& output = outputs[__builtin_ctz(mask)];
+        output.gate_on_us = NO_EVENT;
+        align_output(output);
+    }
+}
+
+void ClockEngine::external_tick(uint64_t arrival_us, uint64_t tick_time_us, uint64_t new_interval_q16, bool locked) {
+    if (internal) return;
+
+    external_count++;
+    predicting = locked;
+    // A locked tick that beat its prediction fires at its filtered time, never before it arrived
+    external_time_us = (locked && tick_time_us > arrival_us) ? tick_time_us : arrival_us;
+    if (new_interval_q16 > 0) {
+        interval_q16 = new_interval_q16;
+    }
+
+    // Next prediction follows the filtered time of this tick
+    next_tick_q16 = (tick_time_us << FRAC_BITS) + interval_q16;
+}
+
+uint32_t ClockEngine::get_pulse_us(const Output& output) const {
+    // Half the output period, so consecutive pulses never merge
+    uint64_t half_period = ((interval_q16 * get_period_units(output.div) / output.mul) >> FRAC_BITS) / 2;
+    if (half_period == 0) half_period = 1;
+    return output.pulse_us < half_period ? output.pulse_us : (uint32_t)half_period;
+}
+
+void ClockEngine::gates_off(uint64_t time_us, uint32_t skip) {
+    for (uint32_t mask = gate_mask & ~skip; mask != 0; mask &= mask - 1) {
+        int i = __builtin_ctz(mask);
+        if (outputs[i].gate_off_us <= time_us) {
+            gate_mask &= ~(1u << i);
+            changed_mask ^= 1u << i;
+        }
+    }
+}
+
+void ClockEngine::gate_on(size_t idx, uint64_t time_us, uint32_t* fired) {
+    uint32_t bit = 1u << idx;
+    outputs[idx].gate_on_us = NO_EVENT;
+    outputs[idx].gate_off_us = time_us + get_pulse_us(outputs[idx]);
+    if (!(gate_mask & bit)) {
+        gate_mask |= bit;
+        changed_mask ^= bit;
+    }
+    *fired |= bit;
+}
+
+void ClockEngine::gates_on(uint64_t time_us, uint32_t* fired) {
+    for (uint32_t mask = output_mask; mask != 0; mask &= mask - 1) {
+        int i = __builtin_ctz(mask);
+        if (outputs[i].gate_on_us <= time_us) {
+            gate_on(i, outputs[i].gate_on_us, fired);
+        }
+    }
+}
+
+void ClockEngine::do_tick(uint64_t time_us, uint32_t* fired) {
+    // Pulses placed inside the previous tick come first
+    gates_on(time_us, fired);
+    gates_off(time_us, *fired);
+
+    for (uint32_t mask = output_mask; mask != 0; mask &= mask - 1) {
+        int i = __builtin_ctz(mask);
+        Output& output = outputs[i];
+
+        uint64_t tick_pos = (uint64_t)tick_count * output.mul;
+        if (output.next_pos < tick_pos) {
+            // Missed while disabled or reconfigured
+            align_output(output);
+        }
+        if (output.next_pos >= tick_pos + output.mul) continue;
+
+        uint64_t frac = output.next_pos - tick_pos;
+        if (frac == 0) {
+            gate_on(i, time_us, fired);
+        } else {
+            // Between this tick and the next one, at the current tick interval
+            output.gate_on_us = time_us + ((frac * interval_q16 / output.mul) >> FRAC_BITS);
+        }
+        output.next_pos += get_period_units(output.div);
+    }
+
+    tick_count++;
+    tick_events++;
+}
+
+uint32_t ClockEngine::update(uint64_t now_us) {
+    uint32_t fired = 0;
+
+    if (internal) {
+        while ((next_tick_q16 >> FRAC_BITS) <= now_us) {
+            do_tick(next_tick_q16 >> FRAC_BITS, &fired);
+            next_tick_q16 += interval_q16;
+        }
+    } else {
+        // Received ticks the prediction did not cover yet
+        while (tick_count < external_count && external_time_us <= now_us) {
+            do_tick(external_time_us, &fired);
+        }
+        while (predicting && tick_count <= external_count && (next_tick_q16 >> FRAC_BITS) <= now_us) {
+            do_tick(next_tick_q16 >> FRAC_BITS, &fired);
+            next_tick_q16 += interval_q16;
+        }
+    }
+
+    gates_on(now_us, &fired);
+
+    // A pulse fired in this call stays high at least until the next one, even if it is already due
+    gates_off(now_us, fired);
+
+    uint32_t changed = changed_mask;
+    changed_mask = 0;
+    return changed;
+}
+
+uint64_t ClockEngine::get_next_event_us(void) const {
+    uint64_t next = NO_EVENT;
+
+    if (changed_mask != 0) {
+        return 0;
+    }
+    if (!internal && tick_count < external_count) {
+        next = external_time_us;
+    } else if (internal || (predicting && tick_count <= external_count)) {
+        next = next_tick_q16 >> FRAC_BITS;
+    }
+    for (uint32_t mask = gate_mask; mask != 0; mask &= mask - 1) {
+        int i = __builtin_ctz(mask);
+        if (outputs[i].gate_off_us < next) {
+            next = outputs[i].gate_off_us;
+        }
+    }
+    for (uint32_t mask = output_mask; mask != 0; mask &= mask - 1) {
+        int i = __builtin_ctz(mask);
+        if (outputs[i].gate_on_us < next) {
+            next = outputs[i].gate_on_us;
+        }
+    }
+    return next;
+}
+
+uint16_t ClockEngine::get_tick_phase(uint64_t now_us) const {
+    if ((!internal && !predicting) || interval_q16 == 0) return 0;
+
+    uint64_t now_q16 = now_us << FRAC_BITS;
+    uint64_t last_tick_q16 = next_tick_q16 - interval_q16;
+    if (now_q16 <= last_tick_q16) return 0;
+
+    uint64_t phase = ((now_q16 - last_tick_q16) << 16) / interval_q16;
+    return phase > 0xFFFF ? 0xFFFF : (uint16_t)phase;
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 24 PPQN clock and clock gate scheduler, all times in microseconds.
+// The internal tempo is a fixed point tick interval (1/65536 us), tick times
+// are accumulated in the same units so rounding never adds up to drift.
+// External ticks realign the schedule; while the tracker is locked the engine
+// predicts the next tick at the filtered tempo, at most one tick ahead of the
+// ticks actually received, so divisions advance smoothly between raw ticks.
+// Outputs pulse mul times every div beats. Pulse positions are exact integers
+// in 1/mul tick units, pulses between ticks are placed by interpolating the
+// current tick interval, so multiplied clocks stay in phase with the ticks.
+// Has no hardware dependencies: the owner calls update() when
+// get_next_event_us() is due and writes the gates reported as changed.
+class ClockEngine
+{
+public:
+    static const int PPQN = 24;
+    static const size_t MAX_OUTPUTS = 8;
+    static const uint64_t NO_EVENT = UINT64_MAX;
+    static const int FRAC_BITS = 16;
+
+    ClockEngine();
+
+    void set_bpm(float bpm);
+    float get_bpm(void) const { return bpm; }
+    uint64_t get_tick_interval_q16(void) const { return interval_q16; }
+
+    // Internal ticks come from the tempo, external ones from external_tick()
+    void set_internal(bool internal, uint64_t now_us);
+    bool is_internal(void) const { return internal; }
+
+    // mul 0 disables the output. offset delays the pulses in 1/mul tick units
+    // (0..get_period_units() - 1), the pulse is clamped to half the output period.
+    // At most one pulse is raised per tick, so mul must not exceed get_period_units(div).
+    void set_output(size_t idx, uint8_t mul, uint8_t div, uint32_t offset, uint32_t pulse_us);
+    static uint32_t get_period_units(uint8_t div) { return (uint32_t)PPQN * div; }
+
+    // Restarts at tick 0 with the next tick due at now_us, lowers all gates
+    void reset(uint64_t now_us);
+    // Same as reset() but the next tick is song position tick, outputs are
+    // realigned so their pulses keep counting from song position 0
+    void locate(uint32_t tick, uint64_t now_us);
+    // arrival_us is when the tick came in, tick_time_us its filtered time,
+    // interval_q16 the tracked tick interval (0 keeps the current one)
+    void external_tick(uint64_t arrival_us, uint64_t tick_time_us, uint64_t interval_q16, bool locked);
+    // Stops predicting until the next locked tick
+    void external_lost(void) { predicting = false; }
+
+    // Processes everything due at now_us, returns outputs whose gate changed
+    uint32_t update(uint64_t now_us);
+
+    uint64_t get_next_event_us(void) const;
+    // When the next internal tick is due, NO_EVENT for an external clock
+    uint64_t get_next_tick_us(void) const { return internal ? (next_tick_q16 >> FRAC_BITS) : NO_EVENT; }
+    uint32_t get_gate_mask(void) const { return gate_mask; }
+    uint32_t get_tick_count(void) const { return tick_count; } // Song position of the next tick
+    uint32_t get_tick_events(void) const { return tick_events; } // Since boot, for event delivery
+
+    // Position inside the current scheduled tick, 0..65535
+    uint16_t get_tick_phase(uint64_t now_us) const;
+
+private:
+    struct Output {
+        uint8_t mul;
+        uint8_t div;
+        uint32_t offset;
+        uint32_t pulse_us;
+        uint64_t next_pos; // Next pulse in 1/mul tick units since song position 0
+        uint64_t gate_on_us; // Pulse placed between ticks, NO_EVENT if none
+        uint64_t gate_off_us;
+    };
+
+    float bpm;
+    bool internal;
+    uint64_t interval_q16;
+    uint64_t next_tick_q16;
+
+    uint32_t tick_count;
+    uint32_t tick_events;
+    uint32_t external_count; // Song position after the last external tick
+    uint64_t external_time_us; // When the last external tick is due if not predicted yet
+    bool predicting;
+
+    Output outputs[MAX_OUTPUTS];
+    uint32_t output_mask; // Enabled outputs
+    uint32_t gate_mask; // Outputs currently high
+    uint32_t changed_mask; // Gate changes not yet returned by update()
+
+    void do_tick(uint64_t time_us, uint32_t* fired);
+    void gate_on(size_t idx, uint64_t time_us, uint32_t* fired);
+    void gates_on(uint64_t time_us, uint32_t* fired);
+    void gates_off(uint64_t time_us, uint32_t skip);
+    void align_output(Output& output);
+    uint32_t get_pulse_us(const Output& output) const;
+};
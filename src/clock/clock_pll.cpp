@@ -0,0 +1,109 @@
+#include "clock_pll.h"
+#include <math.h>
+
+ClockPll::ClockPll() {
+    tempo_changes = 0;
+    reset();
+}
+
+void ClockPll::reset(void) {
+    tick_count = 0;
+    step_ticks = 1;
+    fit_ticks = 0;
+    outliers = 0;
+    drift_ticks = 0;
+    last_raw_us = 0;
+    tick_time_us = 0;
+    period_us = 0;
+}
+
+void ClockPll::restart_fit(uint64_t time_us, double period) {
+    if (period < MIN_PERIOD_US) period = MIN_PERIOD_US;
+    if (period > MAX_PERIOD_US) period = MAX_PERIOD_US;
+    period_us = period;
+    tick_time_us = (double)time_us;
+    fit_ticks = 1;
+    outliers = 0;
+    drift_ticks = 0;
+}
+
+void ClockPll::tick(uint64_t time_us, uint32_t ticks) {
+    if (ticks == 0) ticks = 1;
+    double raw_interval = (double)(time_us - last_raw_us) / ticks;
+    last_raw_us = time_us;
+    step_ticks = ticks;
+
+    if (tick_count < 0xFFFFFFFF) tick_count++;
+
+    if (tick_count == 1) {
+        tick_time_us = (double)time_us;
+        return;
+    }
+    if (tick_count == 2) {
+        restart_fit(time_us, raw_interval);
+        return;
+    }
+
+    // Thresholds scale with the span, the period is corrected per tick
+    double span = period_us * ticks;
+    double predicted = tick_time_us + span;
+    double error = (double)time_us - predicted;
+
+    if (fabs(error) > JUMP_RATIO * span) {
+        if (++outliers >= 2) {
+            // Tempo jump, start over from the raw interval
+            restart_fit(time_us, raw_interval);
+            tempo_changes++;
+        } else {
+            // Single glitch, keep running on the prediction
+            tick_time_us = predicted;
+        }
+        return;
+    }
+    outliers = 0;
+
+    // Errors piling up on one side mean a tempo ramp, shorten the memory
+    if (fabs(error) > DRIFT_RATIO * span) {
+        int sign = error > 0 ? 1 : -1;
+        drift_ticks = (drift_ticks * sign > 0) ? drift_ticks + sign : sign;
+        if (drift_ticks * sign >= 4 && fit_ticks > LOCK_TICKS) {
+            fit_ticks = LOCK_TICKS;
+            drift_ticks = 0;
+            tempo_changes++;
+        }
+    } else {
+        drift_ticks = 0;
+    }
+
+    if (fit_ticks < MAX_FIT_TICKS) fit_ticks++;
+
+    // Least squares gains for a line through fit_ticks points
+    double k = (double)fit_ticks;
+    double alpha = 2.0 * (2.0 * k - 1.0) / (k * (k + 1.0));
+    double beta = 6.0 / (k * (k + 1.0));
+
+    tick_time_us = predicted + alpha * error;
+    period_us += beta * error / ticks;
+
+    if (period_us < MIN_PERIOD_US) period_us = MIN_PERIOD_US;
+    if (period_us > MAX_PERIOD_US) period_us = MAX_PERIOD_US;
+}
+
+bool ClockPll::check_lost(uint64_t now_us) {
+    if (!has_period()) return false;
+
+    if (now_us - last_raw_us > (uint64_t)(period_us * step_ticks * LOSS_PERIODS)) {
+        reset();
+        return true;
+    }
+    return false;
+}
+
+float ClockPll::get_bpm(void) const {
+    if (!has_period()) return 0;
+    return (float)(60e6 / (period_us * PPQN));
+}
+
+uint64_t ClockPll::get_interval_q16(void) const {
+    return (uint64_t)(period_us * 65536.0 + 0.5);
+}
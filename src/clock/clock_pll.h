@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Tempo and phase tracker for an external 24 PPQN clock.
+// An alpha-beta loop filters tick timestamps: the first ticks after a reset
+// are a least squares line fit (gains shrink with every tick), then the gains
+// stay at the MAX_FIT_TICKS values. A tick far from the prediction is ignored
+// once, a second one in a row restarts the fit at the new tempo.
+// Clocks slower than 24 PPQN feed one timestamp per edge with the number of
+// ticks it spans; the filter still tracks the 24 PPQN tick period.
+// Has no hardware dependencies, all times are microseconds.
+class ClockPll
+{
+public:
+    static const int PPQN = 24;
+    static const uint32_t MAX_FIT_TICKS = 24; // Steady state memory, alpha ~0.16, beta ~0.01
+    static const uint32_t LOCK_TICKS = 6; // Ticks in the fit before the estimate is trusted
+    static const uint32_t LOSS_PERIODS = 4; // Missing ticks before the clock counts as lost
+    static const uint32_t MIN_PERIOD_US = 1000;
+    static const uint32_t MAX_PERIOD_US = 2500000; // 1 BPM
+    static constexpr double JUMP_RATIO = 0.25; // Error vs period that counts as an outlier
+    static constexpr double DRIFT_RATIO = 0.03; // Error vs period that speeds the loop back up
+
+    ClockPll();
+    void reset(void);
+
+    // ticks is how many 24 PPQN ticks time_us is after the previous input
+    void tick(uint64_t time_us, uint32_t ticks = 1);
+
+    // Returns true once when input stops for LOSS_PERIODS input periods, then resets
+    bool check_lost(uint64_t now_us);
+
+    bool is_locked(void) const { return fit_ticks >= LOCK_TICKS; }
+    bool has_period(void) const { return tick_count >= 2; }
+    double get_period_us(void) const { return period_us; }
+    float get_bpm(void) const;
+    uint64_t get_interval_q16(void) const;
+
+    // Filtered time of the last tick
+    uint64_t get_tick_time_us(void) const { return (uint64_t)(tick_time_us + 0.5); }
+
+    uint32_t get_tempo_changes(void) const { return tempo_changes; }
+
+private:
+    uint32_t tick_count; // Inputs since reset, saturating
+    uint32_t step_ticks; // Ticks spanned by the last input
+    uint32_t fit_ticks; // Ticks in the current fit
+    uint32_t outliers; // Consecutive outliers
+    int drift_ticks; // Consecutive same sign errors above DRIFT_RATIO, signed
+
+    uint64_t last_raw_us;
+    double tick_time_us;
+    double period_us;
+
+    uint32_t tempo_changes;
+
+    void restart_fit(uint64_t time_us, double period);
+};
@@ -0,0 +1,33 @@
+#include "song_position.h"
+
+SongPosition::SongPosition() {
+    reset();
+}
+
+void SongPosition::reset(void) {
+    position = 0;
+    running = true;
+}
+
+void SongPosition::start(void) {
+    position = 0;
+    running = true;
+}
+
+void SongPosition::resume(void) {
+    running = true;
+}
+
+void SongPosition::stop(void) {
+    running = false;
+}
+
+void SongPosition::locate(uint16_t sixteenths) {
+    position = (uint32_t)sixteenths * TICKS_PER_SPP;
+}
+
+bool SongPosition::tick(void) {
+    if (!running) return false;
+    position++;
+    return true;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Song position of an external clock, in 24 PPQN ticks, driven by the MIDI
+// transport messages. Ticks received while stopped only feed the tempo
+// tracker, the position holds. Running until the first Stop, so sources that
+// never send transport messages keep driving the outputs.
+// The owner locates its ClockEngine at get_position() after start(), resume()
+// and locate(), and passes it only the ticks tick() returns true for.
+// Has no hardware dependencies.
+class SongPosition
+{
+public:
+    static const int PPQN = 24;
+    static const uint32_t TICKS_PER_SPP = 6; // Song position pointer counts 16th notes
+
+    SongPosition();
+
+    // New clock source, position 0 and running
+    void reset(void);
+
+    void start(void);  // Start: play from the top
+    void resume(void); // Continue: play from the held or pointed position
+    void stop(void);   // Stop: hold the position
+    void locate(uint16_t sixteenths); // Song position pointer, keeps the run state
+
+    // A clock tick, returns true if it advances the song
+    bool tick(void);
+
+    uint32_t get_position(void) const { return position; } // Song position of the next tick
+    bool is_running(void) const { return running; }
+
+private:
+    uint32_t position;
+    bool running;
+};
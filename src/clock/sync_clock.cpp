@@ -0,0 +1,67 @@
+#include "sync_clock.h"
+
+SyncClock::SyncClock() {
+    ppqn = PPQN;
+    ticks_per_edge = 1;
+    reset();
+}
+
+void SyncClock::reset(void) {
+    has_edge = false;
+    edge_us = 0;
+    period_us = 0;
+    next_tick = ticks_per_edge;
+    late_ticks = 0;
+}
+
+void SyncClock::set_ppqn(int new_ppqn) {
+    if (new_ppqn <= 0 || PPQN % new_ppqn != 0 || new_ppqn == ppqn) return;
+
+    ppqn = new_ppqn;
+    ticks_per_edge = PPQN / new_ppqn;
+    reset();
+}
+
+void SyncClock::edge(uint64_t time_us) {
+    if (!has_edge) {
+        has_edge = true;
+        edge_us = time_us;
+        return;
+    }
+
+    uint64_t period = time_us - edge_us;
+    if (period < MIN_PERIOD_US) return;
+
+    if (period > MAX_PERIOD_US || (period_us > 0 && period > period_us * LOSS_PERIODS)) {
+        // Stopped and restarted, the old period says nothing about the new one
+        reset();
+        has_edge = true;
+        edge_us = time_us;
+        return;
+    }
+
+    late_ticks += ticks_per_edge - next_tick;
+    edge_us = time_us;
+    period_us = period;
+    next_tick = 0;
+}
+
+bool SyncClock::poll(uint64_t now_us, uint64_t* tick_us, bool* on_edge) {
+    if (late_ticks > 0) {
+        // Catch up ticks share the edge time but not its timing
+        late_ticks--;
+        *tick_us = edge_us;
+        *on_edge = false;
+        return true;
+    }
+
+    if (next_tick >= ticks_per_edge) return false;
+
+    uint64_t time_us = edge_us + period_us * next_tick / ticks_per_edge;
+    if (time_us > now_us) return false;
+
+    *on_edge = next_tick == 0;
+    next_tick++;
+    *tick_us = time_us;
+    return true;
+}
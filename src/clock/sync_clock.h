@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Converts analog sync pulses at 1..24 PPQN into 24 PPQN clock ticks.
+// The first edge after a reset only starts measuring, every later edge is a
+// tick of its own followed by the ticks up to the next edge, spread over the
+// last edge period. Interpolated ticks never run past the next edge: ticks
+// still pending when an edge arrives early are due at once, so every edge
+// stays on a multiple of 24 / PPQN ticks. Only the tick on an edge carries
+// timing information, the others are placed from the previous edge period.
+// Has no hardware dependencies, all times are microseconds.
+class SyncClock
+{
+public:
+    static const int PPQN = 24;
+    static const uint32_t MIN_PERIOD_US = 1000; // Shorter edge periods are glitches
+    static const uint32_t MAX_PERIOD_US = 2500000; // 1 BPM at 24 PPQN
+    static const uint32_t LOSS_PERIODS = 4; // A longer gap starts measuring again
+
+    SyncClock();
+    void reset(void);
+
+    // ppqn must divide PPQN, resets when it changes
+    void set_ppqn(int ppqn);
+    int get_ppqn(void) const { return ppqn; }
+    uint32_t get_ticks_per_edge(void) const { return ticks_per_edge; }
+
+    void edge(uint64_t time_us);
+    // Returns true and the time of the oldest tick due at now_us,
+    // on_edge is set for the tick of an edge and cleared for the rest
+    bool poll(uint64_t now_us, uint64_t* tick_us, bool* on_edge);
+
+    uint64_t get_period_us(void) const { return period_us; } // 0 until two edges
+
+private:
+    int ppqn;
+    uint32_t ticks_per_edge;
+
+    bool has_edge;
+    uint64_t edge_us; // Last accepted edge
+    uint64_t period_us;
+    uint32_t next_tick; // Index of the next tick after edge_us, ticks_per_edge when done
+    uint32_t late_ticks; // Ticks of the previous edge, due at edge_us
+};
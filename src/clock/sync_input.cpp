@@ -0,0 +1,20 @@
+#include "sync_input.h"
+#include <esp_timer.h>
+
+SyncInput::SyncInput() {
+    overruns = 0;
+}
+
+void SyncInput::begin(int pin) {
+    pinMode(pin, INPUT);
+    attachInterruptArg(digitalPinToInterrupt(pin), on_edge, this, RISING);
+}
+
+void IRAM_ATTR SyncInput::on_edge(void* arg) {
+    SyncInput* self = static_cast<SyncInput*>(arg);
+    uint32_t now = (uint32_t)esp_timer_get_time();
+
+    if (!self->ring.push(now)) {
+        self->overruns++;
+    }
+}
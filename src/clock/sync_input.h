@@ -0,0 +1,26 @@
+#pragma once
+
+#include <Arduino.h>
+#include "../spsc_ring.h"
+
+// Rising edges on SYNC_IN, timestamped in the GPIO interrupt and queued for
+// the processor task. Timestamps are the low 32 bits of esp_timer_get_time().
+class SyncInput
+{
+public:
+    static const size_t RING_SIZE = 16;
+
+    SyncInput();
+    void begin(int pin);
+
+    // Consumer side, returns false when no edge is pending
+    bool read(uint32_t* time_us) { return ring.pop(time_us); }
+
+    uint32_t get_overruns(void) const { return overruns; }
+
+private:
+    SpscRing<uint32_t, RING_SIZE> ring;
+    volatile uint32_t overruns;
+
+    static void IRAM_ATTR on_edge(void* arg);
+};
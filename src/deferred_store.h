@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+// Write policy for settings kept in flash.
+// Changes only mark the data dirty. A write is due once no change came for
+// quiet_ms, or max_delay_ms after the first unsaved change if they keep
+// coming. A due write is skipped when the content matches what was written
+// last, compared bytewise, so T must be copied with memcpy only.
+// Has no hardware dependencies, times are milliseconds and may wrap.
+template <typename T>
+struct DeferredStore
+{
+    uint32_t quiet_ms;
+    uint32_t max_delay_ms;
+
+    bool dirty;
+    uint32_t first_change_ms; // First change since the last write
+    uint32_t last_change_ms;
+    T stored; // Content in flash
+
+    DeferredStore(uint32_t quiet_ms, uint32_t max_delay_ms)
+        : quiet_ms(quiet_ms), max_delay_ms(max_delay_ms), dirty(false), first_change_ms(0), last_change_ms(0) {
+        memset(&stored, 0, sizeof(stored));
+    }
+
+    // Content known to be in flash, after a read or a write.
+    // Changes marked while writing keep the data dirty.
+    void set_stored(const T& data) {
+        memcpy(&stored, &data, sizeof(stored));
+    }
+
+    void mark_dirty(uint32_t now_ms) {
+        if (!dirty) {
+            dirty = true;
+            first_change_ms = now_ms;
+        }
+        last_change_ms = now_ms;
+    }
+
+    bool is_due(uint32_t now_ms) const {
+        if (!dirty) return false;
+        return (now_ms - last_change_ms >= quiet_ms) || (now_ms - first_change_ms >= max_delay_ms);
+    }
+
+    // Clears dirty, returns true if data differs from the stored content and must be written.
+    // Call set_stored() once the write succeeded, mark_dirty() to retry a failed one.
+    bool take(const T& data) {
+        dirty = false;
+        return memcmp(&stored, &data, sizeof(stored)) != 0;
+    }
+};
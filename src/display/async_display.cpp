@@ -0,0 +1,165 @@
+#include "async_display.h"
+#include <esp_timer.h>
+
+// Bytes per I2C transaction after the control byte
+#if defined(I2C_BUFFER_LENGTH)
+static const size_t WIRE_CHUNK = I2C_BUFFER_LENGTH - 1;
+#else
+static const size_t WIRE_CHUNK = 31;
+#endif
+
+static const uint8_t CONTROL_COMMANDS = 0x00; // Co = 0, D/C# = 0
+static const uint8_t CONTROL_DATA = 0x40; // Co = 0, D/C# = 1
+
+AsyncDisplay::AsyncDisplay(TwoWire* twi, int8_t rst_pin)
+    : Adafruit_SSD1306(SCREEN_WIDTH, SCREEN_HEIGHT, twi, rst_pin, DISPLAY_I2C_CLOCK, DISPLAY_I2C_CLOCK) {
+    // The library draws into the back buffer, begin() does not allocate one then
+    buffer = frames.get_back();
+
+    is_sent = false;
+    task_handle = nullptr;
+    sent_count = 0;
+    dropped_count = 0;
+    error_count = 0;
+
+    for (size_t i = 0; i < FrameHistogram::BUCKET_COUNT; i++) {
+        last_counts[i] = 0;
+    }
+    last_sent_count = 0;
+    last_dropped_count = 0;
+    last_error_count = 0;
+}
+
+AsyncDisplay::~AsyncDisplay() {
+    buffer = nullptr; // Not allocated, keeps the library from freeing it
+}
+
+bool AsyncDisplay::begin(uint8_t switchvcc, uint8_t i2caddr) {
+    if (!Adafruit_SSD1306::begin(switchvcc, i2caddr)) {
+        return false;
+    }
+
+    xTaskCreatePinnedToCore(
+        flush_task,
+        "Display_Task",
+        DISPLAY_TASK_STACK_SIZE,
+        this,
+        DISPLAY_TASK_PRIORITY,
+        &task_handle,
+        UI_TASK_CORE
+    );
+    return task_handle != nullptr;
+}
+
+void AsyncDisplay::present(void) {
+    const uint8_t* frame = frames.get_back();
+    if (frames.publish()) {
+        dropped_count = dropped_count + 1;
+    }
+
+    // Only read by the flush task meanwhile, so it can be copied while it is sent
+    memcpy(frames.get_back(), frame, BUFFER_SIZE);
+    buffer = frames.get_back();
+
+    if (task_handle != nullptr) {
+        xTaskNotifyGive(task_handle);
+    }
+}
+
+bool AsyncDisplay::send_page(size_t page, size_t first, size_t last, const uint8_t* data) {
+    wire->beginTransmission(i2caddr);
+    wire->write(CONTROL_COMMANDS);
+    wire->write((uint8_t)SSD1306_PAGEADDR);
+    wire->write((uint8_t)page);
+    wire->write((uint8_t)page);
+    wire->write((uint8_t)SSD1306_COLUMNADDR);
+    wire->write((uint8_t)first);
+    wire->write((uint8_t)last);
+    if (wire->endTransmission() != 0) {
+        return false;
+    }
+
+    for (size_t x = first; x <= last; ) {
+        size_t count = last + 1 - x;
+        if (count > WIRE_CHUNK) count = WIRE_CHUNK;
+
+        wire->beginTransmission(i2caddr);
+        wire->write(CONTROL_DATA);
+        wire->write(data + x, count);
+        if (wire->endTransmission() != 0) {
+            return false;
+        }
+        x += count;
+    }
+    return true;
+}
+
+bool AsyncDisplay::flush(const uint8_t* frame) {
+    for (size_t page = 0; page < PAGE_COUNT; page++) {
+        const uint8_t* data = frame + page * SCREEN_WIDTH;
+        uint8_t* shown = sent + page * SCREEN_WIDTH;
+
+        // Columns from the first to the last changed one
+        size_t first = 0;
+        size_t last = SCREEN_WIDTH - 1;
+        if (is_sent) {
+            while (first < SCREEN_WIDTH && data[first] == shown[first]) first++;
+            if (first == SCREEN_WIDTH) continue;
+            while (data[last] == shown[last]) last--;
+        }
+
+        if (!send_page(page, first, last, data)) {
+            is_sent = false; // The panel is in an unknown state, the next frame is sent whole
+            return false;
+        }
+        memcpy(shown + first, data + first, last + 1 - first);
+    }
+    is_sent = true;
+    return true;
+}
+
+void AsyncDisplay::flush_task(void* parameter) {
+    AsyncDisplay* display = static_cast<AsyncDisplay*>(parameter);
+
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        // Frames presented while one is sent are skipped for the newest
+        while (display->frames.acquire()) {
+            int64_t start_us = esp_timer_get_time();
+            bool ok = display->flush(display->frames.get_front());
+            display->frame_times.add((uint32_t)(esp_timer_get_time() - start_us));
+
+            if (ok) {
+                display->sent_count = display->sent_count + 1;
+            } else {
+                display->error_count = display->error_count + 1;
+            }
+        }
+    }
+}
+
+void AsyncDisplay::print_stats(void) {
+    uint32_t sent = sent_count;
+    uint32_t dropped = dropped_count;
+    uint32_t errors = error_count;
+    Serial.printf("display: %u sent, %u dropped, %u errors |",
+                  (unsigned)(sent - last_sent_count),
+                  (unsigned)(dropped - last_dropped_count),
+                  (unsigned)(errors - last_error_count));
+    last_sent_count = sent;
+    last_dropped_count = dropped;
+    last_error_count = errors;
+
+    for (size_t i = 0; i < FrameHistogram::BUCKET_COUNT; i++) {
+        uint32_t count = frame_times.get_count(i);
+        uint32_t bucket_ms = FrameHistogram::get_bucket_ms(i);
+        if (bucket_ms != 0) {
+            Serial.printf(" <%ums %u", (unsigned)bucket_ms, (unsigned)(count - last_counts[i]));
+        } else {
+            Serial.printf(" more %u", (unsigned)(count - last_counts[i]));
+        }
+        last_counts[i] = count;
+    }
+    Serial.println();
+}
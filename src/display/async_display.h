@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdint.h>
+#include <Arduino.h>
+#include <Wire.h>
+#include <Adafruit_SSD1306.h>
+#include "../board.h"
+#include "../frame_exchange.h"
+#include "frame_histogram.h"
+
+// SSD1306 whose frames are sent by a flush task, so drawing never waits for I2C.
+// Screens draw into the back buffer as usual and call present(), the flush
+// task sends the newest presented frame and only the pages that changed
+// since the previous one. display() still sends the back buffer at once,
+// it must not be used after the first present().
+class AsyncDisplay : public Adafruit_SSD1306 {
+public:
+    static const size_t BUFFER_SIZE = SCREEN_WIDTH * SCREEN_HEIGHT / 8;
+    static const size_t PAGE_COUNT = SCREEN_HEIGHT / 8; // Rows of 8 pixels, one byte per column
+
+    AsyncDisplay(TwoWire* twi, int8_t rst_pin);
+    ~AsyncDisplay();
+
+    // Initializes the panel and starts the flush task
+    bool begin(uint8_t switchvcc, uint8_t i2caddr);
+
+    // Hands the back buffer to the flush task. The back buffer keeps the
+    // frame, drawing continues on top of it.
+    void present(void);
+
+    // Frames sent and dropped and the histogram of send times since the previous call
+    void print_stats(void);
+
+private:
+    FrameExchange<BUFFER_SIZE> frames;
+    uint8_t sent[BUFFER_SIZE]; // What the panel shows, owned by the flush task
+    bool is_sent; // sent is valid, cleared after a bus error
+
+    TaskHandle_t task_handle;
+    FrameHistogram frame_times;
+    volatile uint32_t sent_count;
+    volatile uint32_t dropped_count; // Replaced before the flush task took them
+    volatile uint32_t error_count;
+
+    // Copies taken by print_stats()
+    uint32_t last_counts[FrameHistogram::BUCKET_COUNT];
+    uint32_t last_sent_count;
+    uint32_t last_dropped_count;
+    uint32_t last_error_count;
+
+    bool flush(const uint8_t* frame);
+    bool send_page(size_t page, size_t first, size_t last, const uint8_t* data);
+    static void flush_task(void* parameter);
+};
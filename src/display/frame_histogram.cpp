@@ -0,0 +1,27 @@
+#include "frame_histogram.h"
+
+FrameHistogram::FrameHistogram() {
+    for (size_t i = 0; i < BUCKET_COUNT; i++) {
+        counts[i] = 0;
+    }
+}
+
+uint32_t FrameHistogram::get_bucket_ms(size_t bucket) {
+    if (bucket >= BUCKET_COUNT - 1) return 0;
+    return 1u << bucket;
+}
+
+size_t FrameHistogram::get_bucket(uint32_t time_us) {
+    size_t bucket = 0;
+    uint32_t limit_us = 1000;
+    while (bucket < BUCKET_COUNT - 1 && time_us >= limit_us) {
+        bucket++;
+        limit_us *= 2;
+    }
+    return bucket;
+}
+
+void FrameHistogram::add(uint32_t time_us) {
+    size_t bucket = get_bucket(time_us);
+    counts[bucket] = counts[bucket] + 1; // Only the flush task adds
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Frame times in power of two buckets: under 1 ms, under 2 ms, ... under
+// 64 ms and the rest. One task adds, any task may read the counts, which only
+// grow, so a reader reports the difference to its previous copy.
+// Has no hardware dependencies.
+class FrameHistogram
+{
+public:
+    static const size_t BUCKET_COUNT = 8;
+
+    FrameHistogram();
+
+    void add(uint32_t time_us);
+
+    uint32_t get_count(size_t bucket) const { return counts[bucket]; }
+    // Upper bound of a bucket in ms, 0 for the last one which has none
+    static uint32_t get_bucket_ms(size_t bucket);
+    static size_t get_bucket(uint32_t time_us);
+
+private:
+    volatile uint32_t counts[BUCKET_COUNT];
+};
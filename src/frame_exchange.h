@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+// Triple buffer handing whole frames from exactly one writer to one reader.
+// The writer draws into the back buffer, the reader sends its front buffer,
+// the third one holds the latest finished frame. publish() and acquire()
+// swap buffer indices in one atomic exchange, so neither side waits and no
+// buffer is ever written while it is read. Frames published faster than the
+// reader takes them are dropped, the reader always gets the newest one.
+template <size_t SIZE>
+struct FrameExchange
+{
+    uint8_t buffers[3][SIZE];
+    uint32_t back; // Owned by the writer
+    uint32_t front; // Owned by the reader
+    std::atomic<uint32_t> ready; // Index of the third buffer, FRESH once published
+
+    static const uint32_t FRESH = 0x4;
+    static const uint32_t INDEX = 0x3;
+
+    FrameExchange() : back(0), front(1), ready(2) {}
+
+    // Writer side
+    uint8_t* get_back(void) { return buffers[back]; }
+
+    // Writer side, the back buffer becomes the latest frame and the writer
+    // continues in another one. Returns true if a frame the reader had not
+    // taken yet was dropped.
+    bool publish(void) {
+        uint32_t previous = ready.exchange(back | FRESH, std::memory_order_acq_rel);
+        back = previous & INDEX;
+        return (previous & FRESH) != 0;
+    }
+
+    // Reader side, takes the latest frame into the front buffer.
+    // Returns false if nothing was published since the last call.
+    bool acquire(void) {
+        if ((ready.load(std::memory_order_relaxed) & FRESH) == 0) {
+            return false;
+        }
+        front = ready.exchange(front, std::memory_order_acq_rel) & INDEX;
+        return true;
+    }
+
+    // Reader side
+    const uint8_t* get_front(void) const { return buffers[front]; }
+};
@@ -0,0 +1,43 @@
+#include "button_debouncer.h"
+
+ButtonDebouncer::ButtonDebouncer() {
+    pressed = false;
+    change_ms = 0;
+    settling = false;
+    raw_pressed = false;
+    raw_ms = 0;
+}
+
+bool ButtonDebouncer::edge(bool level_pressed, uint32_t time_ms) {
+    raw_pressed = level_pressed;
+    raw_ms = time_ms;
+
+    if (settling && time_ms - change_ms < DEBOUNCE_MS) {
+        return false;
+    }
+    settling = false;
+
+    if (level_pressed == pressed) {
+        return false;
+    }
+    pressed = level_pressed;
+    change_ms = time_ms;
+    settling = true;
+    return true;
+}
+
+bool ButtonDebouncer::poll(uint32_t now_ms) {
+    if (!settling || now_ms - change_ms < DEBOUNCE_MS) {
+        return false;
+    }
+    settling = false;
+
+    if (raw_pressed == pressed) {
+        return false;
+    }
+    // Dated at the last bounce, the contact has been at this level since then
+    pressed = raw_pressed;
+    change_ms = raw_ms;
+    settling = true;
+    return true;
+}
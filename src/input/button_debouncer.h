@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdint.h>
+
+// Press and release of a push button from its raw edges.
+// A change is taken at its first edge, edges within DEBOUNCE_MS after it are
+// contact bounce. If the bounce settles on the other level, poll() takes that
+// level once the window has passed, so a short tap is never lost.
+// Call poll() with the edge time before every edge(), then once in a while.
+// Has no hardware dependencies, times are milliseconds and may wrap.
+class ButtonDebouncer
+{
+public:
+    static const uint32_t DEBOUNCE_MS = 50;
+
+    ButtonDebouncer();
+
+    // Level after an edge, returns true if it changed the debounced state
+    bool edge(bool level_pressed, uint32_t time_ms);
+    // Returns true if the level the bounce settled on changed the debounced state
+    bool poll(uint32_t now_ms);
+
+    bool is_pressed(void) const { return pressed; }
+    uint32_t get_change_ms(void) const { return change_ms; } // When the debounced state last changed
+
+private:
+    bool pressed;
+    uint32_t change_ms;
+    bool settling; // Within DEBOUNCE_MS of the last change
+    bool raw_pressed; // Level of the last edge
+    uint32_t raw_ms;
+};
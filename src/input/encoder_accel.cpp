@@ -0,0 +1,37 @@
+#include "encoder_accel.h"
+
+EncoderAccel::EncoderAccel() {
+    reset();
+}
+
+void EncoderAccel::reset(void) {
+    direction = 0;
+    last_ms = 0;
+    detent_ms = SLOW_MS;
+}
+
+int EncoderAccel::get_gain(void) const {
+    if (detent_ms >= SLOW_MS) return 1;
+    if (detent_ms <= FAST_MS) return MAX_GAIN;
+    return 1 + (int)((SLOW_MS - detent_ms) * (MAX_GAIN - 1) / (SLOW_MS - FAST_MS));
+}
+
+int EncoderAccel::update(int detents, uint32_t time_ms) {
+    if (detents == 0) return 0;
+
+    int dir = (detents > 0) ? 1 : -1;
+    uint32_t count = (detents > 0) ? detents : -detents;
+    uint32_t elapsed = time_ms - last_ms;
+
+    if (dir != direction || elapsed >= SLOW_MS * count) {
+        // First detents of a turn always move single steps
+        detent_ms = SLOW_MS;
+    } else {
+        // Half of the new interval per update, a few detents reach full speed
+        detent_ms = (detent_ms + elapsed / count) / 2;
+    }
+    direction = dir;
+    last_ms = time_ms;
+
+    return detents * get_gain();
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdint.h>
+
+// Scales encoder detents by turning speed, so wide value ranges can be
+// crossed with one flick while slow turns still move one step per detent.
+// The time per detent is smoothed over the turn, the gain rises linearly
+// from 1 at SLOW_MS per detent to MAX_GAIN at FAST_MS. A pause or a change
+// of direction starts over at 1.
+// Has no hardware dependencies, times are milliseconds and may wrap.
+class EncoderAccel
+{
+public:
+    static const uint32_t SLOW_MS = 60; // ~16 detents/s, no acceleration below
+    static const uint32_t FAST_MS = 15; // ~66 detents/s, full acceleration
+    static const int MAX_GAIN = 16;
+
+    EncoderAccel();
+    void reset(void);
+
+    // Detents turned since the last call, at time_ms. Returns the scaled steps.
+    int update(int detents, uint32_t time_ms);
+
+    uint32_t get_detent_ms(void) const { return detent_ms; }
+
+private:
+    int direction; // 0 after a reset
+    uint32_t last_ms;
+    uint32_t detent_ms; // Smoothed time per detent
+
+    int get_gain(void) const;
+};
@@ -1,12 +1,26 @@
 #include "input.h"
-
-// Debounce time in milliseconds
-#define DEBOUNCE_TIME 50
+#include <hal/gpio_ll.h>
 
 Input::Input() {
-    // Initialize encoder
+    queue = nullptr;
+    overruns = 0;
+
+    for (size_t i = 0; i < ButtonCount; i++) {
+        press_ms[i] = 0;
+    }
+    changes_head = 0;
+    changes_tail = 0;
+
+    last_encoder = 0;
+    encoder_ms = 0;
+}
+
+void Input::begin() {
+    queue = xQueueCreate(QUEUE_SIZE, sizeof(Edge));
+
     encoder.attachHalfQuad(ENCODER_A, ENCODER_B);
     encoder.setCount(0);
+    last_encoder = 0;
 
     // Configure pins
     pinMode(BUTTON_A, INPUT_PULLUP);
@@ -14,81 +28,145 @@ Input::Input() {
     pinMode(ENCODER_A, INPUT_PULLUP);
     pinMode(ENCODER_B, INPUT_PULLUP);
 
-    button_a_pressed = false;
-    button_sw_pressed = false;
-    button_a_press_time = 0;
-    button_sw_press_time = 0;
-    
-    // Initialize debounce variables
-    last_button_a_state = HIGH;  // Pullup, so HIGH when not pressed
-    last_button_sw_state = HIGH;
-    last_button_a_change_time = 0;
-    last_button_sw_change_time = 0;
+    attachInterruptArg(digitalPinToInterrupt(BUTTON_A), on_button_a, this, CHANGE);
+    attachInterruptArg(digitalPinToInterrupt(ENCODER_SW), on_button_sw, this, CHANGE);
+    attachInterruptArg(digitalPinToInterrupt(ENCODER_A), on_encoder, this, CHANGE);
+}
+
+void IRAM_ATTR Input::queue_edge(Source source, bool level_pressed) {
+    Edge edge = {(uint32_t)millis(), source, level_pressed};
+    BaseType_t woken = pdFALSE;
+    if (xQueueSendFromISR(queue, &edge, &woken) != pdTRUE) {
+        overruns++;
+    }
+    if (woken) {
+        portYIELD_FROM_ISR();
+    }
+}
+
+// Buttons pull to ground when pressed
+void IRAM_ATTR Input::on_button_a(void* arg) {
+    static_cast<Input*>(arg)->queue_edge(SourceButtonA, gpio_ll_get_level(&GPIO, (gpio_num_t)BUTTON_A) == 0);
+}
+
+void IRAM_ATTR Input::on_button_sw(void* arg) {
+    static_cast<Input*>(arg)->queue_edge(SourceButtonSw, gpio_ll_get_level(&GPIO, (gpio_num_t)ENCODER_SW) == 0);
+}
+
+void IRAM_ATTR Input::on_encoder(void* arg) {
+    static_cast<Input*>(arg)->queue_edge(SourceEncoder, false);
+}
+
+void Input::wake(void) {
+    if (queue == nullptr) return;
+
+    // A full queue wakes the UI task anyway
+    Edge edge = {(uint32_t)millis(), SourceWake, false};
+    xQueueSend(queue, &edge, 0);
+}
+
+void Input::push_change(Source source, uint32_t time_ms) {
+    uint8_t next = (changes_head + 1) & (CHANGE_QUEUE_SIZE - 1);
+    if (next == changes_tail) {
+        return; // Only with many changes in one frame, the state stays right
+    }
+
+    Change& change = changes[changes_head];
+    change.source = source;
+    if (buttons[source].is_pressed()) {
+        change.state = ButtonPress;
+        change.held_ms = 0;
+        press_ms[source] = time_ms;
+    } else {
+        change.state = ButtonRelease;
+        change.held_ms = time_ms - press_ms[source];
+    }
+    changes_head = next;
 }
 
-Event Input::get_inputs() {
-    Event event = {0, ButtonNone, ButtonNone, 0, 0};
-    
-    unsigned long current_time = millis();
-
-    // Get encoder value
-    static int32_t last_encoder = 0;
-    int32_t current_encoder = encoder.getCount();
-    event.encoder = current_encoder - last_encoder;
-    last_encoder = current_encoder;
-
-    // Read button states
-    int button_a_reading = digitalRead(BUTTON_A);
-    int button_sw_reading = digitalRead(ENCODER_SW);
-    
-    // Handle Button A with immediate events but debounce inhibition
-    if (button_a_reading != last_button_a_state && 
-        (current_time - last_button_a_change_time) > DEBOUNCE_TIME) {
-        
-        // State changed and debounce period passed since last change
-        last_button_a_change_time = current_time;
-        last_button_a_state = button_a_reading;
-        
-        bool button_a_state = (button_a_reading == LOW); // LOW means pressed (pull-up)
-        
-        if (button_a_state && !button_a_pressed) {
-            event.button_a = ButtonPress;
-            button_a_pressed = true;
-            button_a_press_time = current_time;
-        } else if (!button_a_state && button_a_pressed) {
-            event.button_a = ButtonRelease;
-            event.button_a_ms = current_time - button_a_press_time;
-            button_a_pressed = false;
+void Input::handle_edge(const Edge& edge) {
+    if (edge.source == SourceWake) {
+        return;
+    }
+    if (edge.source == SourceEncoder) {
+        encoder_ms = edge.time_ms;
+        return;
+    }
+
+    ButtonDebouncer& button = buttons[edge.source];
+    // A level the last bounce settled on comes first
+    if (button.poll(edge.time_ms)) {
+        push_change(edge.source, button.get_change_ms());
+    }
+    if (button.edge(edge.level_pressed, edge.time_ms)) {
+        push_change(edge.source, button.get_change_ms());
+    }
+}
+
+Event Input::get_inputs(TickType_t wait) {
+    Event event = {0, 0, ButtonNone, ButtonNone, 0, 0};
+
+    // Changes left over from the last event are reported without waiting
+    if (changes_tail != changes_head) {
+        wait = 0;
+    }
+
+    Edge edge;
+    if (queue != nullptr && xQueueReceive(queue, &edge, wait) == pdTRUE) {
+        do {
+            handle_edge(edge);
+        } while (xQueueReceive(queue, &edge, 0) == pdTRUE);
+    }
+
+    uint32_t current_time = millis();
+    for (size_t i = 0; i < ButtonCount; i++) {
+        if (buttons[i].poll(current_time)) {
+            push_change((Source)i, buttons[i].get_change_ms());
         }
-    } else if (button_a_pressed) {
-        // Update hold status regardless of debounce
-        event.button_a = ButtonHold;
-        event.button_a_ms = current_time - button_a_press_time;
-    }
-    
-    // Handle Encoder Switch with immediate events but debounce inhibition
-    if (button_sw_reading != last_button_sw_state && 
-        (current_time - last_button_sw_change_time) > DEBOUNCE_TIME) {
-        
-        // State changed and debounce period passed since last change
-        last_button_sw_change_time = current_time;
-        last_button_sw_state = button_sw_reading;
-        
-        bool button_sw_state = (button_sw_reading == LOW); // LOW means pressed (pull-up)
-        
-        if (button_sw_state && !button_sw_pressed) {
-            event.button_sw = ButtonPress;
-            button_sw_pressed = true;
-            button_sw_press_time = current_time;
-        } else if (!button_sw_state && button_sw_pressed) {
-            event.button_sw = ButtonRelease;
-            event.button_sw_ms = current_time - button_sw_press_time;
-            button_sw_pressed = false;
+    }
+
+    // Encoder value, counted in hardware since the last call
+    int64_t current_encoder = encoder.getCount();
+    int64_t detents = current_encoder - last_encoder;
+    if (detents != 0) {
+        detents = (detents > INT16_MAX) ? INT16_MAX : (detents < -INT16_MAX) ? -INT16_MAX : detents;
+        // Counts without a queued edge were dropped from a full queue
+        uint32_t moved_ms = (encoder_ms != 0) ? encoder_ms : current_time;
+        int steps = encoder_accel.update((int)detents, moved_ms);
+        event.encoder = (int16_t)detents;
+        event.encoder_accel = (int16_t)((steps > INT16_MAX) ? INT16_MAX : (steps < -INT16_MAX) ? -INT16_MAX : steps);
+        last_encoder = current_encoder;
+        encoder_ms = 0;
+    }
+
+    // One change per button and event, in the order they happened
+    bool changed[ButtonCount] = {false, false};
+    while (changes_tail != changes_head) {
+        const Change& change = changes[changes_tail];
+        if (changed[change.source]) break;
+        changed[change.source] = true;
+
+        if (change.source == SourceButtonA) {
+            event.button_a = change.state;
+            event.button_a_ms = change.held_ms;
+        } else {
+            event.button_sw = change.state;
+            event.button_sw_ms = change.held_ms;
         }
-    } else if (button_sw_pressed) {
-        // Update hold status regardless of debounce
+        changes_tail = (changes_tail + 1) & (CHANGE_QUEUE_SIZE - 1);
+    }
+
+    // Hold status of buttons without a change, reported on every call
+    for (uint8_t i = changes_tail; i != changes_head; i = (i + 1) & (CHANGE_QUEUE_SIZE - 1)) {
+        changed[changes[i].source] = true; // Reported with a later event, no hold before it
+    }
+    if (!changed[SourceButtonA] && buttons[SourceButtonA].is_pressed()) {
+        event.button_a = ButtonHold;
+        event.button_a_ms = current_time - press_ms[SourceButtonA];
+    }
+    if (!changed[SourceButtonSw] && buttons[SourceButtonSw].is_pressed()) {
         event.button_sw = ButtonHold;
-        event.button_sw_ms = current_time - button_sw_press_time;
+        event.button_sw_ms = current_time - press_ms[SourceButtonSw];
     }
 
     return event;
@@ -100,7 +178,9 @@ void Event::print(const Event& event) {
         if (event.encoder != 0) {
             Serial.print("Encoder=");
             Serial.print(event.encoder);
-            Serial.print(" ");
+            Serial.print("(");
+            Serial.print(event.encoder_accel);
+            Serial.print(") ");
         }
         if (event.button_a != ButtonNone) {
             Serial.print("ButtonA=");
@@ -2,6 +2,8 @@
 
 #include <stdint.h>
 #include <Arduino.h>
+#include "button_debouncer.h"
+#include "encoder_accel.h"
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wcpp"
@@ -17,7 +19,8 @@ typedef enum {
 } Button;
 
 typedef struct Event {
-    int8_t encoder;    // Encoder value
+    int16_t encoder;   // Detents turned, for moving through items
+    int16_t encoder_accel; // Detents scaled by turning speed, for values with a wide range
     Button button_a;   // Button A state
     Button button_sw;  // Encoder switch state
     uint32_t button_a_ms; // Time in ms for Button A
@@ -26,27 +29,72 @@ typedef struct Event {
     static void print(const Event& event);
 } Event;
 
+// Buttons and encoder are read in GPIO interrupts, which queue timestamped
+// edges for the UI task. The encoder itself is counted by the PCNT unit,
+// its interrupt only wakes the UI task and dates the movement.
 class Input {
 public:
+    static const size_t QUEUE_SIZE = 32;
+
     Input();
-    Event get_inputs();
     void begin();
 
+    // Waits up to wait ticks for an input edge, returns at once if one is pending.
+    // Held buttons report ButtonHold on every call.
+    Event get_inputs(TickType_t wait = 0);
+
+    // Ends a wait in get_inputs() early, for other tasks with something to show
+    void wake(void);
+
+    uint32_t get_overruns(void) const { return overruns; }
+
 private:
+    enum Source : uint8_t {
+        SourceButtonA,
+        SourceButtonSw,
+        ButtonCount,
+        SourceEncoder = ButtonCount,
+        SourceWake,
+    };
+
+    struct Edge {
+        uint32_t time_ms;
+        Source source;
+        bool level_pressed;
+    };
+
+    // Debounced button change not reported yet, an event holds one per button
+    struct Change {
+        Source source;
+        Button state; // ButtonPress or ButtonRelease
+        uint32_t held_ms; // Press duration of a release
+    };
+    static const size_t CHANGE_QUEUE_SIZE = 8; // Power of two
+
     ESP32Encoder encoder;
     static const int BUTTON_A = 38;
     static const int ENCODER_SW = 39;
     static const int ENCODER_A = 34;
     static const int ENCODER_B = 35;
 
-    uint32_t button_a_press_time;
-    uint32_t button_sw_press_time;
-    bool button_a_pressed;
-    bool button_sw_pressed;
-    
-    // Debounce variables
-    int last_button_a_state;
-    int last_button_sw_state;
-    unsigned long last_button_a_change_time;
-    unsigned long last_button_sw_change_time;
+    QueueHandle_t queue;
+    volatile uint32_t overruns;
+
+    ButtonDebouncer buttons[ButtonCount];
+    uint32_t press_ms[ButtonCount];
+    Change changes[CHANGE_QUEUE_SIZE];
+    uint8_t changes_head;
+    uint8_t changes_tail;
+
+    EncoderAccel encoder_accel;
+    int64_t last_encoder;
+    uint32_t encoder_ms; // Time of the last encoder edge
+
+    void handle_edge(const Edge& edge);
+    void push_change(Source source, uint32_t time_ms);
+
+    void queue_edge(Source source, bool level_pressed);
+    static void IRAM_ATTR on_button_a(void* arg);
+    static void IRAM_ATTR on_button_sw(void* arg);
+    static void IRAM_ATTR on_encoder(void* arg);
 };
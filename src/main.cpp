@@ -15,9 +15,10 @@
 #include "signal_processor/signal_processor.h"
 #include "screen_switcher.h"
 #include "testmode.h"
+#include "task_load.h"
 
-// Create display object
-Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, OLED_RESET);
+// Create display object, frames are sent by its own task
+Display display(&Wire, OLED_RESET);
 
 // Create input handler
 Input input_handler;
@@ -40,6 +41,100 @@ Adafruit_NeoPixel pixels(1, NEO_PIXEL_PIN, NEO_GRB + NEO_KHZ800);
 
 void osc_init(SignalProcessor* signal_processor);
 
+TaskHandle_t ui_task_handle = nullptr;
+TaskLoad ui_task_load;
+
+void ui_update(Event& event) {
+    static bool screen_switched = false;
+
+    // Handle screen switching with a state machine approach
+    if (event.button_a == ButtonRelease) {
+        screen_switched = false;
+    } else if (event.button_a == ButtonHold && event.button_a_ms > 400 && !screen_switched) {
+        // Switch screen only if the button was released before and hasn't switched screens in this hold session
+        screen_switcher.set_screen(screen_switcher.get_next());
+        screen_switched = true;
+    }
+
+    // Update current screen
+    screen_switcher.update(&event);
+
+    // Event::print(event);
+}
+
+// Settings changed on another task, e.g. by Program Change, are drawn without waiting for the refresh
+void on_settings_change(void) {
+    if (xTaskGetCurrentTaskHandle() != ui_task_handle) {
+        input_handler.wake();
+    }
+}
+
+// Input, display and NVS work runs here, away from the audio core
+void ui_task(void* parameter) {
+    unsigned long last_report = millis();
+    unsigned long last_frame_report = millis();
+    uint32_t updates = 0;
+    uint32_t last_frames = ScreenInterface::get_frame_count();
+    uint32_t last_render_cycles = 0;
+    uint32_t last_rendered_blocks = 0;
+    TickType_t last_update = xTaskGetTickCount();
+
+    while (true) {
+        ScreenInterface* screen = screen_switcher.get_current_screen();
+        TickType_t frame = pdMS_TO_TICKS(screen->get_frame_ms());
+        TickType_t refresh = pdMS_TO_TICKS(screen->get_refresh_ms());
+        if (DEBUG_UI_REDRAW_ALWAYS) {
+            frame = refresh = pdMS_TO_TICKS(UI_FRAME_MS);
+        }
+
+        // Frame cap, input arriving meanwhile is handled in one update
+        TickType_t elapsed = xTaskGetTickCount() - last_update;
+        if (elapsed < frame) {
+            vTaskDelay(frame - elapsed);
+        }
+
+        // Sleeps until input, a settings change or the refresh tick. The screens
+        // only draw what changed, so most wakeups end without a frame. Waiting
+        // at least a tick lets the idle task on this core feed the watchdog.
+        elapsed = xTaskGetTickCount() - last_update;
+        Event event = input_handler.get_inputs((elapsed < refresh) ? refresh - elapsed : 1);
+        last_update = xTaskGetTickCount();
+
+        if (DEBUG_TASK_LOAD) ui_task_load.begin();
+        ui_update(event);
+        if (DEBUG_TASK_LOAD) ui_task_load.end();
+        updates++;
+
+        if (DEBUG_TASK_LOAD && millis() - last_report >= TASK_LOAD_REPORT_MS) {
+            last_report = millis();
+            float ui_load = ui_task_load.report();
+            float audio_load = signal_processor.task_load.report();
+            uint32_t frames = ScreenInterface::get_frame_count();
+            // Core 0 is idle for the rest, less the rare settings writes
+            Serial.printf("task load: audio %.1f%%, ui %.1f%% (%u updates, %u frames)\n",
+                          audio_load, ui_load, (unsigned)updates, (unsigned)(frames - last_frames));
+            updates = 0;
+            last_frames = frames;
+
+            // Mixer cost per stereo sample of the oscillator voices
+            uint32_t render_cycles = signal_processor.render_load.busy_cycles;
+            uint32_t rendered_blocks = signal_processor.rendered_blocks;
+            uint32_t samples = (rendered_blocks - last_rendered_blocks) * SignalProcessor::AUDIO_BLOCK_SIZE;
+            if (samples > 0) {
+                Serial.printf("render: %u cycles per stereo sample\n",
+                              (unsigned)((render_cycles - last_render_cycles) / samples));
+            }
+            last_render_cycles = render_cycles;
+            last_rendered_blocks = rendered_blocks;
+        }
+
+        if (DEBUG_FRAME_TIMES && millis() - last_frame_report >= TASK_LOAD_REPORT_MS) {
+            last_frame_report = millis();
+            display.print_stats();
+        }
+    }
+}
+
 void setup() {
     pinMode(OUT_CHANNELS[OutChannelClk].pin, OUTPUT);
     pinMode(OUT_CHANNELS[OutChannelRst].pin, OUTPUT);
@@ -56,7 +151,7 @@ void setup() {
     }
     display.setRotation(2);
     display.clearDisplay();
-    display.display();
+    display.present();
 
     // Initialize NVS
     esp_err_t err = nvs_flash_init();
@@ -69,10 +164,10 @@ void setup() {
     ESP_ERROR_CHECK(err);
 
     // Initialize input handler
-    input_handler = Input();
+    input_handler.begin();
 
     midi_settings_state.begin();
-    signal_processor.begin();
+    midi_settings_state.set_change_callback(on_settings_change);
 
     // Check for test mode
     nvs_handle_t nvs_handle;
@@ -113,25 +208,22 @@ void setup() {
     midi_screen.begin();
 
     screen_switcher.set_screen(1);
+
+    xTaskCreatePinnedToCore(
+        ui_task,
+        "UI_Task",
+        UI_TASK_STACK_SIZE,
+        nullptr,
+        UI_TASK_PRIORITY,
+        &ui_task_handle,
+        UI_TASK_CORE
+    );
+
+    // Started last: the audio task outranks this setup task on the audio core
+    signal_processor.begin();
 }
 
 void loop() {
-    // Get input events
-    Event event = input_handler.get_inputs();
-
-    static bool screen_switched = false;
-
-    // Handle screen switching with a state machine approach
-    if (event.button_a == ButtonRelease) {
-        screen_switched = false;
-    } else if (event.button_a == ButtonHold && event.button_a_ms > 400 && !screen_switched) {
-        // Switch screen only if the button was released before and hasn't switched screens in this hold session
-        screen_switcher.set_screen(screen_switcher.get_next());
-        screen_switched = true;
-    }
-
-    // Update current screen
-    screen_switcher.update(&event);
-
-    // Event::print(event);
+    // All work happens in the pinned tasks
+    vTaskDelete(NULL);
 }
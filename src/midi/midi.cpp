@@ -4,12 +4,14 @@ MidiRoot::MidiRoot(Display* display, MidiSettingsState* state, SignalProcessor*
     : ScreenInterface(display),
       midi_info(display, state, processor, nullptr),
       midi_settings(display, state, processor, nullptr),
+      midi_clock(display, state, nullptr),
       state(state),
       processor(processor) {
 
     // Initialize MIDI screens array
     midi_screens[MidiScreen::MidiScreenInfo] = &midi_info;
     midi_screens[MidiScreen::MidiScreenSettings] = &midi_settings;
+    midi_screens[MidiScreen::MidiScreenClock] = &midi_clock;
 
     // Initialize screen switcher with the screens array
     screen_switcher = ScreenSwitcher(midi_screens, MidiScreen::MidiScreenCount);
@@ -17,6 +19,7 @@ MidiRoot::MidiRoot(Display* display, MidiSettingsState* state, SignalProcessor*
     // Set screen_switcher pointer in midi_info and midi_settings
     midi_info.set_screen_switcher(&screen_switcher);
     midi_settings.set_screen_switcher(&screen_switcher);
+    midi_clock.set_screen_switcher(&screen_switcher);
 }
 
 void MidiRoot::begin(void) {
@@ -40,5 +43,12 @@ void MidiRoot::update(Event* event) {
     }
 
     // Update the current sub-screen with the event
+    ScreenInterface* screen = screen_switcher.get_current_screen();
     screen_switcher.update(event);
+
+    // A screen switched to is drawn now, not at the next refresh
+    if (screen_switcher.get_current_screen() != screen) {
+        Event none = {0, 0, ButtonNone, ButtonNone, 0, 0};
+        screen_switcher.update(&none);
+    }
 }
@@ -6,12 +6,14 @@
 #include "../screen_switcher.h"
 #include "midi_info.h"
 #include "midi_settings.h"
+#include "midi_clock.h"
 #include "midi_settings_state.h"
 #include "../signal_processor/signal_processor.h"
 
 enum MidiScreen {
     MidiScreenInfo,
     MidiScreenSettings,
+    MidiScreenClock,
     MidiScreenCount
 };
 
@@ -22,10 +24,15 @@ public:
     void enter() override;
     void exit() override;
     void update(Event* event) override;
+    // Text only, faster would not read any better
+    uint32_t get_frame_ms() override { return FRAME_MS; }
 
 private:
+    static const uint32_t FRAME_MS = 40;
+
     MidiInfo midi_info;
     MidiSettings midi_settings;
+    MidiClock midi_clock;
     ScreenInterface* midi_screens[MidiScreen::MidiScreenCount];
     ScreenSwitcher screen_switcher;
     MidiSettingsState* state;
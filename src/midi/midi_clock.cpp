@@ -0,0 +1,180 @@
+#include "midi.h"
+#include "midi_clock.h"
+#include "util.h"
+
+constexpr const char* MidiClock::OUTPUT_NAMES[OutChannelCount];
+
+MidiClock::MidiClock(Display* display, MidiSettingsState* state, ScreenSwitcher* screen_switcher)
+    : ScreenInterface(display), state(state), screen_switcher(screen_switcher),
+      current_output(0), current_column(ColumnMul), is_editing(false), is_drawn(false) {}
+
+void MidiClock::set_screen_switcher(ScreenSwitcher* screen_switcher) {
+    this->screen_switcher = screen_switcher;
+}
+
+void MidiClock::enter() {
+    current_output = 0;
+    current_column = ColumnMul;
+    is_editing = false;
+    is_drawn = false;
+}
+
+void MidiClock::exit() {
+
+}
+
+void MidiClock::get_view(View* view) {
+    memset(view, 0, sizeof(*view)); // Padding too, views are compared with memcmp
+    view->version = state->get_version();
+    view->current_output = current_output;
+    view->current_column = current_column;
+    view->is_editing = is_editing;
+}
+
+void MidiClock::render() {
+    display->clearDisplay();
+    display->setTextSize(1);
+    display->setTextColor(SSD1306_WHITE, SSD1306_BLACK);
+
+    display->setCursor(0, 0);
+    display->print("Out");
+    display->setCursor(COL_X[ColumnMul], 0);
+    display->print("mul div phs  pw");
+
+    for (size_t i = 0; i < OutChannelCount; i++) {
+        int y = FIRST_ROW_Y + i * LINE_HEIGHT;
+        ClockRatio ratio = state->get_clock_ratio(i);
+        bool is_clock = state->is_clock_type(state->get_midi_out_type(i));
+
+        display->setTextColor(SSD1306_WHITE, SSD1306_BLACK);
+        display->setCursor(2, y + 1);
+        display->print(OUTPUT_NAMES[i]);
+        if (!is_clock) {
+            // Settings are kept but unused until the output is a clock
+            display->print("-");
+        }
+
+        char values[ColumnCount][8];
+        snprintf(values[ColumnMul], sizeof(values[0]), "%d", ratio.mul);
+        snprintf(values[ColumnDiv], sizeof(values[0]), "%d", ratio.div);
+        snprintf(values[ColumnPhase], sizeof(values[0]), "%d%%", ratio.phase);
+        snprintf(values[ColumnPulse], sizeof(values[0]), "%d", ratio.pulse_ms);
+
+        for (int col = 0; col < ColumnCount; col++) {
+            bool selected = (i == current_output) && (col == current_column);
+            if (selected && is_editing) {
+                display->fillRect(COL_X[col] - 1, y, COL_WIDTH[col], LINE_HEIGHT, SSD1306_WHITE);
+                display->setTextColor(SSD1306_BLACK, SSD1306_WHITE); // Inverted for editing
+            } else {
+                if (selected) {
+                    display->drawRect(COL_X[col] - 1, y, COL_WIDTH[col], LINE_HEIGHT, SSD1306_WHITE);
+                }
+                display->setTextColor(SSD1306_WHITE, SSD1306_BLACK);
+            }
+            display->setCursor(COL_X[col], y + 1);
+            display->print(values[col]);
+        }
+    }
+
+    render_tx_row();
+
+    show();
+}
+
+void MidiClock::render_tx_row() {
+    int y = FIRST_ROW_Y + TX_ROW * LINE_HEIGHT;
+
+    display->setTextColor(SSD1306_WHITE, SSD1306_BLACK);
+    display->setCursor(2, y + 1);
+    display->print("TX");
+
+    int x = COL_X[ColumnMul];
+    if (current_output == TX_ROW && is_editing) {
+        display->fillRect(x - 1, y, SCREEN_WIDTH - x + 1, LINE_HEIGHT, SSD1306_WHITE);
+        display->setTextColor(SSD1306_BLACK, SSD1306_WHITE); // Inverted for editing
+    } else if (current_output == TX_ROW) {
+        display->drawRect(x - 1, y, SCREEN_WIDTH - x + 1, LINE_HEIGHT, SSD1306_WHITE);
+    }
+    display->setCursor(x, y + 1);
+    display->print(state->get_midi_tx_type_str());
+}
+
+void MidiClock::edit_value(int delta) {
+    if (current_output == TX_ROW) {
+        state->set_midi_tx_type((MidiTxType)clampi(state->get_midi_tx_type() + delta,
+                                                   state->get_min_midi_tx_type(),
+                                                   state->get_max_midi_tx_type()));
+        state->store();
+        return;
+    }
+
+    ClockRatio ratio = state->get_clock_ratio(current_output);
+
+    // Clamp as int, the fields are uint8_t and would wrap below zero
+    switch (current_column) {
+        case ColumnMul:
+            ratio.mul = clampi(ratio.mul + delta, state->MIN_CLOCK_MUL, state->MAX_CLOCK_MUL);
+            break;
+        case ColumnDiv:
+            ratio.div = clampi(ratio.div + delta, state->MIN_CLOCK_DIV, state->MAX_CLOCK_DIV);
+            break;
+        case ColumnPhase:
+            ratio.phase = clampi(ratio.phase + delta, state->MIN_CLOCK_PHASE, state->MAX_CLOCK_PHASE);
+            break;
+        case ColumnPulse:
+            ratio.pulse_ms = clampi(ratio.pulse_ms + delta, state->MIN_CLOCK_PULSE_MS, state->MAX_CLOCK_PULSE_MS);
+            break;
+    }
+
+    state->set_clock_ratio(current_output, ratio);
+    state->store();
+}
+
+void MidiClock::handle_input(Event* event) {
+    if (event == nullptr) return;
+
+    if (is_editing) {
+        if (event->button_sw == ButtonPress || event->button_a == ButtonPress) {
+            is_editing = false;
+        }
+    } else {
+        if (event->button_sw == ButtonPress) {
+            is_editing = true;
+        }
+
+        if (event->button_a == ButtonPress) {
+            screen_switcher->set_screen(MidiScreen::MidiScreenSettings);
+        }
+    }
+
+    if (event->encoder == 0) return;
+
+    if (is_editing) {
+        edit_value(event->encoder_accel);
+        return;
+    }
+
+    // Move selection across columns, wrapping into the next/previous output.
+    // The TX row has a single position after the last output column.
+    int position = current_output * ColumnCount + current_column + event->encoder;
+    position = clampi(position, 0, TX_ROW * ColumnCount);
+    current_output = position / ColumnCount;
+    current_column = position % ColumnCount;
+}
+
+void MidiClock::update(Event* event) {
+    handle_input(event);
+
+    if (screen_switcher->get_current_screen() != this) {
+        return; // Switched away, the next screen draws
+    }
+
+    View view;
+    get_view(&view);
+    if (!DEBUG_UI_REDRAW_ALWAYS && is_drawn && memcmp(&view, &drawn, sizeof(view)) == 0) {
+        return;
+    }
+    render();
+    drawn = view;
+    is_drawn = true;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "../urack_types.h"
+#include "../screen_switcher.h"
+#include "midi_settings_state.h"
+
+// Per output clock ratio, phase and pulse width, and what is sent on MIDI out
+class MidiClock : public ScreenInterface {
+public:
+    MidiClock(Display* display, MidiSettingsState* state, ScreenSwitcher* screen_switcher = nullptr);
+    void set_screen_switcher(ScreenSwitcher* screen_switcher);
+    void enter() override;
+    void exit() override;
+    void update(Event* event) override;
+
+private:
+    enum Column {
+        ColumnMul,
+        ColumnDiv,
+        ColumnPhase,
+        ColumnPulse,
+        ColumnCount
+    };
+
+    static constexpr const char* OUTPUT_NAMES[OutChannelCount] = {"A", "B", "C", "CLK", "RST"};
+
+    const int COL_X[ColumnCount] = {30, 54, 78, 104};
+    const int COL_WIDTH[ColumnCount] = {18, 18, 24, 24};
+    const int LINE_HEIGHT = 8;
+    const int FIRST_ROW_Y = 12;
+
+    static const size_t TX_ROW = OutChannelCount; // After the outputs, single column
+
+    // Everything the screen shows, it is only redrawn when this changes
+    struct View {
+        uint32_t version; // Settings
+        size_t current_output;
+        int current_column;
+        bool is_editing;
+    };
+
+    MidiSettingsState* state;
+    ScreenSwitcher* screen_switcher;
+    size_t current_output; // TX_ROW for the MIDI out row
+    int current_column;
+    bool is_editing;
+    View drawn;
+    bool is_drawn; // drawn is on the display
+
+    void get_view(View* view);
+    void render(void);
+    void render_tx_row(void);
+    void handle_input(Event* event);
+    void edit_value(int delta);
+};
@@ -0,0 +1,102 @@
+#include "midi_coalescer.h"
+
+MidiCoalescer::MidiCoalescer() {
+    reset();
+}
+
+void MidiCoalescer::reset(void) {
+    channel_dirty = 0;
+    for (size_t ch = 0; ch < CHANNEL_COUNT; ch++) {
+        pending[ch] = 0;
+        time_us[ch] = 0;
+        pitchbend[ch] = 0x2000;
+        aftertouch[ch] = 0;
+        for (size_t i = 0; i < 4; i++) {
+            cc_dirty[ch][i] = 0;
+        }
+    }
+    absorbed = 0;
+    coalesced = 0;
+}
+
+bool MidiCoalescer::push(const MidiMessage& message) {
+    if (!message.is_channel_message()) {
+        return false;
+    }
+
+    uint8_t ch = message.get_channel();
+
+    switch (message.get_type()) {
+        case 0xB0: {
+            uint8_t cc = message.data1 & 0x7F;
+            uint32_t bit = 1u << (cc & 31);
+            if (cc_dirty[ch][cc >> 5] & bit) coalesced++;
+            cc_dirty[ch][cc >> 5] |= bit;
+            cc_value[ch][cc] = message.data2;
+            pending[ch] |= PendingCc;
+            break;
+        }
+        case 0xD0:
+            if (pending[ch] & PendingAftertouch) coalesced++;
+            aftertouch[ch] = message.data1;
+            pending[ch] |= PendingAftertouch;
+            break;
+        case 0xE0:
+            if (pending[ch] & PendingPitchBend) coalesced++;
+            pitchbend[ch] = (message.data2 << 7) | message.data1;
+            pending[ch] |= PendingPitchBend;
+            break;
+        default:
+            return false;
+    }
+
+    time_us[ch] = message.time_us;
+    channel_dirty |= 1u << ch;
+    absorbed++;
+    return true;
+}
+
+bool MidiCoalescer::pop(MidiMessage* out) {
+    if (channel_dirty == 0) {
+        return false;
+    }
+    return pop_channel(__builtin_ctz(channel_dirty), out);
+}
+
+bool MidiCoalescer::pop_channel(uint8_t ch, MidiMessage* out) {
+    if (ch == 0 || ch >= CHANNEL_COUNT || pending[ch] == 0) {
+        return false;
+    }
+
+    out->time_us = time_us[ch];
+
+    if (pending[ch] & PendingPitchBend) {
+        pending[ch] &= ~PendingPitchBend;
+        out->status = 0xE0 | (ch - 1);
+        out->data1 = pitchbend[ch] & 0x7F;
+        out->data2 = pitchbend[ch] >> 7;
+    } else if (pending[ch] & PendingAftertouch) {
+        pending[ch] &= ~PendingAftertouch;
+        out->status = 0xD0 | (ch - 1);
+        out->data1 = aftertouch[ch];
+        out->data2 = 0;
+    } else {
+        size_t word = 0;
+        while (cc_dirty[ch][word] == 0) {
+            word++;
+        }
+        uint8_t cc = (word << 5) | __builtin_ctz(cc_dirty[ch][word]);
+        cc_dirty[ch][word] &= cc_dirty[ch][word] - 1;
+        if ((cc_dirty[ch][0] | cc_dirty[ch][1] | cc_dirty[ch][2] | cc_dirty[ch][3]) == 0) {
+            pending[ch] &= ~PendingCc;
+        }
+        out->status = 0xB0 | (ch - 1);
+        out->data1 = cc;
+        out->data2 = cc_value[ch][cc];
+    }
+
+    if (pending[ch] == 0) {
+        channel_dirty &= ~(1u << ch);
+    }
+    return true;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "midi_parser.h"
+
+// Collapses continuous controller messages (CC, pitch bend, channel aftertouch)
+// to the latest value per channel and controller until they are popped.
+// Everything else is left to the caller to dispatch in order; before a note
+// message the caller pops the pending values of its channel, so notes always
+// see the controller state that was sent before them.
+class MidiCoalescer
+{
+public:
+    static const size_t CHANNEL_COUNT = 16 + 1; // 1..16, matches MIDI_CHANNEL_COUNT
+
+    MidiCoalescer();
+    void reset(void);
+
+    // Returns true if the message was absorbed, false if it must be dispatched now
+    bool push(const MidiMessage& message);
+
+    // Pending values, one message per call, lowest channel first
+    bool pop(MidiMessage* out);
+    bool pop_channel(uint8_t channel, MidiMessage* out);
+
+    bool is_pending(void) const { return channel_dirty != 0; }
+
+    uint32_t get_absorbed(void) const { return absorbed; }
+    uint32_t get_coalesced(void) const { return coalesced; } // Handler calls saved
+
+private:
+    enum Pending : uint8_t {
+        PendingPitchBend = 1 << 0,
+        PendingAftertouch = 1 << 1,
+        PendingCc = 1 << 2,
+    };
+
+    uint32_t channel_dirty; // Bit per channel with any pending value
+    uint8_t pending[CHANNEL_COUNT];
+    uint32_t time_us[CHANNEL_COUNT]; // Arrival of the newest pending value
+    uint16_t pitchbend[CHANNEL_COUNT]; // Raw 14 bit
+    uint8_t aftertouch[CHANNEL_COUNT];
+    uint32_t cc_dirty[CHANNEL_COUNT][4];
+    uint8_t cc_value[CHANNEL_COUNT][128];
+
+    uint32_t absorbed;
+    uint32_t coalesced;
+};
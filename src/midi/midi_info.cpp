@@ -3,7 +3,8 @@
 #include "util.h"
 
 MidiInfo::MidiInfo(Display* display, MidiSettingsState* state, SignalProcessor* processor, ScreenSwitcher* screen_switcher)
-    : ScreenInterface(display), state(state), processor(processor), screen_switcher(screen_switcher) {
+    : ScreenInterface(display), state(state), processor(processor), screen_switcher(screen_switcher),
+      edit_preset(false), button_a_pressed(false), is_drawn(false) {
     // Initialize any specific properties
 }
 
@@ -12,14 +13,27 @@ void MidiInfo::set_screen_switcher(ScreenSwitcher* screen_switcher) {
 }
 
 void MidiInfo::enter() {
-
+    edit_preset = false;
+    button_a_pressed = false;
+    is_drawn = false;
 }
 
 void MidiInfo::exit() {
 
 }
 
-void MidiInfo::render() {
+void MidiInfo::get_view(View* view) {
+    memset(view, 0, sizeof(*view)); // Padding too, views are compared with memcmp
+    view->version = state->get_version();
+    if (state->get_midi_clk_type() != MidiClkType::MidiClkInt) {
+        float bpm = processor->get_clock_bpm();
+        view->bpm_tenths = (processor->is_clock_lost() || bpm <= 0) ? -1 : (int)lroundf(bpm * 10);
+    }
+    memcpy(view->last_out, processor->last_out, sizeof(view->last_out));
+    view->edit_preset = edit_preset;
+}
+
+void MidiInfo::render(const View& view) {
     display->clearDisplay();
     display->setTextSize(1);
     display->setTextColor(SSD1306_WHITE);
@@ -27,7 +41,16 @@ void MidiInfo::render() {
 
     char buffer[32];
     display->setTextSize(2);
-    sprintf(buffer, "BPM: %s", state->get_bpm_str());
+    if (state->get_midi_clk_type() != MidiClkType::MidiClkInt) {
+        // Tracked tempo, dashes while no clock is locked
+        if (view.bpm_tenths < 0) {
+            sprintf(buffer, "BPM: --");
+        } else {
+            sprintf(buffer, "BPM: %d.%d", view.bpm_tenths / 10, view.bpm_tenths % 10);
+        }
+    } else {
+        sprintf(buffer, "BPM: %s", state->get_bpm_str());
+    }
     display->println(buffer);
     display->setTextSize(1);
 
@@ -36,29 +59,52 @@ void MidiInfo::render() {
             state->get_midi_clk_type_str());
     display->println(buffer);
     display->print("         ");
-    display->print(processor->last_out[OutChannelClk] > 0 ? "[CLK]" : " CLK ");
+    display->print(view.last_out[OutChannelClk] > 0 ? "[CLK]" : " CLK ");
     display->print(" ");
-    display->println(processor->last_out[OutChannelRst] > 0 ? "[RST]" : " RST ");
+    display->println(view.last_out[OutChannelRst] > 0 ? "[RST]" : " RST ");
 
 
-    sprintf(buffer, "A: %s %d", state->get_midi_out_type_str(OutChannelA), processor->last_out[OutChannelA]);
+    sprintf(buffer, "A: %s %d", state->get_midi_out_type_str(OutChannelA), view.last_out[OutChannelA]);
     display->println(buffer);
-    sprintf(buffer, "B: %s %d", state->get_midi_out_type_str(OutChannelB), processor->last_out[OutChannelB]);
+    sprintf(buffer, "B: %s %d", state->get_midi_out_type_str(OutChannelB), view.last_out[OutChannelB]);
     display->println(buffer);
-    sprintf(buffer, "C: %s %d", state->get_midi_out_type_str(OutChannelC), processor->last_out[OutChannelC]);
+    sprintf(buffer, "C: %s %d", state->get_midi_out_type_str(OutChannelC), view.last_out[OutChannelC]);
     display->println(buffer);
 
-    display->display();
+    sprintf(buffer, "Preset %s", state->get_preset_str());
+    if (view.edit_preset) {
+        display->setTextColor(SSD1306_BLACK, SSD1306_WHITE); // Inverted while the encoder selects it
+    }
+    display->print(buffer);
+    display->setTextColor(SSD1306_WHITE, SSD1306_BLACK);
+
+    show();
 }
 
 void MidiInfo::handle_input(Event* event) {
     if (event == nullptr) return;
 
+    if (event->button_a == ButtonPress) {
+        button_a_pressed = true;
+    } else if (event->button_a == ButtonRelease) {
+        if (button_a_pressed && event->button_a_ms < CLICK_MS) {
+            edit_preset = !edit_preset;
+        }
+        button_a_pressed = false;
+    }
+
     if (event->encoder != 0) {
-        state->set_bpm(clampi(state->get_bpm() + event->encoder,
-                           state->get_min_bpm(),
-                           state->get_max_bpm()));
-        state->store(); // TODO: delay before storing for saving FLASH
+        if (edit_preset) {
+            int preset = clampi((int)state->get_preset() + event->encoder, 0, state->get_preset_count() - 1);
+            if (state->select_preset(preset)) {
+                state->store(); // Comes back active after a restart
+            }
+        } else {
+            state->set_bpm(clampi(state->get_bpm() + event->encoder_accel,
+                               state->get_min_bpm(),
+                               state->get_max_bpm()));
+            state->store();
+        }
     }
 
     if(event->button_sw == ButtonPress) {
@@ -68,5 +114,17 @@ void MidiInfo::handle_input(Event* event) {
 
 void MidiInfo::update(Event* event) {
     handle_input(event);
-    render();
+
+    if (screen_switcher->get_current_screen() != this) {
+        return; // Switched away, the next screen draws
+    }
+
+    View view;
+    get_view(&view);
+    if (!DEBUG_UI_REDRAW_ALWAYS && is_drawn && memcmp(&view, &drawn, sizeof(view)) == 0) {
+        return;
+    }
+    render(view);
+    drawn = view;
+    is_drawn = true;
 }
@@ -15,9 +15,24 @@ public:
     void update(Event* event) override;
 
 private:
+    static const uint32_t CLICK_MS = 400; // Longer holds of button A switch screens in ui_update()
+
+    // Everything the screen shows, it is only redrawn when this changes
+    struct View {
+        uint32_t version; // Settings
+        int bpm_tenths; // Tracked tempo, -1 while no clock is locked
+        uint8_t last_out[OutChannelCount];
+        bool edit_preset;
+    };
+
     MidiSettingsState* state;
     SignalProcessor* processor;
     ScreenSwitcher* screen_switcher;
-    void render();
+    bool edit_preset; // Encoder selects the preset instead of the tempo, toggled by a click on A
+    bool button_a_pressed; // Press seen on this screen, a release alone came from another one
+    View drawn;
+    bool is_drawn; // drawn is on the display
+    void get_view(View* view);
+    void render(const View& view);
     void handle_input(Event* event);
 };
@@ -0,0 +1,38 @@
+#include "midi_input.h"
+#include <esp_timer.h>
+
+MidiInput::MidiInput() {
+    serial = nullptr;
+    thru = nullptr;
+}
+
+void MidiInput::begin(HardwareSerial* serial, MidiOutput* thru) {
+    this->serial = serial;
+    this->thru = thru;
+
+    // Raise the RX event for every byte instead of waiting for the FIFO to fill
+    serial->setRxFIFOFull(1);
+    serial->setRxTimeout(1);
+
+    serial->onReceiveError([this](hardwareSerial_error_t error) { on_receive_error(error); });
+    serial->onReceive([this]() { on_receive(); }, false);
+}
+
+void MidiInput::on_receive(void) {
+    while (serial->available() > 0) {
+        uint8_t byte = serial->read();
+        uint32_t now = (uint32_t)esp_timer_get_time();
+
+        if (thru != nullptr) {
+            thru->thru(byte);
+        }
+
+        receiver.receive(byte, now);
+    }
+}
+
+void MidiInput::on_receive_error(hardwareSerial_error_t error) {
+    if (error == UART_FIFO_OVF_ERROR || error == UART_BUFFER_FULL_ERROR) {
+        receiver.count_overrun();
+    }
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <Arduino.h>
+#include "midi_receiver.h"
+#include "midi_output.h"
+
+// Event driven MIDI receiver.
+// Bytes are parsed in the UART event task as they arrive, complete messages
+// are timestamped and queued for the processor task. Raw bytes are handed
+// to the thru output before parsing, so thru adds no parsing latency.
+class MidiInput
+{
+public:
+    MidiInput();
+    void begin(HardwareSerial* serial, MidiOutput* thru = nullptr);
+
+    // Consumer side, returns false when no message is pending
+    bool read(MidiMessage* message) { return receiver.read(message); }
+
+    uint32_t get_overruns(void) const { return receiver.get_overruns(); } // UART FIFO/buffer overflows and ring full events
+    uint32_t get_dropped_bytes(void) const { return receiver.get_dropped_bytes(); }
+
+private:
+    HardwareSerial* serial;
+    MidiOutput* thru;
+    MidiReceiver receiver;
+
+    void on_receive(void);
+    void on_receive_error(hardwareSerial_error_t error);
+};
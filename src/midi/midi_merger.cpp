@@ -0,0 +1,101 @@
+#include "midi_merger.h"
+
+MidiMerger::MidiMerger() {
+    filter_timing = false;
+    reset();
+}
+
+void MidiMerger::reset(void) {
+    thru_head = 0;
+    thru_tail = 0;
+    realtime_head = 0;
+    realtime_tail = 0;
+    skip_data = 0;
+    next_realtime_us = NO_EVENT;
+    line_free_us = 0;
+    dropped_bytes = 0;
+}
+
+bool MidiMerger::is_timing(uint8_t byte) {
+    switch (byte) {
+        case 0xF2: // Song position pointer
+        case 0xF8: // Clock
+        case 0xFA: // Start
+        case 0xFB: // Continue
+        case 0xFC: // Stop
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool MidiMerger::push_thru(uint8_t byte) {
+    if (skip_data > 0) {
+        if (byte < 0x80) {
+            skip_data--;
+            return true;
+        }
+        // A new status ends the dropped message, real-time bytes do not
+        if (byte < 0xF8) {
+            skip_data = 0;
+        }
+    }
+
+    if (filter_timing && is_timing(byte)) {
+        if (byte == 0xF2) {
+            skip_data = 2;
+        }
+        return true;
+    }
+
+    uint8_t next = (thru_head + 1) & (THRU_SIZE - 1);
+    if (next == thru_tail) {
+        dropped_bytes++;
+        return false;
+    }
+    thru[thru_head] = byte;
+    thru_head = next;
+    return true;
+}
+
+bool MidiMerger::push_realtime(uint8_t byte) {
+    uint8_t next = (realtime_head + 1) & (REALTIME_SIZE - 1);
+    if (byte < 0xF8 || next == realtime_tail) {
+        return false;
+    }
+    realtime[realtime_head] = byte;
+    realtime_head = next;
+    return true;
+}
+
+void MidiMerger::send(uint64_t now_us) {
+    uint64_t start = (line_free_us > now_us) ? line_free_us : now_us;
+    line_free_us = start + BYTE_US;
+}
+
+bool MidiMerger::pop(uint64_t now_us, uint8_t* byte) {
+    if (realtime_tail != realtime_head) {
+        *byte = realtime[realtime_tail];
+        realtime_tail = (realtime_tail + 1) & (REALTIME_SIZE - 1);
+        send(now_us);
+        return true;
+    }
+
+    if (thru_tail == thru_head) {
+        return false;
+    }
+
+    // Hold the byte if it would still be sending when the next generated one is due.
+    // A due time more than a byte in the past is stale and holds nothing.
+    uint64_t start = (line_free_us > now_us) ? line_free_us : now_us;
+    if (next_realtime_us != NO_EVENT &&
+        start + BYTE_US > next_realtime_us &&
+        now_us <= next_realtime_us + BYTE_US) {
+        return false;
+    }
+
+    *byte = thru[thru_tail];
+    thru_tail = (thru_tail + 1) & (THRU_SIZE - 1);
+    send(now_us);
+    return true;
+}
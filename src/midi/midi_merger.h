@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Merges the raw MIDI thru stream with locally generated real-time bytes.
+// Real-time bytes are valid anywhere in a stream, even inside a message, so
+// generated ones go out as soon as they are due and never break the running
+// status of thru messages. Thru bytes are passed through unchanged, except
+// that received timing messages (clock, start, continue, stop and song
+// position) can be dropped whole while the module is the clock master.
+// A thru byte is held back if it would still be on the wire when the next
+// generated byte is due, so the clock never waits behind thru traffic.
+// Has no hardware dependencies: the owner feeds bytes in and writes whatever
+// pop() returns to the UART.
+class MidiMerger
+{
+public:
+    static const uint32_t BYTE_US = 320; // 10 bits at 31250 baud
+    static const size_t THRU_SIZE = 64; // Power of two
+    static const size_t REALTIME_SIZE = 8; // Power of two
+    static const uint64_t NO_EVENT = UINT64_MAX;
+
+    MidiMerger();
+    void reset(void);
+
+    // Drop received timing messages instead of forwarding them
+    void set_filter_timing(bool filter) { filter_timing = filter; }
+    // When the next generated byte is due, NO_EVENT if none is scheduled
+    void set_next_realtime_us(uint64_t time_us) { next_realtime_us = time_us; }
+
+    // Received byte, returns false if it was dropped because the buffer is full
+    bool push_thru(uint8_t byte);
+    // Generated real-time byte (0xF8..0xFF), sent before any waiting thru byte
+    bool push_realtime(uint8_t byte);
+
+    // Returns true and fills byte if one should be written to the UART at now_us
+    bool pop(uint64_t now_us, uint8_t* byte);
+
+    // When the bytes handed out by pop() so far are done sending
+    uint64_t get_line_free_us(void) const { return line_free_us; }
+    uint32_t get_dropped_bytes(void) const { return dropped_bytes; }
+
+private:
+    uint8_t thru[THRU_SIZE];
+    uint8_t thru_head;
+    uint8_t thru_tail;
+    uint8_t realtime[REALTIME_SIZE];
+    uint8_t realtime_head;
+    uint8_t realtime_tail;
+
+    bool filter_timing;
+    uint8_t skip_data; // Data bytes of a dropped song position still to come
+    uint64_t next_realtime_us;
+    uint64_t line_free_us;
+    uint32_t dropped_bytes;
+
+    static bool is_timing(uint8_t byte);
+    void send(uint64_t now_us);
+};
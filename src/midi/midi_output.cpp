@@ -0,0 +1,61 @@
+#include "midi_output.h"
+#include <esp_timer.h>
+
+MidiOutput::MidiOutput() {
+    serial = nullptr;
+    lock = nullptr;
+    thru_enabled = false;
+}
+
+void MidiOutput::begin(HardwareSerial* serial) {
+    this->serial = serial;
+    lock = xSemaphoreCreateMutex();
+    if (lock == nullptr) {
+        Serial.printf("MidiOutput: failed to create mutex\n");
+    }
+}
+
+void MidiOutput::set_mode(bool thru, bool filter_timing) {
+    if (lock == nullptr) return;
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    thru_enabled = thru;
+    merger.set_filter_timing(filter_timing);
+    xSemaphoreGive(lock);
+}
+
+void MidiOutput::thru(uint8_t byte) {
+    if (!thru_enabled || lock == nullptr) return;
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    merger.push_thru(byte);
+    pump();
+    xSemaphoreGive(lock);
+}
+
+void MidiOutput::send_realtime(uint8_t byte) {
+    if (lock == nullptr) return;
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    merger.push_realtime(byte);
+    pump();
+    xSemaphoreGive(lock);
+}
+
+void MidiOutput::set_next_realtime_us(uint64_t time_us) {
+    if (lock == nullptr) return;
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    merger.set_next_realtime_us(time_us);
+    pump(); // Releases thru bytes held for the byte just sent
+    xSemaphoreGive(lock);
+}
+
+// Must be called with lock held
+void MidiOutput::pump(void) {
+    uint64_t now = esp_timer_get_time();
+    uint8_t byte;
+    while (merger.pop(now, &byte)) {
+        serial->write(byte);
+    }
+}
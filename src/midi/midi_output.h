@@ -0,0 +1,38 @@
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+#include "midi_merger.h"
+
+// MIDI out on MIDI_TX_PIN.
+// Generated real-time bytes come from the clock timer and the MIDI task,
+// thru bytes from the UART event task as they are received. Each byte is
+// written to the UART as soon as MidiMerger lets it go, so at most a byte
+// or two ever waits in the TX FIFO.
+class MidiOutput
+{
+public:
+    MidiOutput();
+    void begin(HardwareSerial* serial);
+
+    // thru forwards every received byte, filter_timing drops received
+    // timing messages while the generated clock is sent
+    void set_mode(bool thru, bool filter_timing);
+
+    // Received byte, forwarded if thru is enabled
+    void thru(uint8_t byte);
+    // Generated real-time byte, sent immediately
+    void send_realtime(uint8_t byte);
+    // When the next generated byte is due, thru bytes are held so they do not delay it
+    void set_next_realtime_us(uint64_t time_us);
+
+    uint32_t get_dropped_bytes(void) const { return merger.get_dropped_bytes(); }
+
+private:
+    HardwareSerial* serial;
+    SemaphoreHandle_t lock; // Held while writing, so bytes from different tasks never reorder
+    MidiMerger merger;
+    std::atomic<bool> thru_enabled;
+
+    void pump(void);
+};
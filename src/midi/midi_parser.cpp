@@ -0,0 +1,123 @@
+#include "midi_parser.h"
+
+MidiParser::MidiParser() {
+    dropped_bytes = 0;
+    reset();
+}
+
+void MidiParser::reset(void) {
+    status = 0;
+    data[0] = 0;
+    data[1] = 0;
+    data_count = 0;
+    data_needed = 0;
+    in_sysex = false;
+}
+
+int MidiParser::get_data_length(uint8_t status) {
+    switch (status & 0xF0) {
+        case 0x80: // Note off
+        case 0x90: // Note on
+        case 0xA0: // Poly aftertouch
+        case 0xB0: // Control change
+        case 0xE0: // Pitch bend
+            return 2;
+        case 0xC0: // Program change
+        case 0xD0: // Channel aftertouch
+            return 1;
+        default:
+            break;
+    }
+
+    switch (status) {
+        case 0xF1: // MTC quarter frame
+        case 0xF3: // Song select
+            return 1;
+        case 0xF2: // Song position pointer
+            return 2;
+        case 0xF6: // Tune request
+        case 0xF8: // Clock
+        case 0xFA: // Start
+        case 0xFB: // Continue
+        case 0xFC: // Stop
+        case 0xFE: // Active sensing
+        case 0xFF: // Reset
+            return 0;
+        default:
+            return -1;
+    }
+}
+
+bool MidiParser::feed(uint8_t byte, uint32_t time_us, MidiMessage* out) {
+    if (byte >= 0xF8) {
+        // Real-time, does not affect running status or SysEx
+        if (get_data_length(byte) < 0) {
+            dropped_bytes++;
+            return false;
+        }
+        out->time_us = time_us;
+        out->status = byte;
+        out->data1 = 0;
+        out->data2 = 0;
+        return true;
+    }
+
+    if (byte & 0x80) {
+        // New status, an unfinished message is lost
+        dropped_bytes += data_count;
+        data_count = 0;
+        status = 0;
+        in_sysex = false;
+
+        if (byte == 0xF0) {
+            in_sysex = true;
+            return false;
+        }
+        if (byte == 0xF7) {
+            return false;
+        }
+
+        int length = get_data_length(byte);
+        if (length < 0) {
+            dropped_bytes++;
+            return false;
+        }
+        if (length == 0) {
+            out->time_us = time_us;
+            out->status = byte;
+            out->data1 = 0;
+            out->data2 = 0;
+            return true;
+        }
+
+        status = byte;
+        data_needed = length;
+        return false;
+    }
+
+    if (in_sysex) {
+        return false;
+    }
+
+    if (status == 0) {
+        dropped_bytes++;
+        return false;
+    }
+
+    data[data_count++] = byte;
+    if (data_count < data_needed) {
+        return false;
+    }
+
+    out->time_us = time_us;
+    out->status = status;
+    out->data1 = data[0];
+    out->data2 = (data_needed > 1) ? data[1] : 0;
+
+    data_count = 0;
+    if (status >= 0xF0) {
+        // System common messages cancel running status
+        status = 0;
+    }
+    return true;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Complete MIDI message, time_us is taken when its last byte arrived
+struct MidiMessage
+{
+    uint32_t time_us;
+    uint8_t status;
+    uint8_t data1;
+    uint8_t data2;
+
+    bool is_channel_message(void) const { return status < 0xF0; }
+    uint8_t get_type(void) const { return is_channel_message() ? (status & 0xF0) : status; }
+    uint8_t get_channel(void) const { return (status & 0x0F) + 1; } // 1..16
+};
+
+// MIDI byte stream parser with running status.
+// Real-time bytes may appear anywhere and are returned immediately,
+// SysEx content is skipped, stray data bytes are counted as dropped.
+// Has no hardware dependencies so it can be fed byte streams on host.
+class MidiParser
+{
+public:
+    MidiParser();
+
+    // Returns true and fills out when byte completes a message
+    bool feed(uint8_t byte, uint32_t time_us, MidiMessage* out);
+    void reset(void);
+
+    uint32_t get_dropped_bytes(void) const { return dropped_bytes; }
+
+    // Number of data bytes following a status byte, -1 for undefined statuses
+    static int get_data_length(uint8_t status);
+
+private:
+    uint8_t status; // Status of the message being received, kept for running status, 0 if none
+    uint8_t data[2];
+    uint8_t data_count;
+    uint8_t data_needed;
+    bool in_sysex;
+    uint32_t dropped_bytes;
+};
@@ -0,0 +1,16 @@
+#include "midi_receiver.h"
+
+MidiReceiver::MidiReceiver() {
+    overruns = 0;
+    ring_dropped_bytes = 0;
+}
+
+bool MidiReceiver::receive(uint8_t byte, uint32_t time_us) {
+    MidiMessage message;
+    if (parser.feed(byte, time_us, &message) && !ring.push(message)) {
+        overruns++;
+        ring_dropped_bytes += 1 + MidiParser::get_data_length(message.status);
+        return false;
+    }
+    return true;
+}
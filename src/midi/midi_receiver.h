@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "midi_parser.h"
+#include "../spsc_ring.h"
+
+// Receiving side of MidiInput without the UART: bytes are parsed on the
+// producer task, complete messages are queued for the consumer task.
+// A message that finds the ring full is counted as an overrun and its bytes as dropped.
+class MidiReceiver
+{
+public:
+    static const size_t RING_SIZE = 256;
+
+    MidiReceiver();
+
+    // Producer side, returns false if a completed message was lost to a full ring
+    bool receive(uint8_t byte, uint32_t time_us);
+    // Producer side, for overflows upstream of the parser
+    void count_overrun(void) { overruns++; }
+
+    // Consumer side, returns false when no message is pending
+    bool read(MidiMessage* message) { return ring.pop(message); }
+
+    uint32_t get_overruns(void) const { return overruns; }
+    uint32_t get_dropped_bytes(void) const { return parser.get_dropped_bytes() + ring_dropped_bytes; }
+
+private:
+    MidiParser parser;
+    SpscRing<MidiMessage, RING_SIZE> ring;
+
+    volatile uint32_t overruns; // Upstream overflows and ring full events
+    volatile uint32_t ring_dropped_bytes; // Bytes of parsed messages lost to a full ring
+};
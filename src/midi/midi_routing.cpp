@@ -0,0 +1,106 @@
+#include <string.h>
+#include "midi_routing.h"
+
+void MidiRouting::reset(void) {
+    memset(note_mask, 0, sizeof(note_mask));
+    memset(aftertouch_mask, 0, sizeof(aftertouch_mask));
+    memset(pitchbend_mask, 0, sizeof(pitchbend_mask));
+    memset(cc_mask, 0, sizeof(cc_mask));
+    clock_mask = 0;
+    run_mask = 0;
+    stop_mask = 0;
+
+    for (size_t i = 0; i < OutChannelCount; i++) {
+        action[i] = ActionNone;
+        clock_mul[i] = 0;
+        clock_div[i] = 0;
+    }
+}
+
+bool MidiRouting::is_channel_match(const MidiSettingsData& settings, size_t out_channel, uint8_t channel) {
+    MidiChannel out_ch = settings.midi_out_channel[out_channel];
+    if (out_ch == MidiChannelUnchanged) {
+        out_ch = settings.midi_channel;
+    }
+
+    return (out_ch == channel) || (out_ch == MidiChannelAll);
+}
+
+void MidiRouting::compile(const MidiSettingsData& settings) {
+    reset();
+
+    for (size_t i = 0; i < OutChannelCount; i++) {
+        MidiOutType type = settings.midi_out_type[i];
+        uint8_t bit = 1 << i;
+
+        switch (type) {
+            case MidiOutType::MidiOutGate:       action[i] = ActionGate; break;
+            case MidiOutType::MidiOutPitch:      action[i] = ActionPitch; break;
+            case MidiOutType::MidiOutVelocity:   action[i] = ActionVelocity; break;
+            case MidiOutType::MidiOutAfterTouch: action[i] = ActionAftertouch; break;
+            case MidiOutType::MidiOutPitchBend:  action[i] = ActionPitchBend; break;
+            case MidiOutType::MidiOutRun:        action[i] = ActionRun; break;
+            case MidiOutType::MidiOutStop:       action[i] = ActionStop; break;
+            case MidiOutType::MidiOutMozzi:
+                // Only outputs driven through Mozzi can play oscillators
+                if (OUT_CHANNELS[i].type == OutTypeMozzi) {
+                    action[i] = ActionMozzi;
+                }
+                break;
+            default:
+                if (type == MidiOutType::MidiOutClockRatio) {
+                    action[i] = ActionClock;
+                    clock_mul[i] = settings.clock_ratio[i].mul;
+                    clock_div[i] = settings.clock_ratio[i].div;
+                } else if (is_clock_out_type(type)) {
+                    // Fixed divisions of 24 PPQN, as pulses per beat
+                    action[i] = ActionClock;
+                    clock_mul[i] = 24 / get_clock_out_division_ticks(type);
+                    clock_div[i] = 1;
+                } else if (type >= MidiOutType::MidiOutCc0 && type <= MidiOutType::MidiOutCc127) {
+                    action[i] = ActionCc;
+                }
+                break;
+        }
+
+        // Channel independent messages
+        if (action[i] == ActionClock) clock_mask |= bit;
+        if (action[i] == ActionRun) run_mask |= bit;
+        if (action[i] == ActionStop) stop_mask |= bit;
+
+        // Channel voice messages
+        for (uint8_t ch = MidiChannel1; ch <= MidiChannel16; ch++) {
+            if (!is_channel_match(settings, i, ch)) continue;
+
+            switch (action[i]) {
+                case ActionGate:
+                case ActionVelocity:
+                    note_mask[ch] |= bit;
+                    break;
+                case ActionPitch:
+                    note_mask[ch] |= bit;
+                    pitchbend_mask[ch] |= bit;
+                    break;
+                case ActionAftertouch:
+                    aftertouch_mask[ch] |= bit;
+                    break;
+                case ActionPitchBend:
+                    pitchbend_mask[ch] |= bit;
+                    break;
+                case ActionCc:
+                    cc_mask[ch][type - MidiOutType::MidiOutCc0] |= bit;
+                    break;
+                case ActionMozzi:
+                    note_mask[ch] |= bit;
+                    aftertouch_mask[ch] |= bit;
+                    pitchbend_mask[ch] |= bit;
+                    for (size_t cc = 0; cc < CC_COUNT; cc++) {
+                        cc_mask[ch][cc] |= bit;
+                    }
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "../board.h"
+#include "midi_settings_data.h"
+
+// Routing table compiled from MidiSettingsData.
+// For every MIDI channel and message kind holds a bitmask of the outputs
+// that react to it, so handlers only touch those outputs.
+struct MidiRouting
+{
+    static const size_t CC_COUNT = 128;
+
+    enum Action : uint8_t {
+        ActionNone,
+        ActionGate,
+        ActionPitch,
+        ActionVelocity,
+        ActionAftertouch,
+        ActionPitchBend,
+        ActionCc,
+        ActionMozzi,
+        ActionClock,
+        ActionRun,
+        ActionStop,
+    };
+
+    uint8_t note_mask[MIDI_CHANNEL_COUNT];
+    uint8_t aftertouch_mask[MIDI_CHANNEL_COUNT];
+    uint8_t pitchbend_mask[MIDI_CHANNEL_COUNT];
+    uint8_t cc_mask[MIDI_CHANNEL_COUNT][CC_COUNT];
+    uint8_t clock_mask; // outputs of any clock type
+    uint8_t run_mask;
+    uint8_t stop_mask;
+
+    Action action[OutChannelCount];
+    // Clock outputs pulse clock_mul times every clock_div beats
+    uint8_t clock_mul[OutChannelCount];
+    uint8_t clock_div[OutChannelCount];
+
+    void compile(const MidiSettingsData& settings);
+    void reset(void);
+
+    static bool is_channel_match(const MidiSettingsData& settings, size_t out_channel, uint8_t channel);
+
+    MidiRouting() { reset(); }
+};
@@ -4,7 +4,7 @@
 
 MidiSettings::MidiSettings(Display* display, MidiSettingsState* state, SignalProcessor* processor, ScreenSwitcher* screen_switcher)
     : ScreenInterface(display), state(state), processor(processor), screen_switcher(screen_switcher),
-      current_item(MENU_CHANNEL), is_editing(false), row_number(0) {}
+      current_item(MENU_CHANNEL), is_editing(false), row_number(0), is_drawn(false) {}
 
 void MidiSettings::set_screen_switcher(ScreenSwitcher* screen_switcher) {
     this->screen_switcher = screen_switcher;
@@ -14,12 +14,21 @@ void MidiSettings::enter() {
     current_item = MENU_CHANNEL;
     is_editing = false;
     row_number = 0;
+    is_drawn = false;
 }
 
 void MidiSettings::exit() {
 
 }
 
+void MidiSettings::get_view(View* view) {
+    memset(view, 0, sizeof(*view)); // Padding too, views are compared with memcmp
+    view->version = state->get_version();
+    view->current_item = current_item;
+    view->row_number = row_number;
+    view->is_editing = is_editing;
+}
+
 void MidiSettings::render() {
     display->clearDisplay();
 
@@ -29,7 +38,7 @@ void MidiSettings::render() {
 
     render_menu();
 
-    display->display();
+    show();
 }
 
 void MidiSettings::render_menu() {
@@ -42,13 +51,21 @@ void MidiSettings::render_menu() {
 
         // Determine which column is selected for outputs
         bool type_selected = is_selected && (col_type == SingleItem || row_number == 0);
-        bool channel_selected = is_selected && col_type == ChannelItem && row_number == 1;
+        bool channel_selected = is_selected && col_type != SingleItem && row_number == 1;
+        bool priority_selected = is_selected && col_type == PriorityItem && row_number == 2;
 
         // Draw rectangle cursor
         if (is_selected) {
-            if (col_type == ChannelItem) {
+            if (col_type != SingleItem) {
                 // For outputs: draw cursor on selected column
-                if (row_number == 1) {
+                if (row_number == 2) {
+                    // Note priority column selected
+                    if (is_editing_selected) {
+                        display->fillRect(COL4_X, y, COL4_WIDTH, LINE_HEIGHT, SSD1306_WHITE);
+                    } else {
+                        display->drawRect(COL4_X, y, COL4_WIDTH, LINE_HEIGHT, SSD1306_WHITE);
+                    }
+                } else if (row_number == 1) {
                     // Channel column selected
                     if (is_editing_selected) {
                         display->fillRect(COL3_X, y, COL3_WIDTH, LINE_HEIGHT, SSD1306_WHITE);
@@ -113,6 +130,17 @@ void MidiSettings::render_menu() {
             }
             display->setCursor(COL3_X, y + 1);
             display->print(state->get_midi_out_channel_str(items[i].data.output_idx));
+
+            // Column 4: note priority
+            if (col_type == PriorityItem) {
+                if (priority_selected && is_editing) {
+                    display->setTextColor(SSD1306_BLACK, SSD1306_WHITE); // Inverted for editing
+                } else {
+                    display->setTextColor(SSD1306_WHITE, SSD1306_BLACK);
+                }
+                display->setCursor(COL4_X + 1, y + 1);
+                display->print(state->get_note_priority_str(items[i].data.output_idx));
+            }
         }
     }
 }
@@ -129,6 +157,12 @@ void MidiSettings::handle_input(Event* event) {
             is_editing = false;
         }
     } else {
+        if (event->button_sw == ButtonPress && current_item == MENU_CLOCK_RATIOS) {
+            // Opens its own screen instead of editing in place
+            screen_switcher->set_screen(MidiScreen::MidiScreenClock);
+            return;
+        }
+
         if (event->button_sw == ButtonPress) {
             is_editing = true;
 
@@ -157,29 +191,32 @@ void MidiSettings::handle_menu_input(Event* event) {
                 // Single column items
                 switch (current_item) {
                     case MENU_CHANNEL:
-                        state->set_midi_channel((MidiChannel)clampi(state->get_midi_channel() + event->encoder,
+                        state->set_midi_channel((MidiChannel)clampi(state->get_midi_channel() + event->encoder_accel,
                                                                  state->get_min_midi_channel(),
                                                                  state->get_max_midi_channel()));
                         break;
                     case MENU_CLOCK:
-                        state->set_midi_clk_type((MidiClkType)clampi(state->get_midi_clk_type() + event->encoder,
+                        state->set_midi_clk_type((MidiClkType)clampi(state->get_midi_clk_type() + event->encoder_accel,
                                                                    state->get_min_midi_clk_type(),
                                                                    state->get_max_midi_clk_type()));
                         break;
                 }
             } else {
-                // ChannelItem: outputs with two columns
+                // ChannelItem/PriorityItem: outputs with two or three columns
                 int idx = item.data.output_idx;
-                if (row_number == 1) {
+                if (row_number == 2) {
+                    // Editing note priority column
+                    state->set_note_priority(idx, (NotePriority)clampi(state->get_note_priority(idx) + event->encoder_accel,
+                                                                     state->get_min_note_priority(),
+                                                                     state->get_max_note_priority()));
+                } else if (row_number == 1) {
                     // Editing channel column
-                    state->set_midi_out_channel(idx, (MidiChannel)clampi(state->get_midi_out_channel(idx) + event->encoder,
+                    state->set_midi_out_channel(idx, (MidiChannel)clampi(state->get_midi_out_channel(idx) + event->encoder_accel,
                                                                        state->get_min_midi_out_channel(),
                                                                        state->get_max_midi_out_channel()));
                 } else {
                     // Editing type column
-                    state->set_midi_out_type(idx, (MidiOutType)clampi(state->get_midi_out_type(idx) + event->encoder,
-                                                                   state->get_min_midi_out_type(idx),
-                                                                   state->get_max_midi_out_type(idx)));
+                    state->set_midi_out_type(idx, state->step_midi_out_type(idx, state->get_midi_out_type(idx), event->encoder_accel));
                 }
             }
             state->store();
@@ -272,6 +309,19 @@ void MidiSettings::handle_menu_input(Event* event) {
 
 
 void MidiSettings::update(Event* event) {
+    // Also runs without input, MIDI learn picks up controllers here
     handle_input(event);
+
+    if (screen_switcher->get_current_screen() != this) {
+        return; // Switched away, the next screen draws
+    }
+
+    View view;
+    get_view(&view);
+    if (!DEBUG_UI_REDRAW_ALWAYS && is_drawn && memcmp(&view, &drawn, sizeof(view)) == 0) {
+        return;
+    }
     render();
+    drawn = view;
+    is_drawn = true;
 }
@@ -22,12 +22,14 @@ private:
         MENU_CLOCK_OUT,
         MENU_RESET_OUT,
         MENU_CLOCK,
+        MENU_CLOCK_RATIOS,
         MENU_COUNT
     };
 
     enum ColumnType {
         SingleItem = 1,
-        ChannelItem = 2
+        ChannelItem = 2,
+        PriorityItem = 3 // ChannelItem with note priority column
     };
 
     struct MenuItemInfo {
@@ -35,18 +37,19 @@ private:
         ColumnType type; // number of columns
         union {
             void* unused;
-            int output_idx; // output index for ChannelItem (0-4)
+            int output_idx; // output index for ChannelItem and PriorityItem (0-4)
         } data;
     };
 
     static constexpr MenuItemInfo items[MENU_COUNT] = {
         {"Channel", SingleItem, {.unused = nullptr}},
-        {" A", ChannelItem, {.output_idx = 0}},
-        {" B", ChannelItem, {.output_idx = 1}},
-        {" C", ChannelItem, {.output_idx = 2}},
+        {" A", PriorityItem, {.output_idx = 0}},
+        {" B", PriorityItem, {.output_idx = 1}},
+        {" C", PriorityItem, {.output_idx = 2}},
         {"CLK", ChannelItem, {.output_idx = 3}},
         {"RST", ChannelItem, {.output_idx = 4}},
-        {"Clock", SingleItem, {.unused = nullptr}}
+        {"Clock", SingleItem, {.unused = nullptr}},
+        {"Clock ratios >", SingleItem, {.unused = nullptr}}
     };
 
     enum Direction {
@@ -57,17 +60,30 @@ private:
     const int COL1_X = 0;
     const int COL2_X = 30;
     const int COL3_X = 100;
+    const int COL4_X = 120;
     const int COL2_WIDTH = COL3_X - COL2_X; // Width of column 2
-    const int COL3_WIDTH = SCREEN_WIDTH - COL3_X; // Width of column 3
+    const int COL3_WIDTH = COL4_X - COL3_X; // Width of column 3
+    const int COL4_WIDTH = SCREEN_WIDTH - COL4_X; // Width of column 4
     const int LINE_HEIGHT = 8;
 
+    // Everything the screen shows, it is only redrawn when this changes
+    struct View {
+        uint32_t version; // Settings
+        MenuItems current_item;
+        int row_number;
+        bool is_editing;
+    };
+
     MidiSettingsState* state;
     SignalProcessor* processor;
     ScreenSwitcher* screen_switcher;
     MenuItems current_item;
     bool is_editing;
-    int row_number; // current column position within row (0 = first column, 1 = second column for ChannelItem)
+    int row_number; // current column position within row (0 = type, 1 = channel, 2 = note priority)
+    View drawn;
+    bool is_drawn; // drawn is on the display
 
+    void get_view(View* view);
     void render(void);
     void render_menu(void);
     void handle_input(Event* event);
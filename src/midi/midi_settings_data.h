@@ -0,0 +1,251 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "../board.h"
+
+// Settings types shared by the state, its storage and the signal processor.
+// Enum values are stored in flash, new entries go at the end.
+
+enum MidiClkType {
+    MidiClkInt,
+    MidiClkExt,
+    MidiClkSync1, // SYNC_IN pulses, 1 per quarter note
+    MidiClkSync2,
+    MidiClkSync4,
+    MidiClkSync24,
+};
+
+// What is sent on the MIDI out jack. Clock is generated only by the internal clock.
+enum MidiTxType {
+    MidiTxOff,
+    MidiTxClock,
+    MidiTxThru,
+    MidiTxClockThru,
+};
+
+// Which held note drives pitch outputs
+enum NotePriority {
+    NotePriorityHighest,
+    NotePriorityLast,
+    NotePriorityLowest,
+};
+
+// Stored priorities out of range keep the default, get_priority_note() never sees them
+inline bool is_note_priority_valid(uint32_t value) {
+    return value <= NotePriorityLowest;
+}
+
+enum MidiChannel {
+    MidiChannelUnchanged   = 0,
+    MidiChannel1   = 1,
+    MidiChannel2   = 2,
+    MidiChannel3   = 3,
+    MidiChannel4   = 4,
+    MidiChannel5   = 5,
+    MidiChannel6   = 6,
+    MidiChannel7   = 7,
+    MidiChannel8   = 8,
+    MidiChannel9   = 9,
+    MidiChannel10  = 10,
+    MidiChannel11  = 11,
+    MidiChannel12  = 12,
+    MidiChannel13  = 13,
+    MidiChannel14  = 14,
+    MidiChannel15  = 15,
+    MidiChannel16  = 16,
+    MidiChannelAll = 17
+};
+
+const int MIDI_CHANNEL_COUNT = 16 + 1; // start from 1 to 16
+
+enum MidiOutType {
+    MidiOutClock1_4,
+    MidiOutClock1_8,
+    MidiOutClock1_16,
+    MidiOutClock1_32,
+    MidiOutClock1_8T,
+    MidiOutClock1_16T,
+    MidiOutRun,
+    MidiOutStop,
+    MidiOutGate,
+    MidiOutPitch,
+    MidiOutVelocity,
+    MidiOutAfterTouch,
+    MidiOutPitchBend,
+    MidiOutMozzi,
+    MidiOutCc0,
+    MidiOutCc1,
+    MidiOutCc2,
+    MidiOutCc3,
+    MidiOutCc4,
+    MidiOutCc5,
+    MidiOutCc6,
+    MidiOutCc7,
+    MidiOutCc8,
+    MidiOutCc9,
+    MidiOutCc10,
+    MidiOutCc11,
+    MidiOutCc12,
+    MidiOutCc13,
+    MidiOutCc14,
+    MidiOutCc15,
+    MidiOutCc16,
+    MidiOutCc17,
+    MidiOutCc18,
+    MidiOutCc19,
+    MidiOutCc20,
+    MidiOutCc21,
+    MidiOutCc22,
+    MidiOutCc23,
+    MidiOutCc24,
+    MidiOutCc25,
+    MidiOutCc26,
+    MidiOutCc27,
+    MidiOutCc28,
+    MidiOutCc29,
+    MidiOutCc30,
+    MidiOutCc31,
+    MidiOutCc32,
+    MidiOutCc33,
+    MidiOutCc34,
+    MidiOutCc35,
+    MidiOutCc36,
+    MidiOutCc37,
+    MidiOutCc38,
+    MidiOutCc39,
+    MidiOutCc40,
+    MidiOutCc41,
+    MidiOutCc42,
+    MidiOutCc43,
+    MidiOutCc44,
+    MidiOutCc45,
+    MidiOutCc46,
+    MidiOutCc47,
+    MidiOutCc48,
+    MidiOutCc49,
+    MidiOutCc50,
+    MidiOutCc51,
+    MidiOutCc52,
+    MidiOutCc53,
+    MidiOutCc54,
+    MidiOutCc55,
+    MidiOutCc56,
+    MidiOutCc57,
+    MidiOutCc58,
+    MidiOutCc59,
+    MidiOutCc60,
+    MidiOutCc61,
+    MidiOutCc62,
+    MidiOutCc63,
+    MidiOutCc64,
+    MidiOutCc65,
+    MidiOutCc66,
+    MidiOutCc67,
+    MidiOutCc68,
+    MidiOutCc69,
+    MidiOutCc70,
+    MidiOutCc71,
+    MidiOutCc72,
+    MidiOutCc73,
+    MidiOutCc74,
+    MidiOutCc75,
+    MidiOutCc76,
+    MidiOutCc77,
+    MidiOutCc78,
+    MidiOutCc79,
+    MidiOutCc80,
+    MidiOutCc81,
+    MidiOutCc82,
+    MidiOutCc83,
+    MidiOutCc84,
+    MidiOutCc85,
+    MidiOutCc86,
+    MidiOutCc87,
+    MidiOutCc88,
+    MidiOutCc89,
+    MidiOutCc90,
+    MidiOutCc91,
+    MidiOutCc92,
+    MidiOutCc93,
+    MidiOutCc94,
+    MidiOutCc95,
+    MidiOutCc96,
+    MidiOutCc97,
+    MidiOutCc98,
+    MidiOutCc99,
+    MidiOutCc100,
+    MidiOutCc101,
+    MidiOutCc102,
+    MidiOutCc103,
+    MidiOutCc104,
+    MidiOutCc105,
+    MidiOutCc106,
+    MidiOutCc107,
+    MidiOutCc108,
+    MidiOutCc109,
+    MidiOutCc110,
+    MidiOutCc111,
+    MidiOutCc112,
+    MidiOutCc113,
+    MidiOutCc114,
+    MidiOutCc115,
+    MidiOutCc116,
+    MidiOutCc117,
+    MidiOutCc118,
+    MidiOutCc119,
+    MidiOutCc120,
+    MidiOutCc121,
+    MidiOutCc122,
+    MidiOutCc123,
+    MidiOutCc124,
+    MidiOutCc125,
+    MidiOutCc126,
+    MidiOutCc127,
+    MidiOutClockRatio, // Stored by value in NVS, new types go after this one
+};
+
+// Outputs of these types are driven by the clock engine
+inline bool is_clock_out_type(MidiOutType type) {
+    return type == MidiOutType::MidiOutClock1_4 ||
+           type == MidiOutType::MidiOutClock1_8 ||
+           type == MidiOutType::MidiOutClock1_16 ||
+           type == MidiOutType::MidiOutClock1_32 ||
+           type == MidiOutType::MidiOutClock1_8T ||
+           type == MidiOutType::MidiOutClock1_16T ||
+           type == MidiOutType::MidiOutClockRatio;
+}
+
+// 24 PPQN ticks per pulse of the fixed clock divisions, 0 for other types
+inline int get_clock_out_division_ticks(MidiOutType type) {
+    switch (type) {
+        case MidiOutType::MidiOutClock1_4:  return 24;  // Every beat (quarter note)
+        case MidiOutType::MidiOutClock1_8:  return 12;  // Every 8th note
+        case MidiOutType::MidiOutClock1_16: return 6;   // Every 16th note
+        case MidiOutType::MidiOutClock1_32: return 3;  // Every 32nd note
+        case MidiOutType::MidiOutClock1_8T: return 8;  // Every 8th note triplet (12 * 2/3)
+        case MidiOutType::MidiOutClock1_16T: return 4; // Every 16th note triplet (6 * 2/3)
+        default: return 0;
+    }
+}
+
+// Clock output settings: mul pulses every div beats, phase delays them by
+// a percentage of the output period. pulse_ms is used by every clock type.
+struct ClockRatio {
+    uint8_t mul;
+    uint8_t div;
+    uint8_t phase;
+    uint8_t pulse_ms;
+};
+
+// Plain copy of all settings, published to the signal processor as a whole
+struct MidiSettingsData {
+    int bpm;
+    MidiChannel midi_channel;
+    MidiOutType midi_out_type[OutChannelCount];
+    MidiChannel midi_out_channel[OutChannelCount];
+    NotePriority note_priority[OutChannelCount];
+    ClockRatio clock_ratio[OutChannelCount];
+    MidiClkType midi_clk_type;
+    MidiTxType midi_tx_type;
+};
@@ -1,208 +1,308 @@
 #include <nvs.h>
 #include <nvs_flash.h>
 #include <esp_err.h>
+#include <esp_system.h>
+#include <string.h>
 #include "midi_settings_state.h"
+#include "settings_store.h"
+#include "util.h"
 
 #define NVS_NAMESPACE "midi_settings"
 
-MidiSettingsState::MidiSettingsState(void) {
-    // Initialize mutex to nullptr
+// SettingsStorage on the NVS namespace, closed when it goes out of scope
+class NvsStorage : public SettingsStorage
+{
+public:
+    esp_err_t last_error;
+
+    NvsStorage() : last_error(ESP_OK), handle(0), is_open(false) {}
+    ~NvsStorage() {
+        if (is_open) nvs_close(handle);
+    }
+
+    esp_err_t open(nvs_open_mode_t mode) {
+        last_error = nvs_open(NVS_NAMESPACE, mode, &handle);
+        is_open = (last_error == ESP_OK);
+        return last_error;
+    }
+
+    bool get_u32(const char* key, uint32_t* value) override {
+        return check(nvs_get_u32(handle, key, value));
+    }
+    bool set_u32(const char* key, uint32_t value) override {
+        return check(nvs_set_u32(handle, key, value));
+    }
+    bool get_blob(const char* key, void* data, size_t* size) override {
+        return check(nvs_get_blob(handle, key, data, size));
+    }
+    bool set_blob(const char* key, const void* data, size_t size) override {
+        return check(nvs_set_blob(handle, key, data, size));
+    }
+    bool erase_key(const char* key) override {
+        esp_err_t err = nvs_erase_key(handle, key);
+        return err == ESP_ERR_NVS_NOT_FOUND || check(err);
+    }
+    bool commit(void) override {
+        return check(nvs_commit(handle));
+    }
+
+private:
+    nvs_handle_t handle;
+    bool is_open;
+
+    // Missing keys are expected, anything else is worth a log line
+    bool check(esp_err_t err) {
+        if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND) {
+            last_error = err;
+            Serial.printf("NvsStorage: err=0x%x\n", err);
+        }
+        return err == ESP_OK;
+    }
+};
+
+static MidiSettingsState* shutdown_state = nullptr;
+
+MidiSettingsState::MidiSettingsState(void)
+    : deferred_store(STORE_QUIET_MS, STORE_MAX_DELAY_MS) {
+    // Initialize mutexes to nullptr
     state_mutex = nullptr;
+    store_mutex = nullptr;
+    store_task_handle = nullptr;
+    settings_task_handle = nullptr;
+    requested_preset.store(NO_PRESET);
+    requested_bpm.store(NO_BPM);
+    change_callback = nullptr;
+
+    set_default();
+    bank.fill(data);
+    published.write(data);
 }
 
 MidiSettingsState::~MidiSettingsState(void) {
     if (state_mutex != nullptr) {
         vSemaphoreDelete(state_mutex);
     }
+    if (store_mutex != nullptr) {
+        vSemaphoreDelete(store_mutex);
+    }
 }
 
 void MidiSettingsState::begin(void) {
     // Create mutex for thread safety
     state_mutex = xSemaphoreCreateMutex();
+    store_mutex = xSemaphoreCreateMutex();
     recall();
+
+    shutdown_state = this;
+    esp_register_shutdown_handler(shutdown_handler);
+
+    xTaskCreatePinnedToCore(
+        store_task,
+        "Store_Task",
+        STORE_TASK_STACK_SIZE,
+        this,
+        UI_TASK_PRIORITY,
+        &store_task_handle,
+        UI_TASK_CORE
+    );
+
+    xTaskCreatePinnedToCore(
+        settings_task,
+        "Settings_Task",
+        SETTINGS_TASK_STACK_SIZE,
+        this,
+        SETTINGS_TASK_PRIORITY,
+        &settings_task_handle,
+        UI_TASK_CORE
+    );
 }
 
 void MidiSettingsState::store(void) {
     if (xSemaphoreTake(state_mutex, portMAX_DELAY) == pdTRUE) {
-        store_nvs();
+        deferred_store.mark_dirty(millis());
         xSemaphoreGive(state_mutex);
     }
 }
 
-esp_err_t MidiSettingsState::store_nvs(void) {
-    nvs_handle_t nvs_handle;
-    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
-    if (err != ESP_OK) {
-        Serial.printf("store_nvs: failed to open NVS namespace, err=0x%x\n", err);
-        return err;
+void MidiSettingsState::flush(void) {
+    write_pending(true);
+}
+
+// Writes the settings when a write is due, or any unsaved change if force is set
+void MidiSettingsState::write_pending(bool force) {
+    if (xSemaphoreTake(store_mutex, portMAX_DELAY) != pdTRUE) return;
+
+    bool changed = false;
+    if (xSemaphoreTake(state_mutex, portMAX_DELAY) == pdTRUE) {
+        if (deferred_store.dirty && (force || deferred_store.is_due(millis()))) {
+            memcpy(&store_snapshot, &bank, sizeof(store_snapshot));
+            memcpy(&store_snapshot.presets[bank.active], &data, sizeof(data));
+            changed = deferred_store.take(store_snapshot);
+        }
+        xSemaphoreGive(state_mutex);
     }
 
-    err = nvs_set_u32(nvs_handle, "bpm", (uint32_t)bpm);
-    if (err != ESP_OK) {
-        Serial.printf("store_nvs: failed to set bpm, err=0x%x\n", err);
-        nvs_close(nvs_handle);
-        return err;
+    // Flash is written without state_mutex, setters and readers never wait for it
+    if (changed) {
+        esp_err_t err = store_nvs(store_snapshot, deferred_store.stored);
+        if (xSemaphoreTake(state_mutex, portMAX_DELAY) == pdTRUE) {
+            if (err == ESP_OK) {
+                deferred_store.set_stored(store_snapshot);
+            } else {
+                deferred_store.mark_dirty(millis()); // Retry after another quiet period
+            }
+            xSemaphoreGive(state_mutex);
+        }
     }
 
-    err = nvs_set_u32(nvs_handle, "midi_channel", (uint32_t)midi_channel);
-    if (err != ESP_OK) {
-        Serial.printf("store_nvs: failed to set midi_channel, err=0x%x\n", err);
-        nvs_close(nvs_handle);
-        return err;
+    xSemaphoreGive(store_mutex);
+}
+
+void MidiSettingsState::store_task(void* parameter) {
+    MidiSettingsState* self = static_cast<MidiSettingsState*>(parameter);
+
+    while (true) {
+        vTaskDelay(pdMS_TO_TICKS(STORE_POLL_MS));
+        self->write_pending(false);
     }
+}
 
-    for (size_t i = 0; i < OutChannelCount; i++) {
-        char key[10];
-        snprintf(key, sizeof(key), "out_t%zu", i);
-        err = nvs_set_u32(nvs_handle, key, (uint32_t)midi_out_type[i]);
-        if (err != ESP_OK) {
-            Serial.printf("store_nvs: failed to set %s, err=0x%x\n", key, err);
-            nvs_close(nvs_handle);
-            return err;
-        }
+void MidiSettingsState::settings_task(void* parameter) {
+    MidiSettingsState* self = static_cast<MidiSettingsState*>(parameter);
+
+    while (true) {
+        // Woken by request_preset() and request_bpm()
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        self->apply_requested_preset();
+        self->apply_requested_bpm();
     }
+}
 
-    for (size_t i = 0; i < OutChannelCount; i++) {
-        char key[10];
-        snprintf(key, sizeof(key), "out_c%zu", i);
-        err = nvs_set_u32(nvs_handle, key, (uint32_t)midi_out_channel[i]);
-        if (err != ESP_OK) {
-            Serial.printf("store_nvs: failed to set %s, err=0x%x\n", key, err);
-            nvs_close(nvs_handle);
-            return err;
-        }
+void MidiSettingsState::apply_requested_preset(void) {
+    uint32_t idx = requested_preset.exchange(NO_PRESET);
+    if (idx != NO_PRESET && select_preset(idx)) {
+        store();
     }
+}
 
-    err = nvs_set_u32(nvs_handle, "midi_clk_type", (uint32_t)midi_clk_type);
-    if (err != ESP_OK) {
-        Serial.printf("store_nvs: failed to set midi_clk_type, err=0x%x\n", err);
-        nvs_close(nvs_handle);
-        return err;
+void MidiSettingsState::apply_requested_bpm(void) {
+    int32_t bpm = requested_bpm.exchange(NO_BPM);
+    if (bpm != NO_BPM) {
+        set_bpm(bpm);
     }
+}
+
+void MidiSettingsState::shutdown_handler(void) {
+    if (shutdown_state != nullptr) {
+        shutdown_state->flush();
+    }
+}
 
-    err = nvs_commit(nvs_handle);
+esp_err_t MidiSettingsState::store_nvs(const PresetBank& presets, const PresetBank& previous) {
+    NvsStorage storage;
+    esp_err_t err = storage.open(NVS_READWRITE);
     if (err != ESP_OK) {
-        Serial.printf("store_nvs: failed to commit, err=0x%x\n", err);
-        nvs_close(nvs_handle);
+        Serial.printf("store_nvs: failed to open NVS namespace, err=0x%x\n", err);
         return err;
     }
 
-    nvs_close(nvs_handle);
-    return ESP_OK;
+    bool ok = presets.save(&storage, previous);
+    if (!ok) {
+        Serial.printf("store_nvs: failed to write settings, err=0x%x\n", storage.last_error);
+    }
+    if (ok) return ESP_OK;
+    return (storage.last_error != ESP_OK) ? storage.last_error : ESP_FAIL;
 }
 
 void MidiSettingsState::recall(void) {
     if (xSemaphoreTake(state_mutex, portMAX_DELAY) == pdTRUE) {
-        esp_err_t err = recall_nvs();
-        if (err != ESP_OK) {
-            set_default();
-            store_nvs();
-        }
+        // Defaults when NVS cannot be opened, load() writes back anything it migrated or repaired
+        recall_nvs();
+        deferred_store.set_stored(bank);
+        publish();
         xSemaphoreGive(state_mutex);
     }
 }
 
 esp_err_t MidiSettingsState::recall_nvs(void) {
-    // First set defaults, then override with values from NVS
+    // Start from defaults, fields missing from storage keep them
     set_default();
-    
-    nvs_handle_t nvs_handle;
-    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs_handle);
+    bank.fill(data);
+
+    NvsStorage storage;
+    esp_err_t err = storage.open(NVS_READWRITE);
     if (err != ESP_OK) {
         Serial.printf("recall_nvs: failed to open NVS namespace, err=0x%x\n", err);
         return err;
     }
 
-    bool needs_save = false;
-
-    uint32_t bpm_val;
-    err = nvs_get_u32(nvs_handle, "bpm", &bpm_val);
-    if (err == ESP_OK) {
-        bpm = (int)bpm_val;
-    } else if (err == ESP_ERR_NVS_NOT_FOUND) {
-        needs_save = true;
-    } else {
-        Serial.printf("recall_nvs: failed to get bpm, err=0x%x\n", err);
-        nvs_close(nvs_handle);
-        return err;
-    }
-
-    uint32_t ch_val;
-    err = nvs_get_u32(nvs_handle, "midi_channel", &ch_val);
-    if (err == ESP_OK) {
-        midi_channel = (MidiChannel)ch_val;
-    } else if (err == ESP_ERR_NVS_NOT_FOUND) {
-        needs_save = true;
-    } else {
-        Serial.printf("recall_nvs: failed to get midi_channel, err=0x%x\n", err);
-        nvs_close(nvs_handle);
-        return err;
+    SettingsBlob::Source source = bank.load(&storage, data);
+    if (source == SettingsBlob::SourceLegacy) {
+        Serial.printf("recall_nvs: migrated settings keys to a blob\n");
+    } else if (source == SettingsBlob::SourceDefaults) {
+        Serial.printf("recall_nvs: no valid settings stored, using defaults\n");
     }
+    memcpy(&data, &bank.presets[bank.active], sizeof(data));
+    return ESP_OK;
+}
 
-    for (size_t i = 0; i < OutChannelCount; i++) {
-        char key[10];
-        snprintf(key, sizeof(key), "out_t%zu", i);
-        uint32_t type_val;
-        err = nvs_get_u32(nvs_handle, key, &type_val);
-        if (err == ESP_OK) {
-            midi_out_type[i] = (MidiOutType)type_val;
-        } else if (err == ESP_ERR_NVS_NOT_FOUND) {
-            needs_save = true;
-        } else {
-            Serial.printf("recall_nvs: failed to get %s, err=0x%x\n", key, err);
-            nvs_close(nvs_handle);
-            return err;
+bool MidiSettingsState::select_preset(size_t idx) {
+    bool selected = false;
+    if (xSemaphoreTake(state_mutex, portMAX_DELAY) == pdTRUE) {
+        selected = bank.select(idx, &data);
+        if (selected) {
+            publish();
         }
+        xSemaphoreGive(state_mutex);
     }
+    return selected;
+}
 
-    for (size_t i = 0; i < OutChannelCount; i++) {
-        char key[10];
-        snprintf(key, sizeof(key), "out_c%zu", i);
-        uint32_t ch_val;
-        err = nvs_get_u32(nvs_handle, key, &ch_val);
-        if (err == ESP_OK) {
-            midi_out_channel[i] = (MidiChannel)ch_val;
-        } else if (err == ESP_ERR_NVS_NOT_FOUND) {
-            needs_save = true;
-        } else {
-            Serial.printf("recall_nvs: failed to get %s, err=0x%x\n", key, err);
-            nvs_close(nvs_handle);
-            return err;
-        }
-    }
+void MidiSettingsState::request_preset(size_t idx) {
+    if (idx >= PresetBank::PRESET_COUNT) return;
 
-    uint32_t clk_val;
-    err = nvs_get_u32(nvs_handle, "midi_clk_type", &clk_val);
-    if (err == ESP_OK) {
-        midi_clk_type = (MidiClkType)clk_val;
-    } else if (err == ESP_ERR_NVS_NOT_FOUND) {
-        needs_save = true;
-    } else {
-        Serial.printf("recall_nvs: failed to get midi_clk_type, err=0x%x\n", err);
-        nvs_close(nvs_handle);
-        return err;
+    requested_preset.store((uint32_t)idx);
+    if (settings_task_handle != nullptr) {
+        xTaskNotifyGive(settings_task_handle);
     }
+}
 
-    nvs_close(nvs_handle);
-    
-    // If any keys were missing, save all values to create them
-    if (needs_save) {
-        return ESP_ERR_NVS_NOT_FOUND; // Signal that save is needed
+size_t MidiSettingsState::get_preset(void) {
+    size_t result = 0;
+    if (xSemaphoreTake(state_mutex, portMAX_DELAY) == pdTRUE) {
+        result = bank.active;
+        xSemaphoreGive(state_mutex);
     }
-    
-    return ESP_OK;
+    return result;
+}
+
+const char* MidiSettingsState::get_preset_str(void) {
+    static char preset_str[4];
+    snprintf(preset_str, sizeof(preset_str), "%u", (unsigned)get_preset() + 1);
+    return preset_str;
 }
 
 void MidiSettingsState::set_bpm(int bpm) {
     if (xSemaphoreTake(state_mutex, portMAX_DELAY) == pdTRUE) {
-        this->bpm = bpm;
+        data.bpm = bpm;
+        publish();
         xSemaphoreGive(state_mutex);
     }
 }
 
+void MidiSettingsState::request_bpm(int bpm) {
+    if (bpm < MIN_BPM || bpm > MAX_BPM) return;
+
+    requested_bpm.store(bpm);
+    if (settings_task_handle != nullptr) {
+        xTaskNotifyGive(settings_task_handle);
+    }
+}
+
 void MidiSettingsState::set_midi_channel(MidiChannel ch) {
     if (xSemaphoreTake(state_mutex, portMAX_DELAY) == pdTRUE) {
-        this->midi_channel = ch;
+        data.midi_channel = ch;
+        publish();
         xSemaphoreGive(state_mutex);
     }
 }
@@ -210,7 +310,8 @@ void MidiSettingsState::set_midi_channel(MidiChannel ch) {
 void MidiSettingsState::set_midi_out_type(size_t idx, MidiOutType type) {
     if (xSemaphoreTake(state_mutex, portMAX_DELAY) == pdTRUE) {
         if (idx < OutChannelCount) {
-            this->midi_out_type[idx] = type;
+            data.midi_out_type[idx] = type;
+            publish();
         }
         xSemaphoreGive(state_mutex);
     }
@@ -219,7 +320,8 @@ void MidiSettingsState::set_midi_out_type(size_t idx, MidiOutType type) {
 void MidiSettingsState::set_midi_out_channel(size_t idx, MidiChannel ch) {
     if (xSemaphoreTake(state_mutex, portMAX_DELAY) == pdTRUE) {
         if (idx < OutChannelCount) {
-            this->midi_out_channel[idx] = ch;
+            data.midi_out_channel[idx] = ch;
+            publish();
         }
         xSemaphoreGive(state_mutex);
     }
@@ -227,7 +329,41 @@ void MidiSettingsState::set_midi_out_channel(size_t idx, MidiChannel ch) {
 
 void MidiSettingsState::set_midi_clk_type(MidiClkType type) {
     if (xSemaphoreTake(state_mutex, portMAX_DELAY) == pdTRUE) {
-        this->midi_clk_type = type;
+        data.midi_clk_type = type;
+        publish();
+        xSemaphoreGive(state_mutex);
+    }
+}
+
+void MidiSettingsState::set_midi_tx_type(MidiTxType type) {
+    if (xSemaphoreTake(state_mutex, portMAX_DELAY) == pdTRUE) {
+        data.midi_tx_type = type;
+        publish();
+        xSemaphoreGive(state_mutex);
+    }
+}
+
+void MidiSettingsState::set_note_priority(size_t idx, NotePriority priority) {
+    if (xSemaphoreTake(state_mutex, portMAX_DELAY) == pdTRUE) {
+        if (idx < OutChannelCount) {
+            data.note_priority[idx] = priority;
+            publish();
+        }
+        xSemaphoreGive(state_mutex);
+    }
+}
+
+void MidiSettingsState::set_clock_ratio(size_t idx, ClockRatio ratio) {
+    ratio.mul = clampi(ratio.mul, MIN_CLOCK_MUL, MAX_CLOCK_MUL);
+    ratio.div = clampi(ratio.div, MIN_CLOCK_DIV, MAX_CLOCK_DIV);
+    ratio.phase = clampi(ratio.phase, MIN_CLOCK_PHASE, MAX_CLOCK_PHASE);
+    ratio.pulse_ms = clampi(ratio.pulse_ms, MIN_CLOCK_PULSE_MS, MAX_CLOCK_PULSE_MS);
+
+    if (xSemaphoreTake(state_mutex, portMAX_DELAY) == pdTRUE) {
+        if (idx < OutChannelCount) {
+            data.clock_ratio[idx] = ratio;
+            publish();
+        }
         xSemaphoreGive(state_mutex);
     }
 }
@@ -235,7 +371,7 @@ void MidiSettingsState::set_midi_clk_type(MidiClkType type) {
 int MidiSettingsState::get_bpm(void) {
     int result = 0;
     if (xSemaphoreTake(state_mutex, portMAX_DELAY) == pdTRUE) {
-        result = this->bpm;
+        result = data.bpm;
         xSemaphoreGive(state_mutex);
     }
     return result;
@@ -244,7 +380,7 @@ int MidiSettingsState::get_bpm(void) {
 MidiChannel MidiSettingsState::get_midi_channel(void) {
     MidiChannel result = MidiChannel1;
     if (xSemaphoreTake(state_mutex, portMAX_DELAY) == pdTRUE) {
-        result = this->midi_channel;
+        result = data.midi_channel;
         xSemaphoreGive(state_mutex);
     }
     return result;
@@ -254,7 +390,7 @@ MidiOutType MidiSettingsState::get_midi_out_type(size_t idx) {
     MidiOutType result = MidiOutGate;
     if (xSemaphoreTake(state_mutex, portMAX_DELAY) == pdTRUE) {
         if (idx < OutChannelCount) {
-            result = this->midi_out_type[idx];
+            result = data.midi_out_type[idx];
         }
         xSemaphoreGive(state_mutex);
     }
@@ -265,7 +401,7 @@ MidiChannel MidiSettingsState::get_midi_out_channel(size_t idx) {
     MidiChannel result = MidiChannelUnchanged;
     if (xSemaphoreTake(state_mutex, portMAX_DELAY) == pdTRUE) {
         if (idx < OutChannelCount) {
-            result = this->midi_out_channel[idx];
+            result = data.midi_out_channel[idx];
         }
         xSemaphoreGive(state_mutex);
     }
@@ -275,7 +411,38 @@ MidiChannel MidiSettingsState::get_midi_out_channel(size_t idx) {
 MidiClkType MidiSettingsState::get_midi_clk_type(void) {
     MidiClkType result = MidiClkInt;
     if (xSemaphoreTake(state_mutex, portMAX_DELAY) == pdTRUE) {
-        result = this->midi_clk_type;
+        result = data.midi_clk_type;
+        xSemaphoreGive(state_mutex);
+    }
+    return result;
+}
+
+MidiTxType MidiSettingsState::get_midi_tx_type(void) {
+    MidiTxType result = MidiTxOff;
+    if (xSemaphoreTake(state_mutex, portMAX_DELAY) == pdTRUE) {
+        result = data.midi_tx_type;
+        xSemaphoreGive(state_mutex);
+    }
+    return result;
+}
+
+NotePriority MidiSettingsState::get_note_priority(size_t idx) {
+    NotePriority result = NotePriorityLast;
+    if (xSemaphoreTake(state_mutex, portMAX_DELAY) == pdTRUE) {
+        if (idx < OutChannelCount) {
+            result = data.note_priority[idx];
+        }
+        xSemaphoreGive(state_mutex);
+    }
+    return result;
+}
+
+ClockRatio MidiSettingsState::get_clock_ratio(size_t idx) {
+    ClockRatio result = {1, 1, 0, DEFAULT_CLOCK_PULSE_MS};
+    if (xSemaphoreTake(state_mutex, portMAX_DELAY) == pdTRUE) {
+        if (idx < OutChannelCount) {
+            result = data.clock_ratio[idx];
+        }
         xSemaphoreGive(state_mutex);
     }
     return result;
@@ -284,7 +451,7 @@ MidiClkType MidiSettingsState::get_midi_clk_type(void) {
 const char* MidiSettingsState::get_bpm_str(void) {
     static char bpm_str[10];
     if (xSemaphoreTake(state_mutex, portMAX_DELAY) == pdTRUE) {
-        snprintf(bpm_str, sizeof(bpm_str), "%d", bpm);
+        snprintf(bpm_str, sizeof(bpm_str), "%d", data.bpm);
         xSemaphoreGive(state_mutex);
     }
     return bpm_str;
@@ -297,14 +464,37 @@ const char* MidiSettingsState::get_midi_channel_str(void) {
 
 const char* MidiSettingsState::get_midi_out_type_str(size_t idx) {
     MidiOutType type = get_midi_out_type(idx);
+    if (type == MidiOutClockRatio) {
+        static char buf[12];
+        ClockRatio ratio = get_clock_ratio(idx);
+        snprintf(buf, sizeof(buf), "clock%d:%d", ratio.mul, ratio.div);
+        return buf;
+    }
     return midi_out_type_to_string(type);
 }
 
+const char* MidiSettingsState::get_clock_ratio_str(size_t idx) {
+    static char buf[8];
+    ClockRatio ratio = get_clock_ratio(idx);
+    snprintf(buf, sizeof(buf), "%d:%d", ratio.mul, ratio.div);
+    return buf;
+}
+
 const char* MidiSettingsState::get_midi_clk_type_str(void) {
     MidiClkType type = get_midi_clk_type();
     return midi_clk_type_to_string(type);
 }
 
+const char* MidiSettingsState::get_midi_tx_type_str(void) {
+    MidiTxType type = get_midi_tx_type();
+    return midi_tx_type_to_string(type);
+}
+
+const char* MidiSettingsState::get_note_priority_str(size_t idx) {
+    NotePriority priority = get_note_priority(idx);
+    return note_priority_to_string(priority);
+}
+
 const char* MidiSettingsState::get_midi_out_channel_str(size_t idx) {
     MidiChannel ch = get_midi_out_channel(idx);
     return midi_channel_to_string(ch);
@@ -341,6 +531,7 @@ const char* MidiSettingsState::midi_out_type_to_string(MidiOutType type) {
         case MidiOutClock1_16T:  return "clock1/16T";
         case MidiOutRun:         return "run";
         case MidiOutStop:        return "stop";
+        case MidiOutClockRatio:  return "clock";
         default:
             if (type >= MidiOutCc0 && type <= MidiOutCc127) {
                 static char buf[8];
@@ -356,31 +547,51 @@ const char* MidiSettingsState::midi_clk_type_to_string(MidiClkType type) {
     switch (type) {
         case MidiClkInt: return "int";
         case MidiClkExt: return "ext";
+        case MidiClkSync1: return "sync1";
+        case MidiClkSync2: return "sync2";
+        case MidiClkSync4: return "sync4";
+        case MidiClkSync24: return "sync24";
+        default: return "unknown";
+    }
+}
+
+const char* MidiSettingsState::midi_tx_type_to_string(MidiTxType type) {
+    switch (type) {
+        case MidiTxOff:       return "off";
+        case MidiTxClock:     return "clock";
+        case MidiTxThru:      return "thru";
+        case MidiTxClockThru: return "clock+thru";
         default: return "unknown";
     }
 }
 
+const char* MidiSettingsState::note_priority_to_string(NotePriority priority) {
+    switch (priority) {
+        case NotePriorityHighest: return "H";
+        case NotePriorityLast:    return "N";
+        case NotePriorityLowest:  return "L";
+        default: return "?";
+    }
+}
+
 bool MidiSettingsState::is_clock_type(MidiOutType type) {
-    return type == MidiOutType::MidiOutClock1_4 ||
-           type == MidiOutType::MidiOutClock1_8 ||
-           type == MidiOutType::MidiOutClock1_16 ||
-           type == MidiOutType::MidiOutClock1_32 ||
-           type == MidiOutType::MidiOutClock1_8T ||
-           type == MidiOutType::MidiOutClock1_16T;
+    return is_clock_out_type(type);
 }
 
-int MidiSettingsState::get_clock_division_ticks(MidiOutType type) {
+int MidiSettingsState::get_sync_ppqn(MidiClkType type) {
     switch (type) {
-        case MidiOutType::MidiOutClock1_4:  return 24;  // Every beat (quarter note)
-        case MidiOutType::MidiOutClock1_8:  return 12;  // Every 8th note
-        case MidiOutType::MidiOutClock1_16: return 6;   // Every 16th note
-        case MidiOutType::MidiOutClock1_32: return 3;  // Every 32nd note
-        case MidiOutType::MidiOutClock1_8T: return 8;  // Every 8th note triplet (12 * 2/3)
-        case MidiOutType::MidiOutClock1_16T: return 4; // Every 16th note triplet (6 * 2/3)
+        case MidiClkSync1:  return 1;
+        case MidiClkSync2:  return 2;
+        case MidiClkSync4:  return 4;
+        case MidiClkSync24: return 24;
         default: return 0;
     }
 }
 
+int MidiSettingsState::get_clock_division_ticks(MidiOutType type) {
+    return get_clock_out_division_ticks(type);
+}
+
 int MidiSettingsState::get_max_midi_out_type(size_t idx) {
     if (idx >= OutChannelCount) return 0;
     if (idx < 0) return 0;
@@ -403,12 +614,56 @@ int MidiSettingsState::get_min_midi_out_type(size_t idx) {
     }
 }
 
+bool MidiSettingsState::is_midi_out_type_allowed(size_t idx, MidiOutType type) {
+    if (idx >= OutChannelCount) return false;
+
+    if (OUT_CHANNELS[idx].type == OutTypeMozzi || OUT_CHANNELS[idx].type == OutTypePwm) {
+        return type >= MIN_MIDI_OUT_TYPE && type <= MAX_MIDI_OUT_TYPE;
+    }
+
+    // Gate only outputs
+    return (type >= MidiOutClock1_4 && type <= MidiOutGate) || type == MidiOutClockRatio;
+}
+
+MidiOutType MidiSettingsState::step_midi_out_type(size_t idx, MidiOutType type, int steps) {
+    int direction = (steps > 0) ? 1 : -1;
+    int count = (steps > 0) ? steps : -steps;
+    int current = type;
+
+    for (int step = 0; step < count; step++) {
+        int next = current + direction;
+        while (next >= MIN_MIDI_OUT_TYPE && next <= MAX_MIDI_OUT_TYPE &&
+               !is_midi_out_type_allowed(idx, (MidiOutType)next)) {
+            next += direction;
+        }
+        if (next < MIN_MIDI_OUT_TYPE || next > MAX_MIDI_OUT_TYPE) break;
+        current = next;
+    }
+
+    return (MidiOutType)current;
+}
+
 void MidiSettingsState::set_default(void) {
-    bpm = 120;
-    midi_channel = MidiChannelAll;
+    data.bpm = 120;
+    data.midi_channel = MidiChannelAll;
     for (size_t i = 0; i < OutChannelCount; i++) {
-        midi_out_type[i] = MidiOutPitch;
-        midi_out_channel[i] = MidiChannelAll;
+        data.midi_out_type[i] = MidiOutPitch;
+        data.midi_out_channel[i] = MidiChannelAll;
+        data.note_priority[i] = NotePriorityLast;
+        data.clock_ratio[i] = {1, 1, 0, DEFAULT_CLOCK_PULSE_MS};
     }
-    midi_clk_type = MidiClkInt;
+    data.midi_clk_type = MidiClkInt;
+    data.midi_tx_type = MidiTxOff;
+}
+
+// Must be called with state_mutex held, so writers are serialized
+void MidiSettingsState::publish(void) {
+    published.write(data);
+    if (change_callback) {
+        change_callback();
+    }
+}
+
+bool MidiSettingsState::read_snapshot(MidiSettingsData* out, uint32_t* known_version) {
+    return published.read(out, known_version);
 }
@@ -2,215 +2,88 @@
 
 #include <stddef.h>
 #include <stdio.h>
+#include <atomic>
 #include <Arduino.h>
 #include "../board.h"
-
-enum MidiClkType {
-    MidiClkInt,
-    MidiClkExt,
-};
-
-enum MidiChannel {
-    MidiChannelUnchanged   = 0,
-    MidiChannel1   = 1,
-    MidiChannel2   = 2,
-    MidiChannel3   = 3,
-    MidiChannel4   = 4,
-    MidiChannel5   = 5,
-    MidiChannel6   = 6,
-    MidiChannel7   = 7,
-    MidiChannel8   = 8,
-    MidiChannel9   = 9,
-    MidiChannel10  = 10,
-    MidiChannel11  = 11,
-    MidiChannel12  = 12,
-    MidiChannel13  = 13,
-    MidiChannel14  = 14,
-    MidiChannel15  = 15,
-    MidiChannel16  = 16,
-    MidiChannelAll = 17
-};
-
-const int MIDI_CHANNEL_COUNT = 16 + 1; // start from 1 to 16
-
-enum MidiOutType {
-    MidiOutClock1_4,
-    MidiOutClock1_8,
-    MidiOutClock1_16,
-    MidiOutClock1_32,
-    MidiOutClock1_8T,
-    MidiOutClock1_16T,
-    MidiOutRun,
-    MidiOutStop,
-    MidiOutGate,
-    MidiOutPitch,
-    MidiOutVelocity,
-    MidiOutAfterTouch,
-    MidiOutPitchBend,
-    MidiOutMozzi,
-    MidiOutCc0,
-    MidiOutCc1,
-    MidiOutCc2,
-    MidiOutCc3,
-    MidiOutCc4,
-    MidiOutCc5,
-    MidiOutCc6,
-    MidiOutCc7,
-    MidiOutCc8,
-    MidiOutCc9,
-    MidiOutCc10,
-    MidiOutCc11,
-    MidiOutCc12,
-    MidiOutCc13,
-    MidiOutCc14,
-    MidiOutCc15,
-    MidiOutCc16,
-    MidiOutCc17,
-    MidiOutCc18,
-    MidiOutCc19,
-    MidiOutCc20,
-    MidiOutCc21,
-    MidiOutCc22,
-    MidiOutCc23,
-    MidiOutCc24,
-    MidiOutCc25,
-    MidiOutCc26,
-    MidiOutCc27,
-    MidiOutCc28,
-    MidiOutCc29,
-    MidiOutCc30,
-    MidiOutCc31,
-    MidiOutCc32,
-    MidiOutCc33,
-    MidiOutCc34,
-    MidiOutCc35,
-    MidiOutCc36,
-    MidiOutCc37,
-    MidiOutCc38,
-    MidiOutCc39,
-    MidiOutCc40,
-    MidiOutCc41,
-    MidiOutCc42,
-    MidiOutCc43,
-    MidiOutCc44,
-    MidiOutCc45,
-    MidiOutCc46,
-    MidiOutCc47,
-    MidiOutCc48,
-    MidiOutCc49,
-    MidiOutCc50,
-    MidiOutCc51,
-    MidiOutCc52,
-    MidiOutCc53,
-    MidiOutCc54,
-    MidiOutCc55,
-    MidiOutCc56,
-    MidiOutCc57,
-    MidiOutCc58,
-    MidiOutCc59,
-    MidiOutCc60,
-    MidiOutCc61,
-    MidiOutCc62,
-    MidiOutCc63,
-    MidiOutCc64,
-    MidiOutCc65,
-    MidiOutCc66,
-    MidiOutCc67,
-    MidiOutCc68,
-    MidiOutCc69,
-    MidiOutCc70,
-    MidiOutCc71,
-    MidiOutCc72,
-    MidiOutCc73,
-    MidiOutCc74,
-    MidiOutCc75,
-    MidiOutCc76,
-    MidiOutCc77,
-    MidiOutCc78,
-    MidiOutCc79,
-    MidiOutCc80,
-    MidiOutCc81,
-    MidiOutCc82,
-    MidiOutCc83,
-    MidiOutCc84,
-    MidiOutCc85,
-    MidiOutCc86,
-    MidiOutCc87,
-    MidiOutCc88,
-    MidiOutCc89,
-    MidiOutCc90,
-    MidiOutCc91,
-    MidiOutCc92,
-    MidiOutCc93,
-    MidiOutCc94,
-    MidiOutCc95,
-    MidiOutCc96,
-    MidiOutCc97,
-    MidiOutCc98,
-    MidiOutCc99,
-    MidiOutCc100,
-    MidiOutCc101,
-    MidiOutCc102,
-    MidiOutCc103,
-    MidiOutCc104,
-    MidiOutCc105,
-    MidiOutCc106,
-    MidiOutCc107,
-    MidiOutCc108,
-    MidiOutCc109,
-    MidiOutCc110,
-    MidiOutCc111,
-    MidiOutCc112,
-    MidiOutCc113,
-    MidiOutCc114,
-    MidiOutCc115,
-    MidiOutCc116,
-    MidiOutCc117,
-    MidiOutCc118,
-    MidiOutCc119,
-    MidiOutCc120,
-    MidiOutCc121,
-    MidiOutCc122,
-    MidiOutCc123,
-    MidiOutCc124,
-    MidiOutCc125,
-    MidiOutCc126,
-    MidiOutCc127
-};
+#include "../deferred_store.h"
+#include "../seqlock.h"
+#include "midi_settings_data.h"
+#include "preset_bank.h"
 
 class MidiSettingsState {
 public:
     const static int MAX_BPM = 255;
     const static int MIN_BPM = 1;
-    const static int MAX_MIDI_OUT_TYPE = MidiOutCc127;
+    const static int MAX_MIDI_OUT_TYPE = MidiOutClockRatio;
     const static int MIN_MIDI_OUT_TYPE = MidiOutClock1_4;
-    const static int MAX_MIDI_CLK_TYPE = MidiClkExt;
+    const static int MAX_MIDI_CLK_TYPE = MidiClkSync24;
     const static int MIN_MIDI_CLK_TYPE = MidiClkInt;
+    const static int MAX_MIDI_TX_TYPE = MidiTxClockThru;
+    const static int MIN_MIDI_TX_TYPE = MidiTxOff;
+    const static int MAX_NOTE_PRIORITY = NotePriorityLowest;
+    const static int MIN_NOTE_PRIORITY = NotePriorityHighest;
+    const static int MAX_CLOCK_MUL = 16;
+    const static int MIN_CLOCK_MUL = 1;
+    const static int MAX_CLOCK_DIV = 16;
+    const static int MIN_CLOCK_DIV = 1;
+    const static int MAX_CLOCK_PHASE = 99;
+    const static int MIN_CLOCK_PHASE = 0;
+    const static int MAX_CLOCK_PULSE_MS = 100;
+    const static int MIN_CLOCK_PULSE_MS = 1;
+    const static int DEFAULT_CLOCK_PULSE_MS = 10;
 
     MidiSettingsState(void);
     ~MidiSettingsState(void);
 
+    // Settings are written by a background task once they stop changing
+    static const uint32_t STORE_QUIET_MS = 2000;
+    static const uint32_t STORE_MAX_DELAY_MS = 10000; // Written even if changes keep coming
+    static const uint32_t STORE_POLL_MS = 100;
+
     void begin(void);
-    void store(void);
+    void store(void); // Marks the settings for a deferred write, cheap to call on every change
+    void flush(void); // Writes unsaved changes now, also runs before a restart
     void recall(void);
 
+    // Presets live in RAM, switching publishes the whole preset at once.
+    // The setters edit the active preset. Returns false if idx is out of range or active.
+    bool select_preset(size_t idx);
+    // Wait-free, for the audio task: the settings task switches to preset idx and
+    // marks it for a write. A newer request before it runs replaces this one.
+    void request_preset(size_t idx);
+    size_t get_preset(void);
+    const char* get_preset_str(void);
+    int get_preset_count(void) { return PresetBank::PRESET_COUNT; }
+
     const char* get_bpm_str(void);
     const char* get_midi_channel_str(void);
     const char* get_midi_out_type_str(size_t idx);
     const char* get_midi_out_channel_str(size_t idx);
     const char* get_midi_clk_type_str(void);
+    const char* get_midi_tx_type_str(void);
+    const char* get_note_priority_str(size_t idx);
+    const char* get_clock_ratio_str(size_t idx);
 
     void set_bpm(int bpm);
+    // Wait-free, for the audio task: the settings task sets the tempo.
+    // A newer request before it runs replaces this one.
+    void request_bpm(int bpm);
     void set_midi_channel(MidiChannel ch);
     void set_midi_out_type(size_t idx, MidiOutType type);
     void set_midi_out_channel(size_t idx, MidiChannel ch);
     void set_midi_clk_type(MidiClkType type);
+    void set_midi_tx_type(MidiTxType type);
+    void set_note_priority(size_t idx, NotePriority priority);
+    void set_clock_ratio(size_t idx, ClockRatio ratio); // Clamps every field
 
     int get_bpm(void);
     MidiChannel get_midi_channel(void);
     MidiOutType get_midi_out_type(size_t idx);
     MidiChannel get_midi_out_channel(size_t idx);
     MidiClkType get_midi_clk_type(void);
+    MidiTxType get_midi_tx_type(void);
+    NotePriority get_note_priority(size_t idx);
+    ClockRatio get_clock_ratio(size_t idx);
 
     int get_max_bpm(void) { return MAX_BPM; }
     int get_min_bpm(void) { return MIN_BPM; }
@@ -220,24 +93,69 @@ public:
     int get_min_midi_out_channel(void) { return MidiChannelUnchanged; }
     int get_max_midi_out_type(size_t idx);
     int get_min_midi_out_type(size_t idx);
+    bool is_midi_out_type_allowed(size_t idx, MidiOutType type);
+    // Moves by steps over the types allowed on the output, stops at both ends
+    MidiOutType step_midi_out_type(size_t idx, MidiOutType type, int steps);
     int get_max_midi_clk_type(void) { return MAX_MIDI_CLK_TYPE; }
     int get_min_midi_clk_type(void) { return MIN_MIDI_CLK_TYPE; }
+    int get_max_midi_tx_type(void) { return MAX_MIDI_TX_TYPE; }
+    int get_min_midi_tx_type(void) { return MIN_MIDI_TX_TYPE; }
+    int get_max_note_priority(void) { return MAX_NOTE_PRIORITY; }
+    int get_min_note_priority(void) { return MIN_NOTE_PRIORITY; }
 
     bool is_clock_type(MidiOutType type);
+    // Pulses per quarter note on SYNC_IN, 0 if the clock does not come from SYNC_IN
+    static int get_sync_ppqn(MidiClkType type);
     int get_clock_division_ticks(MidiOutType type);
+
+    // Wait-free read of the published settings (seqlock).
+    // Copies the snapshot into *out only if its version differs from *known_version.
+    // Returns true if *out was updated.
+    bool read_snapshot(MidiSettingsData* out, uint32_t* known_version);
+    uint32_t get_version(void) { return published.get_version(); }
+
+    // Called after every change is published, on the task that made it and
+    // with the state locked, so it must only signal another task
+    typedef void (*ChangeCallback)(void);
+    void set_change_callback(ChangeCallback callback) { change_callback = callback; }
     
 private:
-    int bpm;
-    MidiChannel midi_channel;
-    MidiOutType midi_out_type[OutChannelCount];
-    MidiChannel midi_out_channel[OutChannelCount];
-    MidiClkType midi_clk_type;
+    MidiSettingsData data; // Working copy of the active preset
+    PresetBank bank; // The active preset in it is only updated on a switch or a write
     SemaphoreHandle_t state_mutex;
 
+    // Dirty tracking under state_mutex, store_mutex serializes the flash writers.
+    // deferred_store.stored and store_snapshot are only written under store_mutex.
+    DeferredStore<PresetBank> deferred_store;
+    PresetBank store_snapshot;
+    SemaphoreHandle_t store_mutex;
+    TaskHandle_t store_task_handle;
+
+    // Requests of the audio task, applied by a task that never takes store_mutex,
+    // so a switch only waits for the short state_mutex sections, not for flash
+    TaskHandle_t settings_task_handle;
+    static const uint32_t NO_PRESET = UINT32_MAX;
+    std::atomic<uint32_t> requested_preset; // NO_PRESET if none
+    static const int32_t NO_BPM = 0;
+    std::atomic<int32_t> requested_bpm; // NO_BPM if none
+
+    // Snapshot for lock-free readers
+    Seqlock<MidiSettingsData> published;
+    ChangeCallback change_callback;
+
     const char* midi_channel_to_string(MidiChannel ch);
     const char* midi_out_type_to_string(MidiOutType type);
     const char* midi_clk_type_to_string(MidiClkType type);
+    const char* midi_tx_type_to_string(MidiTxType type);
+    const char* note_priority_to_string(NotePriority priority);
     void set_default(void);
+    void publish(void);
     esp_err_t recall_nvs(void);
-    esp_err_t store_nvs(void);
+    esp_err_t store_nvs(const PresetBank& presets, const PresetBank& previous);
+    void write_pending(bool force);
+    void apply_requested_preset(void);
+    void apply_requested_bpm(void);
+    static void store_task(void* parameter);
+    static void settings_task(void* parameter);
+    static void shutdown_handler(void);
 };
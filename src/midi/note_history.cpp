@@ -1,90 +1,67 @@
 #include "note_history.h"
-#include <Arduino.h>
-#include <algorithm>
-#include "../board.h"
-
-void NoteHistory::Note::reset(void)
-{
-    prev = NO_NOTE;
-    next = NO_NOTE;
-    in_use = false;
-    id = 0;
+#include <string.h>
+
+uint8_t NoteHistory::find_first_clear(const uint32_t* bits) {
+    for (size_t w = 0; w < WORD_COUNT; w++) {
+        uint32_t free_bits = ~bits[w];
+        if (free_bits != 0) {
+            return w * WORD_BITS + __builtin_ctz(free_bits);
+        }
+    }
+    return NO_NOTE;
+}
+
+void NoteHistory::order_remove(uint8_t note) {
+    for (int i = order_count - 1; i >= 0; i--) {
+        if (order[i] == note) {
+            memmove(&order[i], &order[i + 1], order_count - i - 1);
+            order_count--;
+            return;
+        }
+    }
 }
 
 bool NoteHistory::push(uint8_t note, uint8_t* out_id) {
-    if(DEBUG_MIDI_PROCESSOR) Serial.printf("  pushing note: %d\n", note);
-    
-    if (history[note].in_use) {
-        Serial.println("  push FAILED: note already in use");
+    if (note >= MIDI_NOTES_COUNT) {
         return false;
     }
 
-    // Find the minimum available id
-    uint8_t new_id = 0;
-    if (last != NO_NOTE) {
-        // Collect all used ids from the linked list
-        uint8_t used_ids[MIDI_NOTES_COUNT];
-        uint8_t ids_count = 0;
-        uint8_t current = last;
-        
-        // Traverse the linked list and collect all ids
-        do {
-            used_ids[ids_count++] = history[current].id;
-            current = history[current].prev;
-        } while (current != NO_NOTE);
-        
-        // Sort
-        std::sort(used_ids, used_ids + ids_count);
-        
-        // Find the first gap in one pass
-        for (uint8_t i = 0; i < ids_count; i++) {
-            if (used_ids[i] != i) {
-                new_id = i;
-                break;
-            }
-            new_id = i + 1;
-        }
+    if (is_in_use(note)) {
+        return false;
     }
 
-    history[note].in_use = true;
-    history[note].id = new_id;
-    history[note].prev = last;
-    if (last != NO_NOTE) {
-        history[last].next = note;
+    // Lowest free id, there are as many ids as notes so one is always free
+    uint8_t new_id = find_first_clear(used_ids);
+
+    active[note / WORD_BITS] |= 1u << (note % WORD_BITS);
+    used_ids[new_id / WORD_BITS] |= 1u << (new_id % WORD_BITS);
+    ids[note] = new_id;
+
+    // Drop the oldest entry when the order stack is full
+    if (order_count == ORDER_DEPTH) {
+        memmove(&order[0], &order[1], ORDER_DEPTH - 1);
+        order_count--;
     }
-    last = note;
+    order[order_count++] = note;
     count++;
-    
+
     if (out_id != nullptr) {
         *out_id = new_id;
     }
-    
+
     return true;
 }
 
 bool NoteHistory::pop(uint8_t note, uint8_t* out_id) {
-    if(DEBUG_MIDI_PROCESSOR) Serial.printf("  popping note: %d\n", note);
-    
-    if (!history[note].in_use) {
-        Serial.println("  pop FAILED: note not in use");
+    if (note >= MIDI_NOTES_COUNT || !is_in_use(note)) {
         return false;
     }
 
-    uint8_t note_id = history[note].id;
-    uint8_t prev = history[note].prev;
-    uint8_t next = history[note].next;
-
-    if (note != last) {
-        history[prev].next = next;
-        history[next].prev = prev;
-    } else {
-        last = prev;
-        if (prev != NO_NOTE) {
-            history[prev].next = NO_NOTE;
-        }
-    }
+    uint8_t note_id = ids[note];
 
-    history[note].reset();
+    active[note / WORD_BITS] &= ~(1u << (note % WORD_BITS));
+    used_ids[note_id / WORD_BITS] &= ~(1u << (note_id % WORD_BITS));
+    order_remove(note);
     count--;
 
     if (out_id != nullptr) {
@@ -95,22 +72,17 @@ bool NoteHistory::pop(uint8_t note, uint8_t* out_id) {
 }
 
 bool NoteHistory::is_in_use(uint8_t note) {
-    return history[note].in_use;
-}
-
-uint8_t NoteHistory::get_prev(uint8_t note) {
-    return history[note].prev;
-}
-
-uint8_t NoteHistory::get_next(uint8_t note) {
-    return history[note].next;
+    if (note >= MIDI_NOTES_COUNT) {
+        return false;
+    }
+    return (active[note / WORD_BITS] >> (note % WORD_BITS)) & 1;
 }
 
 void NoteHistory::reset(void) {
-    for (int i = 0; i < MIDI_NOTES_COUNT; i++) {
-        history[i].reset();
-    }
-    last = NO_NOTE;
+    memset(active, 0, sizeof(active));
+    memset(used_ids, 0, sizeof(used_ids));
+    memset(ids, 0, sizeof(ids));
+    order_count = 0;
     count = 0;
 }
 
@@ -123,23 +95,31 @@ bool NoteHistory::is_empty(void) {
 }
 
 uint8_t NoteHistory::get_last(void) {
-    return last;
+    if (order_count > 0) {
+        return order[order_count - 1];
+    }
+    // More notes are held than the order stack remembers
+    return get_highest();
 }
 
-uint8_t NoteHistory::get_current(void) {
-    if (last == NO_NOTE) {
-        return NO_NOTE;
+uint8_t NoteHistory::get_highest(void) {
+    for (int w = WORD_COUNT - 1; w >= 0; w--) {
+        if (active[w] != 0) {
+            return w * WORD_BITS + (WORD_BITS - 1 - __builtin_clz(active[w]));
+        }
     }
-    
-    uint8_t max_note = last;
-    uint8_t current = history[last].prev;
-    
-    while (current != NO_NOTE) {
-        if (current > max_note) {
-            max_note = current;
+    return NO_NOTE;
+}
+
+uint8_t NoteHistory::get_lowest(void) {
+    for (size_t w = 0; w < WORD_COUNT; w++) {
+        if (active[w] != 0) {
+            return w * WORD_BITS + __builtin_ctz(active[w]);
         }
-        current = history[current].prev;
     }
-    
-    return max_note;
+    return NO_NOTE;
+}
+
+uint8_t NoteHistory::get_current(void) {
+    return get_highest();
 }
@@ -5,35 +5,37 @@
 
 struct NoteHistory
 {
-    static const size_t  MIDI_NOTES_COUNT = 127;
+    static const size_t  MIDI_NOTES_COUNT = 128;
     static const uint8_t NO_NOTE = (1 << 7);
+    static const size_t  ORDER_DEPTH = 16; // Most recent notes kept for last-note lookups
 
-    struct Note
-    {
-        uint8_t prev;
-        uint8_t next;
-        bool in_use;
-        uint8_t id;
+    static const size_t  WORD_BITS = 32;
+    static const size_t  WORD_COUNT = MIDI_NOTES_COUNT / WORD_BITS;
 
-        void reset(void);
+    uint32_t active[WORD_COUNT];   // Held notes bitmap
+    uint32_t used_ids[WORD_COUNT]; // Allocated voice ids bitmap
+    uint8_t ids[MIDI_NOTES_COUNT]; // Voice id per held note
 
-        Note() { reset(); }
-    };
+    // Most recent held notes, order[order_count - 1] is the last one
+    uint8_t order[ORDER_DEPTH];
+    uint8_t order_count;
 
-    Note history[MIDI_NOTES_COUNT];
-    int last;
     int count;
 
     bool push(uint8_t note, uint8_t* out_id);
     bool pop(uint8_t note, uint8_t* out_id);
     bool is_in_use(uint8_t note);
-    uint8_t get_prev(uint8_t note);
-    uint8_t get_next(uint8_t note);
     void reset(void);
     int get_count(void);
     bool is_empty(void);
     uint8_t get_last(void);
+    uint8_t get_highest(void);
+    uint8_t get_lowest(void);
     uint8_t get_current(void);
 
     NoteHistory() { reset(); }
+
+private:
+    static uint8_t find_first_clear(const uint32_t* bits);
+    void order_remove(uint8_t note);
 };
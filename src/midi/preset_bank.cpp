@@ -0,0 +1,68 @@
+#include <string.h>
+#include "preset_bank.h"
+
+static const char* const PRESET_KEYS[PresetBank::PRESET_COUNT] = {
+    SettingsBlob::KEY, "preset1", "preset2", "preset3", "preset4", "preset5", "preset6", "preset7"
+};
+
+PresetBank::PresetBank() {
+    memset(presets, 0, sizeof(presets));
+    active = 0;
+}
+
+const char* PresetBank::get_key(size_t idx) {
+    return (idx < PRESET_COUNT) ? PRESET_KEYS[idx] : nullptr;
+}
+
+void PresetBank::fill(const MidiSettingsData& settings) {
+    for (size_t i = 0; i < PRESET_COUNT; i++) {
+        memcpy(&presets[i], &settings, sizeof(presets[i]));
+    }
+    active = 0;
+}
+
+bool PresetBank::select(size_t idx, MidiSettingsData* working) {
+    if (idx >= PRESET_COUNT || idx == active) return false;
+
+    memcpy(&presets[active], working, sizeof(presets[active]));
+    memcpy(working, &presets[idx], sizeof(*working));
+    active = idx;
+    return true;
+}
+
+SettingsBlob::Source PresetBank::load(SettingsStorage* storage, const MidiSettingsData& defaults) {
+    fill(defaults);
+
+    // Also migrates the keys of older firmware into preset 0
+    SettingsBlob::Source source = SettingsBlob::load(storage, &presets[0]);
+
+    bool written = false;
+    for (size_t i = 1; i < PRESET_COUNT; i++) {
+        if (!SettingsBlob::read(storage, PRESET_KEYS[i], &presets[i])) {
+            memcpy(&presets[i], &presets[0], sizeof(presets[i]));
+            written |= SettingsBlob::write(storage, PRESET_KEYS[i], presets[i]);
+        }
+    }
+    if (written) {
+        storage->commit();
+    }
+
+    uint32_t value;
+    if (storage->get_u32(ACTIVE_KEY, &value) && value < PRESET_COUNT) {
+        active = value;
+    }
+    return source;
+}
+
+bool PresetBank::save(SettingsStorage* storage, const PresetBank& previous) const {
+    bool ok = true;
+    for (size_t i = 0; i < PRESET_COUNT; i++) {
+        if (memcmp(&presets[i], &previous.presets[i], sizeof(presets[i])) != 0) {
+            ok &= SettingsBlob::write(storage, PRESET_KEYS[i], presets[i]);
+        }
+    }
+    if (active != previous.active) {
+        ok &= storage->set_u32(ACTIVE_KEY, active);
+    }
+    return ok && storage->commit();
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "midi_settings_data.h"
+#include "settings_store.h"
+
+// Complete settings presets held in RAM, one of them active.
+// Switching copies whole presets and never touches flash, save() later
+// writes only the presets that changed. Preset 0 is the settings blob of
+// firmware without presets, presets missing from flash start as copies of it.
+// Has no hardware dependencies and is copied with memcpy, see DeferredStore.
+struct PresetBank
+{
+    static const size_t PRESET_COUNT = 8;
+    static constexpr const char* ACTIVE_KEY = "preset";
+
+    MidiSettingsData presets[PRESET_COUNT];
+    uint32_t active;
+
+    PresetBank();
+
+    // Every preset set to settings, the first one active
+    void fill(const MidiSettingsData& settings);
+
+    // Keeps the working copy of the active preset and loads preset idx into it.
+    // Returns false if idx is out of range or already active.
+    bool select(size_t idx, MidiSettingsData* working);
+
+    // defaults fill the fields and presets flash does not have.
+    // Presets missing from flash are written so the next boot sees the same bank.
+    SettingsBlob::Source load(SettingsStorage* storage, const MidiSettingsData& defaults);
+    // Writes the presets and active index that differ from previous, one commit
+    bool save(SettingsStorage* storage, const PresetBank& previous) const;
+
+    static const char* get_key(size_t idx);
+};
@@ -0,0 +1,196 @@
+#include "settings_store.h"
+#include <stdio.h>
+
+// Version 0 keys, one per value, per output keys end with the output index
+static const char* const LEGACY_KEYS[] = {"bpm", "midi_channel", "midi_clk_type", "midi_tx"};
+static const char* const LEGACY_OUTPUT_PREFIXES[] = {"out_t", "out_c", "out_p", "out_m", "out_d", "out_o", "out_w"};
+static const size_t LEGACY_OUTPUT_FIELDS = sizeof(LEGACY_OUTPUT_PREFIXES) / sizeof(LEGACY_OUTPUT_PREFIXES[0]);
+
+// Packs payload fields little endian
+struct PayloadWriter {
+    uint8_t* data;
+    size_t pos;
+
+    void put_u8(uint8_t value) { data[pos++] = value; }
+    void put_u16(uint16_t value) { put_u8(value & 0xFF); put_u8(value >> 8); }
+};
+
+// Reads payload fields in the same order, reads past the end fail and leave the value alone
+struct PayloadReader {
+    const uint8_t* data;
+    size_t size;
+    size_t pos;
+
+    bool get_u8(uint8_t* value) {
+        if (pos + 1 > size) return false;
+        *value = data[pos++];
+        return true;
+    }
+    bool get_u16(uint16_t* value) {
+        if (pos + 2 > size) return false;
+        *value = data[pos] | (data[pos + 1] << 8);
+        pos += 2;
+        return true;
+    }
+};
+
+static uint32_t get_le32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void put_le32(uint8_t* p, uint32_t value) {
+    p[0] = value & 0xFF;
+    p[1] = (value >> 8) & 0xFF;
+    p[2] = (value >> 16) & 0xFF;
+    p[3] = value >> 24;
+}
+
+uint32_t SettingsBlob::crc32(const uint8_t* data, size_t size) {
+    // CRC-32/ISO-HDLC, bitwise: the blob is small and written rarely
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < size; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+size_t SettingsBlob::encode(const MidiSettingsData& data, uint8_t* out) {
+    PayloadWriter payload = {out + HEADER_SIZE, 0};
+    payload.put_u16((uint16_t)data.bpm);
+    payload.put_u8((uint8_t)data.midi_channel);
+    payload.put_u8((uint8_t)data.midi_clk_type);
+    payload.put_u8((uint8_t)data.midi_tx_type);
+    for (size_t i = 0; i < OutChannelCount; i++) {
+        payload.put_u8((uint8_t)data.midi_out_type[i]);
+        payload.put_u8((uint8_t)data.midi_out_channel[i]);
+        payload.put_u8((uint8_t)data.note_priority[i]);
+        payload.put_u8(data.clock_ratio[i].mul);
+        payload.put_u8(data.clock_ratio[i].div);
+        payload.put_u8(data.clock_ratio[i].phase);
+        payload.put_u8(data.clock_ratio[i].pulse_ms);
+    }
+
+    out[0] = MAGIC & 0xFF;
+    out[1] = MAGIC >> 8;
+    out[2] = VERSION;
+    out[3] = (uint8_t)payload.pos;
+    put_le32(out + HEADER_SIZE + payload.pos, crc32(out, HEADER_SIZE + payload.pos));
+    return HEADER_SIZE + payload.pos + CRC_SIZE;
+}
+
+bool SettingsBlob::decode(const uint8_t* blob, size_t size, MidiSettingsData* data) {
+    if (size < HEADER_SIZE + CRC_SIZE) return false;
+    if ((blob[0] | (blob[1] << 8)) != MAGIC) return false;
+
+    uint8_t version = blob[2];
+    size_t length = blob[3];
+    if (version == 0 || version > VERSION) return false;
+    if (HEADER_SIZE + length + CRC_SIZE != size) return false;
+    if (get_le32(blob + HEADER_SIZE + length) != crc32(blob, HEADER_SIZE + length)) return false;
+
+    // Fields past the end of an older payload keep their defaults
+    PayloadReader payload = {blob + HEADER_SIZE, length, 0};
+    uint16_t bpm;
+    uint8_t value;
+    if (payload.get_u16(&bpm)) data->bpm = bpm;
+    if (payload.get_u8(&value)) data->midi_channel = (MidiChannel)value;
+    if (payload.get_u8(&value)) data->midi_clk_type = (MidiClkType)value;
+    if (payload.get_u8(&value)) data->midi_tx_type = (MidiTxType)value;
+    for (size_t i = 0; i < OutChannelCount; i++) {
+        if (payload.get_u8(&value)) data->midi_out_type[i] = (MidiOutType)value;
+        if (payload.get_u8(&value)) data->midi_out_channel[i] = (MidiChannel)value;
+        if (payload.get_u8(&value) && is_note_priority_valid(value)) data->note_priority[i] = (NotePriority)value;
+        payload.get_u8(&data->clock_ratio[i].mul);
+        payload.get_u8(&data->clock_ratio[i].div);
+        payload.get_u8(&data->clock_ratio[i].phase);
+        payload.get_u8(&data->clock_ratio[i].pulse_ms);
+    }
+    return true;
+}
+
+bool SettingsBlob::load_legacy(SettingsStorage* storage, MidiSettingsData* data) {
+    bool found = false;
+    uint32_t value;
+
+    if (storage->get_u32("bpm", &value)) { data->bpm = (int)value; found = true; }
+    if (storage->get_u32("midi_channel", &value)) { data->midi_channel = (MidiChannel)value; found = true; }
+    if (storage->get_u32("midi_clk_type", &value)) { data->midi_clk_type = (MidiClkType)value; found = true; }
+    if (storage->get_u32("midi_tx", &value)) { data->midi_tx_type = (MidiTxType)value; found = true; }
+
+    for (size_t i = 0; i < OutChannelCount; i++) {
+        ClockRatio& ratio = data->clock_ratio[i];
+        for (size_t f = 0; f < LEGACY_OUTPUT_FIELDS; f++) {
+            char key[10];
+            snprintf(key, sizeof(key), "%s%zu", LEGACY_OUTPUT_PREFIXES[f], i);
+            if (!storage->get_u32(key, &value)) continue;
+
+            found = true;
+            switch (f) {
+                case 0: data->midi_out_type[i] = (MidiOutType)value; break;
+                case 1: data->midi_out_channel[i] = (MidiChannel)value; break;
+                case 2: if (is_note_priority_valid(value)) data->note_priority[i] = (NotePriority)value; break;
+                case 3: ratio.mul = (uint8_t)value; break;
+                case 4: ratio.div = (uint8_t)value; break;
+                case 5: ratio.phase = (uint8_t)value; break;
+                case 6: ratio.pulse_ms = (uint8_t)value; break;
+            }
+        }
+    }
+    return found;
+}
+
+void SettingsBlob::erase_legacy(SettingsStorage* storage) {
+    for (size_t k = 0; k < sizeof(LEGACY_KEYS) / sizeof(LEGACY_KEYS[0]); k++) {
+        storage->erase_key(LEGACY_KEYS[k]);
+    }
+    for (size_t i = 0; i < OutChannelCount; i++) {
+        for (size_t f = 0; f < LEGACY_OUTPUT_FIELDS; f++) {
+            char key[10];
+            snprintf(key, sizeof(key), "%s%zu", LEGACY_OUTPUT_PREFIXES[f], i);
+            storage->erase_key(key);
+        }
+    }
+}
+
+bool SettingsBlob::write(SettingsStorage* storage, const char* key, const MidiSettingsData& data) {
+    uint8_t blob[SIZE];
+    size_t size = encode(data, blob);
+    return storage->set_blob(key, blob, size);
+}
+
+bool SettingsBlob::read(SettingsStorage* storage, const char* key, MidiSettingsData* data) {
+    uint8_t blob[MAX_SIZE];
+    size_t size = sizeof(blob);
+
+    // decode() checks the whole blob before it touches data
+    if (!storage->get_blob(key, blob, &size) || !decode(blob, size, data)) {
+        return false;
+    }
+    if (blob[2] < VERSION && write(storage, key, *data)) {
+        storage->commit(); // Store the fields a newer version added
+    }
+    return true;
+}
+
+bool SettingsBlob::save(SettingsStorage* storage, const MidiSettingsData& data) {
+    return write(storage, KEY, data) && storage->commit();
+}
+
+SettingsBlob::Source SettingsBlob::load(SettingsStorage* storage, MidiSettingsData* data) {
+    if (read(storage, KEY, data)) {
+        return SourceBlob;
+    }
+
+    // No blob yet (or a corrupt one): keys from older firmware or the factory image
+    Source source = load_legacy(storage, data) ? SourceLegacy : SourceDefaults;
+
+    // The blob is written before the keys go, a power cut in between keeps a readable state
+    if (save(storage, *data) && source == SourceLegacy) {
+        erase_legacy(storage);
+        storage->commit();
+    }
+    return source;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "midi_settings_data.h"
+
+// Key-value storage the settings live in, an NVS namespace on the device.
+// Every call returns false on failure, get_*() also when the key is missing.
+class SettingsStorage
+{
+public:
+    virtual ~SettingsStorage() {}
+
+    virtual bool get_u32(const char* key, uint32_t* value) = 0;
+    virtual bool set_u32(const char* key, uint32_t value) = 0;
+    // size is the buffer size on entry, the blob size on return
+    virtual bool get_blob(const char* key, void* data, size_t* size) = 0;
+    virtual bool set_blob(const char* key, const void* data, size_t size) = 0;
+    virtual bool erase_key(const char* key) = 0; // Missing keys count as erased
+    virtual bool commit(void) = 0;
+};
+
+// All settings in one CRC protected blob:
+//   magic u16, version u8, payload length u8, payload, crc32 of everything before it.
+// The payload is packed little endian and only ever grows, a newer version
+// appends fields and older payloads leave them at their defaults. Version 0
+// is the previous one-key-per-value layout, also used by the nvs.csv factory
+// image, and is migrated to a blob on first load.
+class SettingsBlob
+{
+public:
+    static constexpr const char* KEY = "settings";
+    static const uint16_t MAGIC = 0x534D; // "MS"
+    static const uint8_t VERSION = 1;
+    static const size_t HEADER_SIZE = 4;
+    static const size_t CRC_SIZE = 4;
+    static const size_t PAYLOAD_SIZE = 5 + 7 * OutChannelCount; // Version 1
+    static const size_t SIZE = HEADER_SIZE + PAYLOAD_SIZE + CRC_SIZE;
+    static const size_t MAX_SIZE = 128; // Largest blob read back, room for newer versions
+
+    enum Source {
+        SourceBlob,
+        SourceLegacy, // Migrated from version 0 keys
+        SourceDefaults, // Nothing usable stored
+    };
+
+    // data must hold the defaults, fields the stored version lacks keep them
+    static Source load(SettingsStorage* storage, MidiSettingsData* data);
+    static bool save(SettingsStorage* storage, const MidiSettingsData& data);
+
+    // Blob under any key, without the version 0 fallback. write() does not commit,
+    // read() leaves data untouched and returns false if the blob is missing or bad.
+    static bool read(SettingsStorage* storage, const char* key, MidiSettingsData* data);
+    static bool write(SettingsStorage* storage, const char* key, const MidiSettingsData& data);
+
+    static size_t encode(const MidiSettingsData& data, uint8_t* out); // SIZE bytes
+    // Returns false for a bad magic, length, CRC or a version newer than VERSION
+    static bool decode(const uint8_t* blob, size_t size, MidiSettingsData* data);
+    static uint32_t crc32(const uint8_t* data, size_t size);
+
+private:
+    static bool load_legacy(SettingsStorage* storage, MidiSettingsData* data);
+    static void erase_legacy(SettingsStorage* storage);
+};
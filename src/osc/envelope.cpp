@@ -0,0 +1,64 @@
+#include "envelope.h"
+
+EnvelopeParams::EnvelopeParams(uint32_t tick_rate) : tick_rate(tick_rate) {
+    set_attack_ms(5);
+    set_decay_ms(100);
+    set_sustain(127);
+    set_release_ms(50);
+}
+
+void EnvelopeParams::set_sustain(uint8_t value) {
+    if (value > 127) value = 127;
+    sustain_level = (int32_t)(((int64_t)Envelope::FULL_SCALE * value) / 127);
+}
+
+uint32_t EnvelopeParams::cc_to_ms(uint8_t value) {
+    if (value > 127) value = 127;
+    return MIN_TIME_MS + (uint32_t)value * value * (MAX_TIME_MS - MIN_TIME_MS) / (127 * 127);
+}
+
+int32_t EnvelopeParams::time_to_step(uint32_t ms) {
+    if (ms < MIN_TIME_MS) ms = MIN_TIME_MS;
+    uint32_t ticks = ms * tick_rate / 1000;
+    if (ticks == 0) ticks = 1;
+    return Envelope::FULL_SCALE / ticks;
+}
+
+int16_t Envelope::tick(const EnvelopeParams& params) {
+    switch (stage) {
+        case StageAttack:
+            value += params.attack_step;
+            if (value >= FULL_SCALE) {
+                value = FULL_SCALE;
+                stage = StageDecay;
+            }
+            break;
+        case StageDecay:
+            value -= params.decay_step;
+            if (value <= params.sustain_level) {
+                value = params.sustain_level;
+                stage = StageSustain;
+            }
+            break;
+        case StageSustain:
+            // Follow sustain changes made while the note is held
+            value = params.sustain_level;
+            break;
+        case StageRelease:
+            value -= params.release_step;
+            if (value <= 0) {
+                value = 0;
+                stage = StageIdle;
+            }
+            break;
+        default:
+            value = 0;
+            break;
+    }
+
+    if (stage == StageSustain && value == 0) {
+        stage = StageIdle;
+    }
+
+    return (int16_t)((value >> OUT_SHIFT) > 32767 ? 32767 : (value >> OUT_SHIFT));
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Linear ADSR parameters, steps are per control tick in Envelope::FULL_SCALE units
+struct EnvelopeParams
+{
+    static const uint32_t MIN_TIME_MS = 1;
+    static const uint32_t MAX_TIME_MS = 5000;
+
+    int32_t attack_step;
+    int32_t decay_step;
+    int32_t sustain_level;
+    int32_t release_step;
+    uint32_t tick_rate; // Control ticks per second
+
+    EnvelopeParams(uint32_t tick_rate);
+
+    void set_attack_ms(uint32_t ms) { attack_step = time_to_step(ms); }
+    void set_decay_ms(uint32_t ms) { decay_step = time_to_step(ms); }
+    void set_release_ms(uint32_t ms) { release_step = time_to_step(ms); }
+    void set_sustain(uint8_t value); // 0..127
+
+    // Maps a 7 bit CC value to MIN_TIME_MS..MAX_TIME_MS, finer at short times
+    static uint32_t cc_to_ms(uint8_t value);
+
+private:
+    int32_t time_to_step(uint32_t ms);
+};
+
+// ADSR envelope advanced once per control tick
+struct Envelope
+{
+    static const int32_t FULL_SCALE = 1 << 24;
+    static const int OUT_SHIFT = 9; // FULL_SCALE to Q15
+
+    enum Stage : uint8_t {
+        StageIdle,
+        StageAttack,
+        StageDecay,
+        StageSustain,
+        StageRelease,
+    };
+
+    Stage stage;
+    int32_t value;
+
+    Envelope() : stage(StageIdle), value(0) {}
+
+    // Attack starts from the current value, so retriggers do not click
+    void note_on(void) { stage = StageAttack; }
+    void note_off(void) {
+        if (stage != StageIdle) stage = StageRelease;
+    }
+    bool is_active(void) const { return stage != StageIdle; }
+
+    // Advances one control tick and returns the level in Q15
+    int16_t tick(const EnvelopeParams& params);
+};
@@ -0,0 +1,23 @@
+#include <math.h>
+#include "mixer.h"
+
+float Mixer::clip_curve(float x) {
+    float y = fabsf(x);
+    if (y > CLIP_KNEE) {
+        const float headroom = 127 - CLIP_KNEE;
+        y = CLIP_KNEE + headroom * tanhf((y - CLIP_KNEE) / headroom);
+    }
+    return x < 0 ? -y : y;
+}
+
+void Mixer::begin(void) {
+    for (int i = 0; i < 2 * CLIP_RANGE; i++) {
+        clip_lut[i] = (int8_t)lroundf(clip_curve((float)(i - CLIP_RANGE)));
+    }
+
+    // Equal power normalization, so a single voice plays at full level
+    norm_table[0] = 1 << NORM_BITS;
+    for (int n = 1; n <= MAX_VOICES; n++) {
+        norm_table[n] = lroundf((1 << NORM_BITS) / sqrtf((float)n));
+    }
+}
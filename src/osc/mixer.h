@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Voice mixer in Q15 gains: equal power normalization by the number of
+// active voices, then a tanh soft clipper maps the mix back to 8 bit
+struct Mixer
+{
+    static const int GAIN_ONE = 32767;
+    static const int NORM_BITS = 12;
+    static const int CLIP_RANGE = 512; // Mix range covered by the clipper table, +/-
+    static const int CLIP_KNEE = 96;   // Below this the clipper is linear
+    static const int MAX_VOICES = 16;
+
+    int8_t clip_lut[2 * CLIP_RANGE];
+    int16_t norm_table[MAX_VOICES + 1]; // Q12, 1/sqrt(active voices)
+
+    void begin(void);
+
+    int16_t get_norm(int active_voices) const {
+        return norm_table[active_voices > MAX_VOICES ? MAX_VOICES : active_voices];
+    }
+
+    // sum is a sum of int8 samples multiplied by Q15 gains
+    inline int8_t out(int32_t sum, int16_t norm) const {
+        const int shift = 7 + NORM_BITS;
+        int32_t v = ((sum >> 8) * norm + (1 << (shift - 1))) >> shift;
+        if (v < -CLIP_RANGE) v = -CLIP_RANGE;
+        if (v > CLIP_RANGE - 1) v = CLIP_RANGE - 1;
+        return clip_lut[v + CLIP_RANGE];
+    }
+
+    // Clipper curve the table is sampled from, x in mix units
+    static float clip_curve(float x);
+};
@@ -1,66 +1,201 @@
 #include <Oscil.h>
 #include <tables/waveshape_chebyshev_5th_256_int8.h>
-#include <mozzi_midi.h>
+#include "voice_pool.h"
+#include "envelope.h"
+#include "wavetable.h"
+#include "mixer.h"
+#include "pitch_table.h"
 
 const bool DEBUG_OSC = true;
-const int NUM_OSCS = 5;
+const int NUM_OSCS = 8; // Voices per Mozzi channel, the test_mixer render cost sweep fits 9, DEBUG_TASK_LOAD shows the device cycles
+const VoiceStealPolicy VOICE_STEAL_POLICY = VoiceStealSameNote;
 
-float pitchBend[MOZZI_AUDIO_CHANNELS];
+// Envelope CC numbers (MIDI sound controllers)
+const uint8_t ENV_CC_RELEASE = 72;
+const uint8_t ENV_CC_ATTACK = 73;
+const uint8_t ENV_CC_DECAY = 75;
+const uint8_t ENV_CC_SUSTAIN = 79;
+
+// Waveform select CC (sound variation), value range is split evenly between waveforms
+const uint8_t WAVE_CC = 70;
+
+// Note to phase increment and pitchbend ratio tables, filled in osc_init()
+static PitchTable pitch_table;
+static uint16_t bend_ratio[MOZZI_AUDIO_CHANNELS];
+
+static_assert(NUM_OSCS <= Mixer::MAX_VOICES, "Mixer normalization table is too short");
+static Mixer mixer;
+static int16_t mix_norm[MOZZI_AUDIO_CHANNELS]; // Q12, 1/sqrt(active voices)
+static uint32_t sounding[MOZZI_AUDIO_CHANNELS]; // Voices whose envelope still runs, released ones included
+
+static_assert(WavetableBank::CELLS == CHEBYSHEV_5TH_256_NUM_CELLS, "Wavetable size must match Oscil table size");
+static WavetableBank wavetables;
+static Waveform waveform[MOZZI_AUDIO_CHANNELS] = {WaveChebyshev, WaveChebyshev};
+
+static EnvelopeParams env_params[MOZZI_AUDIO_CHANNELS] = {
+    EnvelopeParams(MOZZI_CONTROL_RATE),
+    EnvelopeParams(MOZZI_CONTROL_RATE),
+};
 
 struct Osc {
     Oscil <CHEBYSHEV_5TH_256_NUM_CELLS, AUDIO_RATE> oscil;
     uint8_t note;
     uint8_t velocity;
+    int16_t gain; // Q15, precomputed from velocity
 
-    Osc() : oscil(CHEBYSHEV_5TH_256_DATA), note(0), velocity(0) {}
+    // Envelope runs at control rate, the audio loop ramps env_level by env_inc each sample
+    Envelope env;
+    int16_t env_target; // Q15, gain times envelope at the end of the control tick
+    int32_t env_level;  // Q15 << 16
+    int32_t env_inc;
+
+    Osc() : oscil(CHEBYSHEV_5TH_256_DATA), note(0), velocity(0), gain(0),
+            env_target(0), env_level(0), env_inc(0) {}
+
+    void noteOn(uint8_t v) {
+        velocity = v;
+        gain = (int32_t)v * Mixer::GAIN_ONE / 127;
+        env.note_on();
+    }
+
+    void noteOff(void) {
+        velocity = 0;
+        env.note_off();
+    }
 
-    void setFreq(float pitchBend) {
-        oscil.setFreq(
-            Q16n16_to_float(Q16n16_mtof(Q8n0_to_Q16n16(note))) * pow(2.0f, pitchBend * SignalProcessor::PITCHBEND_RANGE_SEMITONES / 12.0f)
-        );
+    // Also picks the mip level of the waveform for the new pitch
+    void setFreq(uint16_t ratio, Waveform wave) {
+        uint32_t inc = pitch_table.phase_inc(note, ratio);
+        oscil.setPhaseInc(inc);
+        oscil.setTable(wavetables.get(wave, inc));
     }
 };
 
 static Osc oscs[MOZZI_AUDIO_CHANNELS][NUM_OSCS];
+static VoicePool<NUM_OSCS> voice_pool[MOZZI_AUDIO_CHANNELS];
+
+static void pitch_init(void) {
+    pitch_table.begin(CHEBYSHEV_5TH_256_NUM_CELLS, AUDIO_RATE, SignalProcessor::PITCHBEND_RANGE_SEMITONES);
+    for (int ch = 0; ch < MOZZI_AUDIO_CHANNELS; ch++) {
+        bend_ratio[ch] = PitchTable::BEND_NONE;
+    }
+}
+
+static void mixer_init(void) {
+    mixer.begin();
+    for (int ch = 0; ch < MOZZI_AUDIO_CHANNELS; ch++) {
+        mix_norm[ch] = mixer.get_norm(0);
+    }
+}
+
+// Called at MOZZI_CONTROL_RATE
+static void envelope_tick(void) {
+    for (int ch = 0; ch < MOZZI_AUDIO_CHANNELS; ch++) {
+        int active = 0;
+        uint32_t mask = 0;
+        for (int i = 0; i < NUM_OSCS; i++) {
+            Osc& osc = oscs[ch][i];
+            int16_t level = osc.env.tick(env_params[ch]);
+            osc.env_target = ((int32_t)osc.gain * level) >> 15;
+            if (osc.env.is_active()) {
+                active++;
+                mask |= 1u << i;
+            }
+        }
+        sounding[ch] = mask;
+        mix_norm[ch] = mixer.get_norm(active);
+    }
+}
+
+void render_audio(int16_t* left, int16_t* right, size_t frames) {
+    const int16_t norm_l = mix_norm[0];
+    const int16_t norm_r = mix_norm[1];
 
-AudioOutput update_audio(void) {
-    float l = 0;
-    float r = 0;
-    for(int i = 0; i < NUM_OSCS; i++) {
-        l += oscs[0][i].oscil.next() * (float)oscs[0][i].velocity / 127.0f;
-        r += oscs[1][i].oscil.next() * (float)oscs[1][i].velocity / 127.0f;
+    // Ramp every voice to its envelope target over the block
+    for(int ch = 0; ch < MOZZI_AUDIO_CHANNELS; ch++) {
+        for(int i = 0; i < NUM_OSCS; i++) {
+            Osc& osc = oscs[ch][i];
+            osc.env_inc = (((int32_t)osc.env_target << 16) - osc.env_level) / (int32_t)frames;
+        }
+    }
+
+    for(size_t n = 0; n < frames; n++) {
+        int32_t l = 0;
+        int32_t r = 0;
+        for(int i = 0; i < NUM_OSCS; i++) {
+            l += oscs[0][i].oscil.next() * (oscs[0][i].env_level >> 16);
+            r += oscs[1][i].oscil.next() * (oscs[1][i].env_level >> 16);
+            oscs[0][i].env_level += oscs[0][i].env_inc;
+            oscs[1][i].env_level += oscs[1][i].env_inc;
+        }
+        // Same scaling as StereoOutput::from8Bit()
+        left[n] = mixer.out(l, norm_l) << (MOZZI_AUDIO_BITS - 8);
+        right[n] = mixer.out(r, norm_r) << (MOZZI_AUDIO_BITS - 8);
+    }
+
+    // Drop the division remainder
+    for(int ch = 0; ch < MOZZI_AUDIO_CHANNELS; ch++) {
+        for(int i = 0; i < NUM_OSCS; i++) {
+            oscs[ch][i].env_level = (int32_t)oscs[ch][i].env_target << 16;
+        }
     }
-    return StereoOutput::from8Bit((int)(l / NUM_OSCS), (int)(r / NUM_OSCS));
 }
 
 void event_callback(ProcessorEventType event_type, ProcessorEvent event) {
+    if (event_type == EventControl) {
+        envelope_tick();
+        return;
+    }
+
     // print note on event
     if (event_type == EventNoteOn) {
         if(DEBUG_OSC) Serial.printf("note on: %d, %d, %d id: %d\n", event.note.channel, event.note.note, event.note.velocity, event.note.id);
 
-        if(event.note.id < NUM_OSCS) {
-            oscs[event.note.channel][event.note.id].note = event.note.note;
-            oscs[event.note.channel][event.note.id].velocity = event.note.velocity;
-            oscs[event.note.channel][event.note.id].setFreq(pitchBend[event.note.channel]);
-        }
+        uint8_t voice = voice_pool[event.note.channel].allocate(event.note.note, event.note.velocity, VOICE_STEAL_POLICY,
+                                                                sounding[event.note.channel]);
+        sounding[event.note.channel] |= 1u << voice;
+        oscs[event.note.channel][voice].note = event.note.note;
+        oscs[event.note.channel][voice].noteOn(event.note.velocity);
+        oscs[event.note.channel][voice].setFreq(bend_ratio[event.note.channel], waveform[event.note.channel]);
     }
     // print note off event
     if (event_type == EventNoteOff) {
         if(DEBUG_OSC) Serial.printf("note off: %d, %d, %d id: %d\n", event.note.channel, event.note.note, event.note.velocity, event.note.id);
-        if(event.note.id < NUM_OSCS) {
-            oscs[event.note.channel][event.note.id].velocity = 0;
+        uint8_t voice = voice_pool[event.note.channel].release(event.note.note);
+        if(voice != VoicePool<NUM_OSCS>::NO_VOICE) {
+            oscs[event.note.channel][voice].noteOff();
         }
     }
 
     // print cc event
     if (event_type == EventCc) {
         if(DEBUG_OSC) Serial.printf("cc: %d, %d, %d\n", event.cc.channel, event.cc.cc, event.cc.value);
+
+        EnvelopeParams& params = env_params[event.cc.channel];
+        switch (event.cc.cc) {
+            case ENV_CC_ATTACK:  params.set_attack_ms(EnvelopeParams::cc_to_ms(event.cc.value)); break;
+            case ENV_CC_DECAY:   params.set_decay_ms(EnvelopeParams::cc_to_ms(event.cc.value)); break;
+            case ENV_CC_SUSTAIN: params.set_sustain(event.cc.value); break;
+            case ENV_CC_RELEASE: params.set_release_ms(EnvelopeParams::cc_to_ms(event.cc.value)); break;
+            default: break;
+        }
+
+        if (event.cc.cc == WAVE_CC) {
+            Waveform wave = (Waveform)((event.cc.value & 0x7F) * WaveCount / 128);
+            if (wave != waveform[event.cc.channel]) {
+                waveform[event.cc.channel] = wave;
+                for(int i = 0; i < NUM_OSCS; i++) {
+                    oscs[event.cc.channel][i].setFreq(bend_ratio[event.cc.channel], wave);
+                }
+                if(DEBUG_OSC) Serial.printf("waveform: %d, %s\n", event.cc.channel, WavetableBank::get_name(wave));
+            }
+        }
     }
 
     if (event_type == EventPitchBend) {
-        pitchBend[event.pitchbend.channel] = ((float)event.pitchbend.value - 8192.0f) / 8192.0f;  // -1.0 .. +1.0
+        bend_ratio[event.pitchbend.channel] = pitch_table.bend_ratio(event.pitchbend.value);
         for(int i = 0; i < NUM_OSCS; i++) {
-            oscs[event.pitchbend.channel][i].setFreq(pitchBend[event.pitchbend.channel]);
+            oscs[event.pitchbend.channel][i].setFreq(bend_ratio[event.pitchbend.channel], waveform[event.pitchbend.channel]);
         }
     }
 
@@ -96,6 +231,9 @@ void event_callback(ProcessorEventType event_type, ProcessorEvent event) {
 }
 
 void osc_init(SignalProcessor* signal_processor) {
-    signal_processor->set_update_audio_callback(update_audio);
+    mixer_init();
+    pitch_init();
+    wavetables.begin(CHEBYSHEV_5TH_256_DATA);
+    signal_processor->set_render_audio_callback(render_audio);
     signal_processor->set_event_callback(event_callback);
 }
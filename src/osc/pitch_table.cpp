@@ -0,0 +1,16 @@
+#include <math.h>
+#include "pitch_table.h"
+
+void PitchTable::begin(size_t cells, uint32_t audio_rate, float bend_semitones) {
+    for (int n = 0; n < 128; n++) {
+        double freq = 440.0 * pow(2.0, (n - 69) / 12.0);
+        note_phase_inc[n] = (uint32_t)lround(freq * cells * (1UL << PHASE_INC_BITS) / audio_rate);
+    }
+
+    // Entry i covers pitchbend value (i << (14 - BEND_TABLE_BITS)) - 8192
+    for (int i = 0; i < BEND_TABLE_SIZE; i++) {
+        double bend = (double)(i - (BEND_TABLE_SIZE - 1) / 2) / ((BEND_TABLE_SIZE - 1) / 2);
+        double ratio = pow(2.0, bend * bend_semitones / 12.0);
+        bend_table[i] = (uint16_t)lround(ratio * (1 << BEND_RATIO_BITS));
+    }
+}
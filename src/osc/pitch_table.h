@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Note to Oscil phase increment and pitchbend to frequency ratio lookups,
+// so a pitch change costs two table reads and one multiply
+struct PitchTable
+{
+    static const int PHASE_INC_BITS = 16; // Fractional bits of Oscil phase increment
+    static const int BEND_RATIO_BITS = 15;
+    static const int BEND_TABLE_BITS = 10;
+    static const int BEND_TABLE_SIZE = (1 << BEND_TABLE_BITS) + 1;
+    static const uint16_t BEND_NONE = 1 << BEND_RATIO_BITS;
+
+    uint32_t note_phase_inc[128];
+    uint16_t bend_table[BEND_TABLE_SIZE]; // Q15 frequency ratio over the full bend range
+
+    // cells is the wavetable length, bend_semitones the range of a full pitchbend
+    void begin(size_t cells, uint32_t audio_rate, float bend_semitones);
+
+    // value is -8192..8191, 0 = no bend
+    uint16_t bend_ratio(int value) const {
+        int idx = (value + 8192) >> (14 - BEND_TABLE_BITS);
+        if (idx < 0) idx = 0;
+        if (idx > BEND_TABLE_SIZE - 1) idx = BEND_TABLE_SIZE - 1;
+        return bend_table[idx];
+    }
+
+    uint32_t phase_inc(uint8_t note, uint16_t ratio) const {
+        return (uint32_t)(((uint64_t)note_phase_inc[note & 0x7F] * ratio) >> BEND_RATIO_BITS);
+    }
+};
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+enum VoiceStealPolicy {
+    VoiceStealOldest,   // Steal the voice held for the longest time
+    VoiceStealQuietest, // Steal the held voice with the lowest level
+    VoiceStealSameNote, // Reuse a released voice of the same note, otherwise steal the oldest
+};
+
+// Voice allocator for N voices (N <= 32), constant time per note.
+// Free voices are a bitmask, held voices are kept in a doubly linked list
+// ordered by allocation time and free voices in one ordered by release time.
+// Held voices are also indexed by level, a bitmask of voices per level and a
+// bitmask of levels in use, so the quietest one is found without a scan.
+// A new note takes a free voice that is silent, else the one released longest
+// ago, so release tails are cut only when every free voice still sounds.
+template <size_t N>
+struct VoicePool
+{
+    static_assert(N > 0 && N <= 32, "VoicePool supports 1..32 voices");
+
+    static const uint8_t NO_VOICE = 0xFF;
+    static const size_t MIDI_NOTES_COUNT = 128;
+    static const size_t LEVELS = 128;
+
+    uint32_t free_mask;
+    uint8_t note_voice[MIDI_NOTES_COUNT]; // Last voice used by a note, NO_VOICE if none
+    uint8_t voice_note[N];
+    uint8_t level[N];
+    uint32_t level_voices[LEVELS];   // Held voices at each level
+    uint32_t level_used[LEVELS / 32]; // Bit per level with a held voice
+
+    // A voice is on one list, held (head is the oldest) or free (free_head released longest ago)
+    uint8_t prev[N];
+    uint8_t next[N];
+    uint8_t head;
+    uint8_t tail;
+    uint8_t free_head;
+    uint8_t free_tail;
+
+    VoicePool() { reset(); }
+
+    void reset(void) {
+        free_mask = (N == 32) ? 0xFFFFFFFFu : ((1u << N) - 1);
+        for (size_t i = 0; i < MIDI_NOTES_COUNT; i++) {
+            note_voice[i] = NO_VOICE;
+        }
+        for (size_t i = 0; i < LEVELS; i++) {
+            level_voices[i] = 0;
+        }
+        for (size_t i = 0; i < LEVELS / 32; i++) {
+            level_used[i] = 0;
+        }
+        head = NO_VOICE;
+        tail = NO_VOICE;
+        free_head = NO_VOICE;
+        free_tail = NO_VOICE;
+        for (size_t i = 0; i < N; i++) {
+            voice_note[i] = 0;
+            level[i] = 0;
+            link_tail(i, &free_head, &free_tail);
+        }
+    }
+
+    bool is_held(uint8_t voice) const {
+        return (free_mask & (1u << voice)) == 0;
+    }
+
+    // Returns the voice for the note, stealing one if all voices are held.
+    // sounding has a bit set for each voice whose envelope is still running.
+    uint8_t allocate(uint8_t note, uint8_t note_level, VoiceStealPolicy policy, uint32_t sounding = 0) {
+        note &= 0x7F;
+        uint8_t voice = note_voice[note];
+
+        if (voice != NO_VOICE && voice_note[voice] == note && is_held(voice)) {
+            // Retrigger of a held note
+            unlink_held(voice);
+        } else if (policy == VoiceStealSameNote && voice != NO_VOICE && voice_note[voice] == note) {
+            // Released voice of the same note
+            take_free(voice);
+        } else if (free_mask != 0) {
+            voice = find_free(sounding);
+            take_free(voice);
+        } else {
+            voice = (policy == VoiceStealQuietest) ? find_quietest() : head;
+            unlink_held(voice);
+        }
+
+        if (note_voice[voice_note[voice]] == voice) {
+            note_voice[voice_note[voice]] = NO_VOICE;
+        }
+        note_voice[note] = voice;
+        voice_note[voice] = note;
+        level[voice] = note_level & (LEVELS - 1);
+        link_tail(voice, &head, &tail);
+        level_voices[level[voice]] |= 1u << voice;
+        level_used[level[voice] / 32] |= 1u << (level[voice] % 32);
+
+        return voice;
+    }
+
+    // Returns the voice that was playing the note, NO_VOICE if none
+    uint8_t release(uint8_t note) {
+        note &= 0x7F;
+        uint8_t voice = note_voice[note];
+        if (voice == NO_VOICE || voice_note[voice] != note || !is_held(voice)) {
+            return NO_VOICE;
+        }
+
+        unlink_held(voice);
+        link_tail(voice, &free_head, &free_tail);
+        free_mask |= 1u << voice;
+        return voice;
+    }
+
+private:
+    // Lowest silent free voice, else the one released longest ago
+    uint8_t find_free(uint32_t sounding) const {
+        uint32_t silent = free_mask & ~sounding;
+        if (silent != 0) {
+            return __builtin_ctz(silent);
+        }
+        return free_head;
+    }
+
+    void take_free(uint8_t voice) {
+        unlink(voice, &free_head, &free_tail);
+        free_mask &= ~(1u << voice);
+    }
+
+    // Lowest held voice at the lowest level in use
+    uint8_t find_quietest(void) const {
+        for (size_t i = 0; i < LEVELS / 32; i++) {
+            if (level_used[i] != 0) {
+                return __builtin_ctz(level_voices[i * 32 + __builtin_ctz(level_used[i])]);
+            }
+        }
+        return head;
+    }
+
+    void unlink_held(uint8_t voice) {
+        unlink(voice, &head, &tail);
+        uint8_t l = level[voice];
+        level_voices[l] &= ~(1u << voice);
+        if (level_voices[l] == 0) {
+            level_used[l / 32] &= ~(1u << (l % 32));
+        }
+    }
+
+    void link_tail(uint8_t voice, uint8_t* list_head, uint8_t* list_tail) {
+        prev[voice] = *list_tail;
+        next[voice] = NO_VOICE;
+        if (*list_tail != NO_VOICE) {
+            next[*list_tail] = voice;
+        } else {
+            *list_head = voice;
+        }
+        *list_tail = voice;
+    }
+
+    void unlink(uint8_t voice, uint8_t* list_head, uint8_t* list_tail) {
+        if (prev[voice] != NO_VOICE) {
+            next[prev[voice]] = next[voice];
+        } else {
+            *list_head = next[voice];
+        }
+        if (next[voice] != NO_VOICE) {
+            prev[next[voice]] = prev[voice];
+        } else {
+            *list_tail = prev[voice];
+        }
+        prev[voice] = NO_VOICE;
+        next[voice] = NO_VOICE;
+    }
+};
@@ -0,0 +1,96 @@
+#include <math.h>
+#include "wavetable.h"
+
+// Harmonic h of a table played with phase_inc is at h * phase_inc / 2^16 cells per sample,
+// it aliases above half a cycle per sample: h * phase_inc > 2^16 * CELLS / 2
+static const uint32_t NYQUIST_PHASE = (1UL << 16) * WavetableBank::CELLS / 2;
+
+static void synthesize(int8_t* out, const float* cos_coef, const float* sin_coef,
+                       size_t harmonics, const float* sine) {
+    const size_t N = WavetableBank::CELLS;
+    float acc[N];
+    float peak = 0;
+
+    for (size_t n = 0; n < N; n++) {
+        float v = 0;
+        for (size_t h = 1; h <= harmonics; h++) {
+            size_t idx = (h * n) % N;
+            v += sin_coef[h] * sine[idx] + cos_coef[h] * sine[(idx + N / 4) % N];
+        }
+        acc[n] = v;
+        if (fabsf(v) > peak) peak = fabsf(v);
+    }
+
+    float scale = peak > 0 ? 127.0f / peak : 0;
+    for (size_t n = 0; n < N; n++) {
+        out[n] = (int8_t)lroundf(acc[n] * scale);
+    }
+}
+
+void WavetableBank::begin(const int8_t* chebyshev) {
+    const size_t N = CELLS;
+    static float sine[N];
+    static float cos_coef[MAX_HARMONICS + 1];
+    static float sin_coef[MAX_HARMONICS + 1];
+
+    for (size_t n = 0; n < N; n++) {
+        sine[n] = sinf(2.0f * (float)M_PI * n / N);
+    }
+
+    for (int w = 0; w < WaveCount; w++) {
+        for (size_t h = 0; h <= MAX_HARMONICS; h++) {
+            cos_coef[h] = 0;
+            sin_coef[h] = 0;
+
+            switch (w) {
+                case WaveSine:
+                    if (h == 1) sin_coef[h] = 1;
+                    break;
+                case WaveTriangle:
+                    if (h % 2 == 1) sin_coef[h] = ((h / 2) % 2 ? -1.0f : 1.0f) / (float)(h * h);
+                    break;
+                case WaveSaw:
+                    if (h > 0) sin_coef[h] = 1.0f / h;
+                    break;
+                case WaveSquare:
+                    if (h % 2 == 1) sin_coef[h] = 1.0f / h;
+                    break;
+                case WaveChebyshev:
+                    // Fourier series of the Mozzi table, DC is dropped
+                    if (h > 0) {
+                        for (size_t n = 0; n < N; n++) {
+                            size_t idx = (h * n) % N;
+                            sin_coef[h] += chebyshev[n] * sine[idx];
+                            cos_coef[h] += chebyshev[n] * sine[(idx + N / 4) % N];
+                        }
+                        sin_coef[h] *= 2.0f / N;
+                        cos_coef[h] *= 2.0f / N;
+                    }
+                    break;
+            }
+        }
+
+        for (size_t level = 0; level < LEVELS; level++) {
+            synthesize(tables[w][level], cos_coef, sin_coef, MAX_HARMONICS >> level, sine);
+        }
+    }
+}
+
+const int8_t* WavetableBank::get(Waveform wave, uint32_t phase_inc) const {
+    size_t level = 0;
+    while (level < LEVELS - 1 && (uint64_t)(MAX_HARMONICS >> level) * phase_inc > NYQUIST_PHASE) {
+        level++;
+    }
+    return tables[wave][level];
+}
+
+const char* WavetableBank::get_name(Waveform wave) {
+    switch (wave) {
+        case WaveSine:      return "sine";
+        case WaveTriangle:  return "triangle";
+        case WaveSaw:       return "saw";
+        case WaveSquare:    return "square";
+        case WaveChebyshev: return "chebyshev";
+        default: return "unknown";
+    }
+}
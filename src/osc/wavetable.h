@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+enum Waveform {
+    WaveSine,
+    WaveTriangle,
+    WaveSaw,
+    WaveSquare,
+    WaveChebyshev,
+    WaveCount
+};
+
+// Band-limited single cycle tables, one mip level per octave.
+// Level k holds at most MAX_HARMONICS >> k harmonics.
+struct WavetableBank
+{
+    static const size_t CELLS = 256;
+    static const size_t LEVELS = 8;
+    static const size_t MAX_HARMONICS = CELLS / 2;
+
+    int8_t tables[WaveCount][LEVELS][CELLS];
+
+    // Generates all tables, chebyshev is the CELLS long Mozzi waveshape table
+    void begin(const int8_t* chebyshev);
+
+    // phase_inc is the Oscil phase increment with 16 fractional bits,
+    // returns the richest table that does not alias at this pitch
+    const int8_t* get(Waveform wave, uint32_t phase_inc) const;
+
+    static const char* get_name(Waveform wave);
+};
@@ -237,14 +237,14 @@ void OscilloscopeRoot::enter() {
     display->clearDisplay();
     
     drawGraph();
-    display->display();
+    show();
 }
 
 void OscilloscopeRoot::exit() {
     sigscoper.stop();
 
     display->clearDisplay();
-    display->display();
+    show();
 }
 
 void OscilloscopeRoot::update(Event* event) {
@@ -314,5 +314,5 @@ void OscilloscopeRoot::update(Event* event) {
     }
 
     // Update display after handling events
-    display->display();
+    show();
 }
\ No newline at end of file
@@ -15,6 +15,7 @@ public:
     void enter() override;
     void exit() override;
     void update(Event* event) override;
+    uint32_t get_refresh_ms() override { return UI_FRAME_MS; } // The trace moves on its own
 
 private:
     // Buffer size for drawing on screen
@@ -1,5 +1,7 @@
 #include "screen_switcher.h"
 
+uint32_t ScreenInterface::frame_count = 0;
+
 ScreenSwitcher::ScreenSwitcher()
     : screens(nullptr), screen_count(0), current_index(0) {
 }
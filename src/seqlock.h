@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+
+// One writer publishes whole copies of T, readers never wait for a lock.
+// The version is odd while a copy is being written, readers retry until
+// they got a copy with the same even version before and after, so they
+// always see one write complete and never a mix of two.
+// Writers must be serialized by the owner. T must be copied with memcpy only.
+template <typename T>
+struct Seqlock
+{
+    T value;
+    std::atomic<uint32_t> version;
+
+    Seqlock() : version(0) {
+        memset(&value, 0, sizeof(value));
+    }
+
+    void write(const T& data) {
+        uint32_t v = version.load(std::memory_order_relaxed);
+        version.store(v + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        memcpy(&value, &data, sizeof(value));
+        version.store(v + 2, std::memory_order_release);
+    }
+
+    // Copies the value into *out only if its version differs from *known_version.
+    // Returns true if *out was updated.
+    bool read(T* out, uint32_t* known_version) const {
+        uint32_t v1 = version.load(std::memory_order_acquire);
+        if (v1 == *known_version) {
+            return false;
+        }
+
+        for (;;) {
+            // Writer is in progress, wait for it to finish
+            while (v1 & 1) {
+                v1 = version.load(std::memory_order_acquire);
+            }
+            memcpy(out, &value, sizeof(*out));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            uint32_t v2 = version.load(std::memory_order_relaxed);
+            if (v1 == v2) break;
+            v1 = v2;
+        }
+
+        *known_version = v1;
+        return true;
+    }
+
+    uint32_t get_version(void) const { return version.load(std::memory_order_acquire); }
+};
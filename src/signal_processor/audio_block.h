@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Stereo audio rendered N frames at a time and played back one frame per call.
+// Which channels play the block is latched when it is rendered, so a channel
+// switches between rendered audio and its own value only on a block boundary.
+template <size_t N>
+struct AudioBlock
+{
+    typedef void (*RenderCallback)(int16_t* left, int16_t* right, size_t frames);
+
+    int16_t samples[2][N]; // Zero-centered MOZZI_AUDIO_BITS samples
+    bool enabled[2];       // Channels playing the block
+    size_t pos;
+
+    AudioBlock() : enabled{false, false}, pos(N) {}
+
+    bool is_played(void) const { return pos >= N; }
+
+    // Starts the next block, renders it if a channel plays it.
+    // Returns true if callback was called.
+    bool render(RenderCallback callback, const bool channel_enabled[2]) {
+        enabled[0] = channel_enabled[0];
+        enabled[1] = channel_enabled[1];
+        pos = 0;
+
+        if (callback != nullptr && (enabled[0] || enabled[1])) {
+            callback(samples[0], samples[1], N);
+            return true;
+        }
+        enabled[0] = false;
+        enabled[1] = false;
+        return false;
+    }
+
+    // Next frame of the block, channels that do not play it keep their value
+    void next(int* left, int* right) {
+        size_t n = pos++;
+        if (enabled[0]) *left = samples[0][n];
+        if (enabled[1]) *right = samples[1][n];
+    }
+};
@@ -1,5 +1,5 @@
-#include <MIDI.h>
 #include "signal_processor.h"
+#include <esp_timer.h>
 
 #include <Mozzi.h>
 #if(MOZZI_AUDIO_BITS != PWM_RESOLUTION)
@@ -8,71 +8,32 @@
 
 #include "../osc/osc.h"
 
-// MIDI interface
-MIDI_CREATE_INSTANCE(HardwareSerial, Serial2, MIDI);
-
-static SignalProcessor* processor = nullptr;
-
-void handle_note_on(uint8_t channel, uint8_t note, uint8_t velocity) {
-    processor->handle_note_on(channel, note, velocity);
-}
-
-void handle_note_off(uint8_t channel, uint8_t note, uint8_t velocity) {
-    processor->handle_note_off(channel, note, velocity);
-}
-
-void handle_cc(uint8_t channel, uint8_t cc, uint8_t value) {
-    processor->handle_cc(channel, cc, value);
-}
-
-void handle_aftertouch(uint8_t channel, uint8_t value) {
-    processor->handle_aftertouch(channel, value);
-}
-
-void handle_pitchbend(uint8_t channel, int value) {
-    processor->handle_pitchbend(channel, value);
-}
-
-void handle_clock(void) {
-    processor->handle_clock();
-}
-
-void handle_start(void) {
-    processor->handle_start();
-}
-
-void handle_stop(void) {
-    processor->handle_stop();
-}
-
 SignalProcessor::SignalProcessor(MidiSettingsState* state)
     : state(state) {
 
-    processor = this;
-
     // Initialize PWM using new ESP32 Arduino 3.0 API
     ledcAttach(OUT_CHANNELS[OutChannelA].pin, PWM_FREQ, PWM_RESOLUTION);
     ledcAttach(OUT_CHANNELS[OutChannelB].pin, PWM_FREQ, PWM_RESOLUTION);
     ledcAttach(OUT_CHANNELS[OutChannelC].pin, PWM_FREQ, PWM_RESOLUTION);
 
+    pinMode(SYNC_OUT, OUTPUT);
+    digitalWrite(SYNC_OUT, LOW);
+
     // Initialize MIDI
     Serial2.begin(MIDI_BAUDRATE, SERIAL_8N1, MIDI_RX_PIN, MIDI_TX_PIN);
-    MIDI.begin(MIDI_CHANNEL_OMNI);
-
-    MIDI.setHandleNoteOn(::handle_note_on);
-    MIDI.setHandleNoteOff(::handle_note_off);
-    MIDI.setHandleControlChange(::handle_cc);
-    MIDI.setHandleAfterTouchChannel(::handle_aftertouch);
-    MIDI.setHandlePitchBend(::handle_pitchbend);
-    MIDI.setHandleClock(::handle_clock);
-    MIDI.setHandleStart(::handle_start);
-    MIDI.setHandleStop(::handle_stop);
 
     // Initialize task handle to nullptr
     midi_task_handle = nullptr;
 
+    controller_flush_tick = 0;
+
+    // Odd version never matches a published one, forces the first refresh
+    settings_version = 1;
+
     for(size_t i = 0; i < OutChannelCount; i++) {
         last_out[i] = 0;
+        output_type[i] = MidiOutGate;
+        output_channel[i] = MidiChannelAll;
     }
 
     // Initialize pitchbend to center (0 = no bend)
@@ -82,40 +43,76 @@ SignalProcessor::SignalProcessor(MidiSettingsState* state)
     }
 
     // Initialize clock measurement
-    clock_last_time = 0;
     clock_tick_count = 0;
-    clock_measurement_start = 0;
-    internal_clock_last_tick_time = 0;
+    clock_lost = false;
+    clock_source = MidiClkInt;
+    run_gates = false;
+    outputs_applied = false;
+
+    clock_timer = nullptr;
+    clock_lock = portMUX_INITIALIZER_UNLOCKED;
+    clock_kicked = false;
+    clock_events_seen = 0;
+    clock_tx_enabled = false;
+    clock_tx_pending = 0;
     
     // Initialize Mozzi arrays
     for(size_t i = 0; i < 2; i++) {
         osc_enabled[i] = false;
         mozzi_out[i] = 0;
     }
+    rendered_blocks = 0;
     
     // Initialize callbacks
-    update_audio_callback = nullptr;
+    render_audio_callback = nullptr;
     event_callback = nullptr;
 }
 
 void SignalProcessor::begin(void) {
-    // Create MIDI task on second core
+    esp_timer_create_args_t timer_args = {};
+    timer_args.callback = clock_timer_callback;
+    timer_args.arg = this;
+    timer_args.dispatch_method = ESP_TIMER_TASK;
+    timer_args.name = "clock";
+    if (esp_timer_create(&timer_args, &clock_timer) != ESP_OK) {
+        Serial.printf("Failed to create clock timer\n");
+        clock_timer = nullptr;
+    }
+
+    uint64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&clock_lock);
+    clock_engine.reset(now);
+    portEXIT_CRITICAL(&clock_lock);
+
+    midi_output.begin(&Serial2);
+
+    refresh_settings();
+
+    midi_input.begin(&Serial2, &midi_output);
+    sync_input.begin(SYNC_IN);
+
+    // Create MIDI task on the audio core
     xTaskCreatePinnedToCore(
         midi_task,
         "MIDI_Task",
         4096,
         this,
-        1,
+        AUDIO_TASK_PRIORITY,
         &midi_task_handle,
-        1  // Core 1 (second core)
+        AUDIO_TASK_CORE
     );
 }
 
 static SignalProcessor* signal_processor = nullptr;
 
 void updateControl() {
-    MIDI.read();
     if (signal_processor != nullptr) {
+        if (DEBUG_TASK_LOAD) signal_processor->task_load.begin();
+        signal_processor->refresh_settings();
+        if (++signal_processor->controller_flush_tick >= MIDI_CONTROLLER_FLUSH_TICKS) {
+            signal_processor->controller_flush_tick = 0;
+            signal_processor->flush_midi_controllers();
+        }
         signal_processor->clock_routine();
         // Update osc_enabled based on output types
         for (size_t i = 0; i < OutChannelCount; i++) {
@@ -123,7 +120,7 @@ void updateControl() {
                 int mozzi_ch = OUT_CHANNELS[i].pin; // pin contains mozzi channel index (0 or 1)
                 if (mozzi_ch >= 0 && mozzi_ch < 2) {
                     signal_processor->osc_enabled[mozzi_ch] = 
-                        (signal_processor->state->get_midi_out_type(i) == MidiOutType::MidiOutMozzi);
+                        (signal_processor->routing.action[i] == MidiRouting::ActionMozzi);
                 }
             }
         }
@@ -133,6 +130,17 @@ void updateControl() {
             ProcessorEvent event = {};
             signal_processor->event_callback(EventControl, event);
         }
+
+        if (DEBUG_TASK_LOAD) signal_processor->task_load.end();
+    }
+}
+
+void SignalProcessor::render_audio_block(void) {
+    // Calls render_audio callback if any channel has osc enabled
+    if (DEBUG_TASK_LOAD) render_load.begin();
+    if (audio_block.render(render_audio_callback, osc_enabled) && DEBUG_TASK_LOAD) {
+        render_load.end();
+        rendered_blocks++;
     }
 }
 
@@ -140,32 +148,18 @@ AudioOutput updateAudio() {
     if (signal_processor == nullptr) {
         return StereoOutput::from8Bit(0, 0);
     }
-    
-    AudioOutputStorage_t left_val, right_val;
-    AudioOutput cb_output = StereoOutput::from8Bit(0, 0);
 
-    // Call update_audio callback if any channel has osc enabled
-    if (signal_processor->update_audio_callback != nullptr && 
-        (signal_processor->osc_enabled[0] || signal_processor->osc_enabled[1])) {
-        cb_output = signal_processor->update_audio_callback();
+    if (signal_processor->audio_block.is_played()) {
+        if (DEBUG_TASK_LOAD) signal_processor->task_load.begin();
+        signal_processor->render_audio_block();
+        if (DEBUG_TASK_LOAD) signal_processor->task_load.end();
     }
 
-    // Left channel (index 0)
-    if (signal_processor->osc_enabled[0]) {
-        left_val = cb_output.l();
-    } else {
-        // mozzi_out contains zero-centered values, use directly
-        left_val = signal_processor->mozzi_out[0];
-    }
-    
-    // Right channel (index 1)
-    if (signal_processor->osc_enabled[1]) {
-        right_val = cb_output.r();
-    } else {
-        // mozzi_out contains zero-centered values, use directly
-        right_val = signal_processor->mozzi_out[1];
-    }
-    
+    // mozzi_out contains zero-centered values, channels without osc use them directly
+    int left_val = signal_processor->mozzi_out[0];
+    int right_val = signal_processor->mozzi_out[1];
+    signal_processor->audio_block.next(&left_val, &right_val);
+
     return StereoOutput(left_val, right_val);
 }
 
@@ -174,79 +168,369 @@ void SignalProcessor::midi_task(void* parameter) {
 
     startMozzi();
 
-    for (size_t i = 0; i < OutChannelCount; i++) {
-        if (signal_processor->state->get_midi_out_type(i) == MidiOutType::MidiOutStop) {
-            signal_processor->out_gate(i, 255);
-            signal_processor->last_out[i] = 255;
-        }
+    for (uint8_t mask = signal_processor->routing.stop_mask; mask != 0; mask &= mask - 1) {
+        int i = __builtin_ctz(mask);
+        signal_processor->out_gate(i, 255);
+        signal_processor->last_out[i] = 255;
     }
     
     while (true) {
         audioHook();
+        // Drained between audio samples, so messages are handled within microseconds of arrival
+        signal_processor->process_midi();
+        signal_processor->process_sync();
     }
 }
 
-void SignalProcessor::clock_routine(void) {
-    unsigned long current_time = millis();
-    
-    // Generate internal clock ticks if MidiClkInt
-    if (state->get_midi_clk_type() == MidiClkType::MidiClkInt) {
-        int bpm = state->get_bpm();
-        if (bpm > 0) {
-            // Calculate tick interval: (60 seconds * 1000 ms) / (bpm * 24 ticks per beat)
-            unsigned long tick_interval_ms = (60 * 1000) / (bpm * CLOCK_TICKS_PER_BEAT);
-            
-            if (internal_clock_last_tick_time == 0) {
-                // Initialize on first call
-                internal_clock_last_tick_time = current_time;
-                clock_measurement_start = current_time;
-                clock_tick_count = 0;
-            } else {
-                // Check if enough time has passed for next tick
-                if (current_time - internal_clock_last_tick_time >= tick_interval_ms) {
-                    internal_clock_last_tick_time = current_time;
-                    clock_tick_count++;
-                    
-                    // Call EventClock callback for internal clock
-                    if (event_callback != nullptr) {
-                        ProcessorEvent event = {};
-                        event_callback(EventClock, event);
-                    }
-                    
-                    // Reset clock_tick_count every CLOCK_TICKS_PER_BEAT ticks (one beat)
-                    if (clock_tick_count >= CLOCK_TICKS_PER_BEAT) {
-                        clock_tick_count = 0;
-                        clock_measurement_start = current_time;
-                    }
-                }
+void SignalProcessor::process_midi(void) {
+    MidiMessage message;
+    while (midi_input.read(&message)) {
+        if (midi_coalescer.push(message)) {
+            continue;
+        }
+
+        // Notes must see the controller values sent before them
+        if (message.is_channel_message()) {
+            MidiMessage pending;
+            while (midi_coalescer.pop_channel(message.get_channel(), &pending)) {
+                handle_message(pending);
             }
         }
+
+        handle_message(message);
     }
-    
-    // Update all clock outputs based on current clock_tick_count
-    for (int i = 0; i < OutChannelCount; i++) {
-        MidiOutType type = state->get_midi_out_type(i);
-        if (state->is_clock_type(type)) {
-            int division_ticks = state->get_clock_division_ticks(type);
-            if (division_ticks > 0) {
-                // Calculate pulse duration: half of period, but not more than MAX_CLOCK_TICK_DURATION
-                int pulse_duration = division_ticks / 2;
-                if (pulse_duration > MAX_CLOCK_TICK_DURATION) {
-                    pulse_duration = MAX_CLOCK_TICK_DURATION;
-                }
-                
-                // Check if gate should be high based on current clock_tick_count
-                int phase = clock_tick_count % division_ticks;
-                bool should_be_high = phase < pulse_duration;
-                
-                // Update gate state if needed
-                uint8_t target_value = should_be_high ? 255 : 0;
-                if (last_out[i] != target_value) {
-                    out_gate(i, target_value);
-                    last_out[i] = target_value;
-                }
+}
+
+void SignalProcessor::process_sync(void) {
+    bool sync = MidiSettingsState::get_sync_ppqn(settings.midi_clk_type) > 0;
+
+    // Edges are always drained, so switching to a sync clock never sees stale ones
+    uint32_t time_us;
+    while (sync_input.read(&time_us)) {
+        if (sync) {
+            sync_clock.edge(to_timer_us(time_us));
+        }
+    }
+    if (!sync) return;
+
+    uint64_t tick_us;
+    bool on_edge;
+    uint64_t now = esp_timer_get_time();
+    while (sync_clock.poll(now, &tick_us, &on_edge)) {
+        // Interpolated and catch up ticks are not measurements, the tempo follows the edges
+        external_clock_tick(tick_us, on_edge ? sync_clock.get_ticks_per_edge() : 0);
+    }
+}
+
+void SignalProcessor::flush_midi_controllers(void) {
+    MidiMessage message;
+    while (midi_coalescer.pop(&message)) {
+        handle_message(message);
+    }
+}
+
+void SignalProcessor::handle_message(const MidiMessage& message) {
+    if(DEBUG_MIDI_PROCESSOR) {
+        uint32_t latency = (uint32_t)esp_timer_get_time() - message.time_us;
+        Serial.printf("handle_message: %02x, %lu us\n", message.status, (unsigned long)latency);
+    }
+
+    uint8_t channel = message.get_channel();
+
+    switch (message.get_type()) {
+        case 0x80:
+            handle_note_off(channel, message.data1, message.data2);
+            break;
+        case 0x90:
+            handle_note_on(channel, message.data1, message.data2);
+            break;
+        case 0xB0:
+            handle_cc(channel, message.data1, message.data2);
+            break;
+        case 0xD0:
+            handle_aftertouch(channel, message.data1);
+            break;
+        case 0xE0:
+            // 14 bit value, centered at 0
+            handle_pitchbend(channel, ((message.data2 << 7) | message.data1) - 8192);
+            break;
+        case 0xC0:
+            handle_program_change(channel, message.data1);
+            break;
+        case 0xF8:
+            handle_clock(message.time_us);
+            break;
+        case 0xFA:
+            handle_start();
+            break;
+        case 0xFB:
+            handle_continue();
+            break;
+        case 0xFC:
+            handle_stop();
+            break;
+        case 0xF2:
+            // 14 bit position in beats (16th notes), LSB first
+            handle_song_position((message.data2 << 7) | message.data1);
+            break;
+        default:
+            break;
+    }
+}
+
+void SignalProcessor::clock_routine(void) {
+    if (settings.midi_clk_type != MidiClkType::MidiClkInt && clock_pll.check_lost(esp_timer_get_time())) {
+        clock_lost = true;
+        sync_clock.reset();
+        portENTER_CRITICAL(&clock_lock);
+        clock_engine.external_lost();
+        portEXIT_CRITICAL(&clock_lock);
+    }
+
+    // Deliver clock events counted by the timer to the control thread
+    uint32_t events = clock_engine.get_tick_events();
+    uint32_t pending = events - clock_events_seen;
+    clock_events_seen = events;
+
+    if (event_callback == nullptr) return;
+    for (uint32_t i = 0; i < pending; i++) {
+        ProcessorEvent event = {};
+        event_callback(EventClock, event);
+    }
+}
+
+// A new settings snapshot, from the menus or a preset switch
+void SignalProcessor::apply_settings(void) {
+    uint8_t old_clock_mask = routing.clock_mask;
+    routing.compile(settings);
+
+    uint8_t changed = 0;
+    for (size_t i = 0; i < OutChannelCount; i++) {
+        MidiChannel channel = settings.midi_out_channel[i];
+        if (channel == MidiChannelUnchanged) {
+            channel = settings.midi_channel;
+        }
+        if (settings.midi_out_type[i] != output_type[i] || channel != output_channel[i]) {
+            changed |= 1 << i;
+        }
+        output_type[i] = settings.midi_out_type[i];
+        output_channel[i] = channel;
+    }
+    if (!outputs_applied) {
+        // Outputs keep their boot state, midi_task sets the stop gates
+        changed = 0;
+        outputs_applied = true;
+    }
+
+    // Outputs the clock engine takes over start low, it raises them with their next pulse
+    for (uint8_t mask = changed & routing.clock_mask & ~old_clock_mask; mask != 0; mask &= mask - 1) {
+        int i = __builtin_ctz(mask);
+        out_gate(i, 0);
+        last_out[i] = 0;
+    }
+
+    apply_clock_settings();
+
+    // The engine lets go of former clock outputs above, so they are written after it
+    for (uint8_t mask = changed & ~routing.clock_mask; mask != 0; mask &= mask - 1) {
+        evaluate_output(__builtin_ctz(mask));
+    }
+}
+
+// First channel of the output that has notes held, 0 if none
+uint8_t SignalProcessor::get_held_channel(size_t idx) {
+    for (uint8_t ch = MidiChannel1; ch <= MidiChannel16; ch++) {
+        if (MidiRouting::is_channel_match(settings, idx, ch) && !note_history[ch].is_empty()) {
+            return ch;
+        }
+    }
+    return 0;
+}
+
+// Sets an output to what its current setup implies, so no gate or CV of the previous one is left
+void SignalProcessor::evaluate_output(size_t idx) {
+    uint8_t channel = get_held_channel(idx);
+    uint8_t value = 0;
+
+    switch (routing.action[idx]) {
+        case MidiRouting::ActionGate:
+            value = (channel != 0) ? 127 : 0;
+            out_gate(idx, value);
+            break;
+        case MidiRouting::ActionPitch:
+            // Without held notes the CV keeps its last note, as after a note off
+            if (channel != 0) {
+                value = get_priority_note(channel, settings.note_priority[idx]);
+                out_pitch(idx, value, pitchbend[channel]);
+                last_out[idx] = value;
             }
+            return;
+        case MidiRouting::ActionRun:
+            value = run_gates ? 255 : 0;
+            out_gate(idx, value);
+            break;
+        case MidiRouting::ActionStop:
+            value = run_gates ? 0 : 255;
+            out_gate(idx, value);
+            break;
+        case MidiRouting::ActionMozzi:
+            // Played by the oscillator, enabled from updateControl()
+            return;
+        default:
+            // Velocity, aftertouch and controllers wait for their next message
+            out_gate(idx, 0);
+            break;
+    }
+    last_out[idx] = value;
+}
+
+void SignalProcessor::apply_clock_settings(void) {
+    uint64_t now = esp_timer_get_time();
+    bool internal = settings.midi_clk_type == MidiClkType::MidiClkInt;
+    bool thru = settings.midi_tx_type == MidiTxThru || settings.midi_tx_type == MidiTxClockThru;
+    bool clock_tx = internal && (settings.midi_tx_type == MidiTxClock || settings.midi_tx_type == MidiTxClockThru);
+    bool clock_tx_started = clock_tx && !clock_tx_enabled;
+    bool clock_tx_stopped = !clock_tx && clock_tx_enabled;
+
+    portENTER_CRITICAL(&clock_lock);
+    if (!internal && settings.midi_clk_type != clock_source) {
+        // A new external source starts from scratch
+        clock_pll.reset();
+        clock_engine.reset(now);
+        clock_tick_count = 0;
+        song_position.reset();
+        sync_clock.reset();
+    }
+    clock_source = settings.midi_clk_type;
+    int sync_ppqn = MidiSettingsState::get_sync_ppqn(settings.midi_clk_type);
+    if (sync_ppqn > 0) {
+        sync_clock.set_ppqn(sync_ppqn);
+    }
+    clock_engine.set_internal(internal, now);
+    if (internal) {
+        // External tempo comes from clock_pll
+        clock_engine.set_bpm(settings.bpm);
+    }
+    for (size_t i = 0; i < OutChannelCount; i++) {
+        if (!(routing.clock_mask & (1u << i))) {
+            clock_engine.set_output(i, 0, 0, 0, 0);
+            continue;
+        }
+
+        const ClockRatio& ratio = settings.clock_ratio[i];
+        uint8_t phase = (settings.midi_out_type[i] == MidiOutClockRatio) ? ratio.phase : 0;
+        uint32_t offset = ClockEngine::get_period_units(routing.clock_div[i]) * phase / 100;
+        clock_engine.set_output(i, routing.clock_mul[i], routing.clock_div[i], offset, ratio.pulse_ms * 1000);
+    }
+    clock_engine.set_output(SYNC_OUT_INDEX, ClockEngine::PPQN, 1, 0, SYNC_OUT_PULSE_US);
+    if (clock_tx_started) {
+        // Downstream gear starts counting from our next tick, so do the outputs.
+        // Set under the lock so clock_timer sends Start with exactly that tick.
+        clock_engine.reset(now);
+        clock_tx_pending = 0xFA;
+        clock_tx_enabled = true;
+    }
+    portEXIT_CRITICAL(&clock_lock);
+
+    // Only one clock master downstream: received timing is dropped while ours is sent
+    midi_output.set_mode(thru, clock_tx);
+    if (clock_tx_stopped) {
+        clock_tx_enabled = false;
+        clock_tx_pending = 0;
+        midi_output.set_next_realtime_us(MidiMerger::NO_EVENT);
+        midi_output.send_realtime(0xFC);
+    }
+
+    kick_clock();
+}
+
+void SignalProcessor::queue_clock_tx(uint8_t status) {
+    if (!clock_tx_enabled) return;
+
+    uint64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&clock_lock);
+    if (status == 0xFA) {
+        // Start restarts the internal clock, the next tick is tick 0
+        clock_engine.reset(now);
+    }
+    clock_tx_pending = status;
+    portEXIT_CRITICAL(&clock_lock);
+    kick_clock();
+}
+
+void SignalProcessor::send_clock_tx(uint32_t ticks, uint64_t next_tick_us) {
+    for (uint32_t i = 0; i < ticks; i++) {
+        uint8_t status = clock_tx_pending.exchange(0);
+        if (status != 0) {
+            midi_output.send_realtime(status);
         }
+        midi_output.send_realtime(0xF8);
+    }
+    midi_output.set_next_realtime_us(next_tick_us);
+}
+
+void SignalProcessor::kick_clock(void) {
+    if (clock_timer == nullptr) return;
+
+    // Set before arming, the callback re-arms if it missed this kick
+    clock_kicked = true;
+    esp_timer_stop(clock_timer);
+    esp_timer_start_once(clock_timer, 0);
+}
+
+void SignalProcessor::clock_timer_callback(void* parameter) {
+    SignalProcessor* self = static_cast<SignalProcessor*>(parameter);
+    self->clock_kicked = false;
+
+    uint64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&self->clock_lock);
+    uint32_t tick_events = self->clock_engine.get_tick_events();
+    uint32_t changed = self->clock_engine.update(now);
+    uint32_t gates = self->clock_engine.get_gate_mask();
+    uint64_t next = self->clock_engine.get_next_event_us();
+    uint32_t ticks = self->clock_engine.get_tick_events() - tick_events;
+    uint64_t next_tick = self->clock_engine.get_next_tick_us();
+    portEXIT_CRITICAL(&self->clock_lock);
+
+    // Chained modules and MIDI clock first, the gates are not delayed by a UART write
+    if (changed & (1u << SYNC_OUT_INDEX)) {
+        digitalWrite(SYNC_OUT, (gates & (1u << SYNC_OUT_INDEX)) ? HIGH : LOW);
+        changed &= ~(1u << SYNC_OUT_INDEX);
+    }
+    if (self->clock_tx_enabled) {
+        self->send_clock_tx(ticks, next_tick);
+    }
+
+    for (uint32_t mask = changed; mask != 0; mask &= mask - 1) {
+        int i = __builtin_ctz(mask);
+        uint8_t value = (gates & (1u << i)) ? 255 : 0;
+        self->out_gate(i, value);
+        self->last_out[i] = value;
+    }
+
+    if (next != ClockEngine::NO_EVENT) {
+        esp_timer_stop(self->clock_timer);
+        esp_timer_start_once(self->clock_timer, next > now ? next - now : 0);
+    }
+
+    if (self->clock_kicked) {
+        esp_timer_stop(self->clock_timer);
+        esp_timer_start_once(self->clock_timer, 0);
+    }
+}
+
+uint64_t SignalProcessor::to_timer_us(uint32_t time_us) {
+    // Message timestamps are the low 32 bits of esp_timer_get_time()
+    uint64_t now = esp_timer_get_time();
+    return now - (uint32_t)((uint32_t)now - time_us);
+}
+
+uint8_t SignalProcessor::get_priority_note(uint8_t channel, NotePriority priority) {
+    switch (priority) {
+        case NotePriorityLast:   return note_history[channel].get_last();
+        case NotePriorityLowest: return note_history[channel].get_lowest();
+        default:                 return note_history[channel].get_highest();
     }
 }
 
@@ -351,35 +635,44 @@ void SignalProcessor::handle_note_on(uint8_t channel, uint8_t note, uint8_t velo
     uint8_t note_id;
     if (!note_history[channel].push(note, &note_id)) {
         // Note already in use. Skipping.
+        if(DEBUG_MIDI_PROCESSOR) Serial.println("  push FAILED: note already in use");
         return;
     }
 
-    for (int i = 0; i < OutChannelCount; i++) {
-        if (!is_out_channel_match(i, channel)) continue;
+    for (uint8_t mask = routing.note_mask[channel]; mask != 0; mask &= mask - 1) {
+        int i = __builtin_ctz(mask);
 
-        MidiOutType type = state->get_midi_out_type(i);
-        if (type == MidiOutType::MidiOutGate) {
-            out_gate(i, velocity);
-            last_out[i] = velocity;
-        } else if (type == MidiOutType::MidiOutPitch) {
-            out_pitch(i, note, pitchbend[channel]);
-            last_out[i] = note;
-        } else if (type == MidiOutType::MidiOutVelocity) {
-            out_7bit_value(i, velocity);
-            last_out[i] = velocity;
-        }
-        
-        // Call EventNoteOn callback for OutTypeMozzi channels
-        if (event_callback != nullptr && OUT_CHANNELS[i].type == OutTypeMozzi && type == MidiOutType::MidiOutMozzi) {
-            int mozzi_ch = OUT_CHANNELS[i].pin; // pin contains mozzi channel index (0 or 1)
-            if (mozzi_ch >= 0 && mozzi_ch < 2) {
-                ProcessorEvent event = {};
-                event.note.channel = mozzi_ch;
-                event.note.note = note;
-                event.note.velocity = velocity;
-                event.note.id = note_id;
-                event_callback(EventNoteOn, event);
+        switch (routing.action[i]) {
+            case MidiRouting::ActionGate:
+                out_gate(i, velocity);
+                last_out[i] = velocity;
+                break;
+            case MidiRouting::ActionPitch: {
+                uint8_t pitch_note = get_priority_note(channel, settings.note_priority[i]);
+                out_pitch(i, pitch_note, pitchbend[channel]);
+                last_out[i] = pitch_note;
+                break;
             }
+            case MidiRouting::ActionVelocity:
+                out_7bit_value(i, velocity);
+                last_out[i] = velocity;
+                break;
+            case MidiRouting::ActionMozzi:
+                // Call EventNoteOn callback for OutTypeMozzi channels
+                if (event_callback != nullptr) {
+                    int mozzi_ch = OUT_CHANNELS[i].pin; // pin contains mozzi channel index (0 or 1)
+                    if (mozzi_ch >= 0 && mozzi_ch < 2) {
+                        ProcessorEvent event = {};
+                        event.note.channel = mozzi_ch;
+                        event.note.note = note;
+                        event.note.velocity = velocity;
+                        event.note.id = note_id;
+                        event_callback(EventNoteOn, event);
+                    }
+                }
+                break;
+            default:
+                break;
         }
     }
 }
@@ -390,46 +683,52 @@ void SignalProcessor::handle_note_off(uint8_t channel, uint8_t note, uint8_t vel
     uint8_t note_id;
     if (!note_history[channel].pop(note, &note_id)) {
         // Note not in use. Skipping.
+        if(DEBUG_MIDI_PROCESSOR) Serial.println("  pop FAILED: note not in use");
         return;
     }
 
-    uint8_t current_note = note_history[channel].get_current();
+    bool notes_held = !note_history[channel].is_empty();
 
-    for (int i = 0; i < OutChannelCount; i++) {
-        if (!is_out_channel_match(i, channel)) continue;
+    for (uint8_t mask = routing.note_mask[channel]; mask != 0; mask &= mask - 1) {
+        int i = __builtin_ctz(mask);
 
-        MidiOutType type = state->get_midi_out_type(i);
-        
-        if (current_note == NoteHistory::NO_NOTE) {
-            if (type == MidiOutType::MidiOutGate) {
-                out_gate(i, 0);
-                last_out[i] = 0;
-            }
-            if (type == MidiOutType::MidiOutVelocity) {
-                out_7bit_value(i, 0);
-                last_out[i] = 0;
-            }
-        }
-
-        if (type == MidiOutType::MidiOutPitch) {
-            // keep last note CV after note off, with pitchbend applied
-            if (current_note != NoteHistory::NO_NOTE) {
-                out_pitch(i, current_note, pitchbend[channel]);
-                last_out[i] = current_note;
-            }
-        }
-        
-        // Call EventNoteOff callback for OutTypeMozzi channels
-        if (event_callback != nullptr && OUT_CHANNELS[i].type == OutTypeMozzi && type == MidiOutType::MidiOutMozzi) {
-            int mozzi_ch = OUT_CHANNELS[i].pin; // pin contains mozzi channel index (0 or 1)
-            if (mozzi_ch >= 0 && mozzi_ch < 2) {
-                ProcessorEvent event = {};
-                event.note.channel = mozzi_ch;
-                event.note.note = note;
-                event.note.velocity = velocity;
-                event.note.id = note_id;
-                event_callback(EventNoteOff, event);
-            }
+        switch (routing.action[i]) {
+            case MidiRouting::ActionGate:
+                if (!notes_held) {
+                    out_gate(i, 0);
+                    last_out[i] = 0;
+                }
+                break;
+            case MidiRouting::ActionVelocity:
+                if (!notes_held) {
+                    out_7bit_value(i, 0);
+                    last_out[i] = 0;
+                }
+                break;
+            case MidiRouting::ActionPitch:
+                // keep last note CV after note off, with pitchbend applied
+                if (notes_held) {
+                    uint8_t current_note = get_priority_note(channel, settings.note_priority[i]);
+                    out_pitch(i, current_note, pitchbend[channel]);
+                    last_out[i] = current_note;
+                }
+                break;
+            case MidiRouting::ActionMozzi:
+                // Call EventNoteOff callback for OutTypeMozzi channels
+                if (event_callback != nullptr) {
+                    int mozzi_ch = OUT_CHANNELS[i].pin; // pin contains mozzi channel index (0 or 1)
+                    if (mozzi_ch >= 0 && mozzi_ch < 2) {
+                        ProcessorEvent event = {};
+                        event.note.channel = mozzi_ch;
+                        event.note.note = note;
+                        event.note.velocity = velocity;
+                        event.note.id = note_id;
+                        event_callback(EventNoteOff, event);
+                    }
+                }
+                break;
+            default:
+                break;
         }
     }
 }
@@ -438,18 +737,14 @@ void SignalProcessor::handle_cc(uint8_t channel, uint8_t cc, uint8_t value) {
     // Store last CC number for the channel
     last_cc[channel] = cc;
 
-    for (int i = 0; i < OutChannelCount; i++) {
-        if (!is_out_channel_match(i, channel)) continue;
+    for (uint8_t mask = routing.cc_mask[channel][cc & 0x7F]; mask != 0; mask &= mask - 1) {
+        int i = __builtin_ctz(mask);
 
-        MidiOutType type = state->get_midi_out_type(i);
-        
-        if (type == MidiOutType::MidiOutCc0 + cc) {
+        if (routing.action[i] == MidiRouting::ActionCc) {
             out_7bit_value(i, value);
             last_out[i] = value;
-        }
-        
-        // Call EventCc callback for OutTypeMozzi channels
-        if (event_callback != nullptr && OUT_CHANNELS[i].type == OutTypeMozzi && type == MidiOutType::MidiOutMozzi) {
+        } else if (routing.action[i] == MidiRouting::ActionMozzi && event_callback != nullptr) {
+            // Call EventCc callback for OutTypeMozzi channels
             int mozzi_ch = OUT_CHANNELS[i].pin; // pin contains mozzi channel index (0 or 1)
             if (mozzi_ch >= 0 && mozzi_ch < 2) {
                 ProcessorEvent event = {};
@@ -463,18 +758,14 @@ void SignalProcessor::handle_cc(uint8_t channel, uint8_t cc, uint8_t value) {
 }
 
 void SignalProcessor::handle_aftertouch(uint8_t channel, uint8_t value) {
-    for (int i = 0; i < OutChannelCount; i++) {
-        if (!is_out_channel_match(i, channel)) continue;
+    for (uint8_t mask = routing.aftertouch_mask[channel]; mask != 0; mask &= mask - 1) {
+        int i = __builtin_ctz(mask);
 
-        MidiOutType type = state->get_midi_out_type(i);
-        
-        if (type == MidiOutType::MidiOutAfterTouch) {
+        if (routing.action[i] == MidiRouting::ActionAftertouch) {
             out_7bit_value(i, value);
             last_out[i] = value;
-        }
-        
-        // Call EventAftertouch callback for OutTypeMozzi channels
-        if (event_callback != nullptr && OUT_CHANNELS[i].type == OutTypeMozzi && type == MidiOutType::MidiOutMozzi) {
+        } else if (routing.action[i] == MidiRouting::ActionMozzi && event_callback != nullptr) {
+            // Call EventAftertouch callback for OutTypeMozzi channels
             int mozzi_ch = OUT_CHANNELS[i].pin; // pin contains mozzi channel index (0 or 1)
             if (mozzi_ch >= 0 && mozzi_ch < 2) {
                 ProcessorEvent event = {};
@@ -493,113 +784,141 @@ void SignalProcessor::handle_pitchbend(uint8_t channel, int value) {
     pitchbend[channel] = value;
 
     // For all outputs with MidiOutPitch type, update pitch with pitchbend applied
-    for (int i = 0; i < OutChannelCount; i++) {
-        if (!is_out_channel_match(i, channel)) continue;
-
-        MidiOutType type = state->get_midi_out_type(i);
-        
-        if (type == MidiOutType::MidiOutPitch) {
-            // Get current note from note history
-            uint8_t current_note = note_history[channel].get_current();
-            if (current_note != NoteHistory::NO_NOTE) {
-                out_pitch(i, current_note, value);
-            }
-        } else if (type == MidiOutType::MidiOutPitchBend) {
-            // Direct pitchbend output (for compatibility)
-            out_7bit_value(i, value >> 7); // Use upper 7 bits
-            last_out[i] = value >> 7;
-        }
-        
-        // Call EventPitchBend callback for OutTypeMozzi channels
-        if (event_callback != nullptr && OUT_CHANNELS[i].type == OutTypeMozzi && type == MidiOutType::MidiOutMozzi) {
-            int mozzi_ch = OUT_CHANNELS[i].pin; // pin contains mozzi channel index (0 or 1)
-            if (mozzi_ch >= 0 && mozzi_ch < 2) {
-                ProcessorEvent event = {};
-                event.pitchbend.channel = mozzi_ch;
-                event.pitchbend.value = value;
-                event_callback(EventPitchBend, event);
+    for (uint8_t mask = routing.pitchbend_mask[channel]; mask != 0; mask &= mask - 1) {
+        int i = __builtin_ctz(mask);
+
+        switch (routing.action[i]) {
+            case MidiRouting::ActionPitch: {
+                // Get current note from note history
+                uint8_t current_note = get_priority_note(channel, settings.note_priority[i]);
+                if (current_note != NoteHistory::NO_NOTE) {
+                    out_pitch(i, current_note, value);
+                }
+                break;
             }
+            case MidiRouting::ActionPitchBend:
+                // Direct pitchbend output (for compatibility)
+                out_7bit_value(i, value >> 7); // Use upper 7 bits
+                last_out[i] = value >> 7;
+                break;
+            case MidiRouting::ActionMozzi:
+                // Call EventPitchBend callback for OutTypeMozzi channels
+                if (event_callback != nullptr) {
+                    int mozzi_ch = OUT_CHANNELS[i].pin; // pin contains mozzi channel index (0 or 1)
+                    if (mozzi_ch >= 0 && mozzi_ch < 2) {
+                        ProcessorEvent event = {};
+                        event.pitchbend.channel = mozzi_ch;
+                        event.pitchbend.value = value;
+                        event_callback(EventPitchBend, event);
+                    }
+                }
+                break;
+            default:
+                break;
         }
     }
 }
 
-void SignalProcessor::handle_clock(void) {
-    if (state->get_midi_clk_type() != MidiClkType::MidiClkExt) return;
+void SignalProcessor::handle_program_change(uint8_t channel, uint8_t program) {
+    // Listens on the module channel of the active preset
+    if (settings.midi_channel != channel && settings.midi_channel != MidiChannelAll) return;
 
-    unsigned long current_time = millis();
-    
-    // Start measurement on first clock tick
-    if (clock_measurement_start == 0) {
-        clock_measurement_start = current_time;
+    // Switching takes state_mutex, which the UI and store tasks hold while they
+    // edit or snapshot the settings, so the settings task does it. Messages handled
+    // before the new preset is published still play the old one.
+    state->request_preset(program);
+}
+
+void SignalProcessor::handle_clock(uint32_t time_us) {
+    if (settings.midi_clk_type != MidiClkType::MidiClkExt) return;
+
+    external_clock_tick(to_timer_us(time_us), 1);
+}
+
+// A 24 PPQN tick from MIDI or SYNC_IN, measured_ticks is how many ticks the
+// tempo tracker is fed for it, 0 for ticks placed by SyncClock between edges
+void SignalProcessor::external_clock_tick(uint64_t arrival, uint32_t measured_ticks) {
+    uint64_t tick_time = arrival;
+    if (measured_ticks > 0) {
+        clock_pll.tick(arrival, measured_ticks);
+        tick_time = clock_pll.get_tick_time_us();
+    }
+    clock_lost = false;
+
+    // While stopped the song position holds, ticks only keep the tempo tracked
+    if (song_position.tick()) {
+        portENTER_CRITICAL(&clock_lock);
+        clock_engine.external_tick(arrival,
+                                   tick_time,
+                                   clock_pll.has_period() ? clock_pll.get_interval_q16() : 0,
+                                   clock_pll.is_locked());
+        portEXIT_CRITICAL(&clock_lock);
+        kick_clock();
+    }
+
+    // Publish the tracked tempo once per beat, only when the rounded value changes
+    if (++clock_tick_count >= CLOCK_TICKS_PER_BEAT) {
         clock_tick_count = 0;
-    }
-    
-    clock_tick_count++;
 
-    // Calculate BPM every CLOCK_TICKS_PER_BEAT ticks (one beat)
-    if (clock_tick_count >= CLOCK_TICKS_PER_BEAT) {
-        unsigned long elapsed_ms = current_time - clock_measurement_start;
-        
-        if (elapsed_ms > 0) {
-            // BPM = (60 seconds * 1000 ms/sec) / (elapsed_ms ms for one beat)
-            // elapsed_ms is already the time for CLOCK_TICKS_PER_BEAT ticks (one beat)
-            int bpm = (60 * 1000) / elapsed_ms;
-            
+        if (clock_pll.is_locked()) {
+            int bpm = (int)(clock_pll.get_bpm() + 0.5f);
+
             // Clamp to valid range
             if (bpm < state->get_min_bpm()) bpm = state->get_min_bpm();
             if (bpm > state->get_max_bpm()) bpm = state->get_max_bpm();
-            
-            state->set_bpm(bpm);
+
+            // Applied by the settings task, the audio task never waits on the settings mutex
+            if (bpm != settings.bpm) {
+                state->request_bpm(bpm);
+            }
         }
-        
-        // Reset for next measurement
-        clock_measurement_start = current_time;
-        clock_tick_count = 0;
-    }
-    
-    clock_last_time = current_time;
-    
-    // Call EventClock callback
-    if (event_callback != nullptr) {
-        ProcessorEvent event = {};
-        event_callback(EventClock, event);
     }
 }
 
-void SignalProcessor::handle_start(void) {
-    // Reset clock measurement on start (for external clock)
-    if (state->get_midi_clk_type() == MidiClkType::MidiClkExt) {
-        clock_measurement_start = 0;
-        clock_tick_count = 0;
-        
-        // Lower all clock outputs
-        for (size_t i = 0; i < OutChannelCount; i++) {
-            MidiOutType type = state->get_midi_out_type(i);
-            if (state->is_clock_type(type)) {
-                out_gate(i, 0);
-                last_out[i] = 0;
-            }
-        }
+float SignalProcessor::get_clock_bpm(void) {
+    if (settings.midi_clk_type != MidiClkType::MidiClkInt) {
+        return clock_pll.is_locked() ? clock_pll.get_bpm() : 0;
     }
+    return settings.bpm;
+}
+
+void SignalProcessor::locate_clock(uint32_t position) {
+    if (settings.midi_clk_type == MidiClkType::MidiClkInt) return;
+
+    // Lower all clock outputs, divisions restart in phase with the next tick
+    uint64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&clock_lock);
+    clock_engine.locate(position, now);
+    portEXIT_CRITICAL(&clock_lock);
+    kick_clock();
+}
+
+void SignalProcessor::set_run_gates(bool running) {
+    run_gates = running;
 
     // Handle MidiOutRun outputs
-    for (size_t i = 0; i < OutChannelCount; i++) {
-        MidiOutType type = state->get_midi_out_type(i);
-        if (type == MidiOutType::MidiOutRun) {
-            out_gate(i, 255);
-            last_out[i] = 255;
-        }
+    for (uint8_t mask = routing.run_mask; mask != 0; mask &= mask - 1) {
+        int i = __builtin_ctz(mask);
+        out_gate(i, running ? 255 : 0);
+        last_out[i] = running ? 255 : 0;
     }
 
     // Handle MidiOutStop outputs
-    for (size_t i = 0; i < OutChannelCount; i++) {
-        MidiOutType type = state->get_midi_out_type(i);
-        if (type == MidiOutType::MidiOutStop) {
-            out_gate(i, 0);
-            last_out[i] = 0;
-        }
+    for (uint8_t mask = routing.stop_mask; mask != 0; mask &= mask - 1) {
+        int i = __builtin_ctz(mask);
+        out_gate(i, running ? 0 : 255);
+        last_out[i] = running ? 0 : 255;
     }
-    
+}
+
+void SignalProcessor::handle_start(void) {
+    // Start plays from the top, the next clock is song position 0
+    clock_tick_count = 0;
+    song_position.start();
+    locate_clock(song_position.get_position());
+    queue_clock_tx(0xFA);
+    set_run_gates(true);
+
     // Call EventStart callback
     if (event_callback != nullptr) {
         ProcessorEvent event = {};
@@ -607,28 +926,47 @@ void SignalProcessor::handle_start(void) {
     }
 }
 
+void SignalProcessor::handle_continue(void) {
+    // Resume from the held or pointed song position. The engine may have
+    // predicted a tick past it before Stop arrived, locate drops that tick.
+    song_position.resume();
+    locate_clock(song_position.get_position());
+    queue_clock_tx(0xFB);
+    set_run_gates(true);
+
+    if (event_callback != nullptr) {
+        ProcessorEvent event = {};
+        event_callback(EventStart, event);
+    }
+}
+
+void SignalProcessor::handle_song_position(uint16_t beats) {
+    song_position.locate(beats);
+    clock_tick_count = song_position.get_position() % CLOCK_TICKS_PER_BEAT;
+    locate_clock(song_position.get_position());
+}
+
 void SignalProcessor::handle_stop(void) {
-    // Handle MidiOutStop outputs
-    for (size_t i = 0; i < OutChannelCount; i++) {
-        MidiOutType type = state->get_midi_out_type(i);
-        if (type == MidiOutType::MidiOutStop) {
-            out_gate(i, 255);
-            last_out[i] = 255;
-        }
+    song_position.stop();
+
+    // Do not run ahead of a stopped external clock
+    if (settings.midi_clk_type != MidiClkType::MidiClkInt) {
+        portENTER_CRITICAL(&clock_lock);
+        clock_engine.external_lost();
+        portEXIT_CRITICAL(&clock_lock);
     }
 
-    // Handle MidiOutRun outputs
-    for (size_t i = 0; i < OutChannelCount; i++) {
-        MidiOutType type = state->get_midi_out_type(i);
-        if (type == MidiOutType::MidiOutRun) {
-            out_gate(i, 0);
-            last_out[i] = 0;
-        }
+    // Stop is not tied to a tick, it goes out right away
+    if (clock_tx_enabled) {
+        clock_tx_pending = 0;
+        midi_output.send_realtime(0xFC);
     }
-    
+
+    set_run_gates(false);
+
     // Call EventStop callback
     if (event_callback != nullptr) {
         ProcessorEvent event = {};
         event_callback(EventStop, event);
     }
-}
\ No newline at end of file
+}
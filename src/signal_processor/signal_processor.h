@@ -2,8 +2,22 @@
 
 #include "../board.h"
 #include "../urack_types.h"
+#include "../task_load.h"
+#include "audio_block.h"
 #include "../midi/midi_settings_state.h"
 #include "../midi/note_history.h"
+#include "../midi/midi_routing.h"
+#include "../midi/midi_input.h"
+#include "../midi/midi_output.h"
+#include "../midi/midi_coalescer.h"
+#include "../clock/clock_engine.h"
+#include "../clock/clock_pll.h"
+#include "../clock/sync_clock.h"
+#include "../clock/song_position.h"
+#include "../clock/sync_input.h"
+
+#include <atomic>
+#include <esp_timer.h>
 
 #include <MozziConfigValues.h>
 #define MOZZI_AUDIO_MODE MOZZI_OUTPUT_PWM
@@ -14,10 +28,6 @@
 #define MOZZI_AUDIO_PIN_2 OUT_CHANNEL_B_PIN
 #define MOZZI_ANALOG_READ MOZZI_ANALOG_READ_NONE
 
-// Forward declaration for AudioOutput (defined in AudioOutput.h)
-struct StereoOutput;
-typedef StereoOutput AudioOutput;
-
 enum ProcessorEventType {
     EventControl,
     EventClock,
@@ -64,40 +74,83 @@ public:
     SignalProcessor(MidiSettingsState* state);
     MidiSettingsState* state;
 
+    // Local copy of the settings, refreshed once per control tick
+    MidiSettingsData settings;
+    uint32_t settings_version;
+    MidiRouting routing;
+
+    inline void refresh_settings(void) {
+        if (state->read_snapshot(&settings, &settings_version)) {
+            apply_settings();
+        }
+    }
+
     void begin(void);
+
+    // Timestamped messages from the MIDI UART, drained by process_midi()
+    MidiInput midi_input;
+    // Generated clock and thru of the received bytes on MIDI_TX_PIN
+    MidiOutput midi_output;
+    // Timestamped SYNC_IN edges, drained by process_sync()
+    SyncInput sync_input;
+    // Continuous controllers are held here and handled every MIDI_CONTROLLER_FLUSH_TICKS control ticks
+    MidiCoalescer midi_coalescer;
+    uint8_t controller_flush_tick;
+    void process_midi(void);
+    void process_sync(void);
+    void flush_midi_controllers(void);
+    void handle_message(const MidiMessage& message);
+
     void handle_note_on(uint8_t channel, uint8_t note, uint8_t velocity);
     void handle_note_off(uint8_t channel, uint8_t note, uint8_t velocity);
     void handle_cc(uint8_t channel, uint8_t cc, uint8_t value);
     void handle_aftertouch(uint8_t channel, uint8_t value);
     void handle_pitchbend(uint8_t channel, int value);
-    void handle_clock(void);
+    void handle_program_change(uint8_t channel, uint8_t program);
+    void handle_clock(uint32_t time_us);
     void handle_start(void);
+    void handle_continue(void);
     void handle_stop(void);
+    void handle_song_position(uint16_t beats);
     void clock_routine(void);
 
+    // Tempo in use: the tracked external tempo (0 until locked) or the internal setting
+    float get_clock_bpm(void);
+    bool is_clock_lost(void) const { return clock_lost; }
+
     void out_7bit_value(int pwm_ch, int value);
 
     uint8_t last_out[OutChannelCount];
     uint8_t last_cc[MIDI_CHANNEL_COUNT]; // Last CC number per channel
     int pitchbend[MIDI_CHANNEL_COUNT]; // Raw pitchbend value per channel
     
+    TaskLoad task_load; // Audio and control work of the MIDI task, see DEBUG_TASK_LOAD
+    TaskLoad render_load; // Cycles spent in render_audio_callback alone
+    volatile uint32_t rendered_blocks;
+
     bool osc_enabled[2]; // MOZZI_AUDIO_CHANNELS
     int mozzi_out[2]; // MOZZI_AUDIO_CHANNELS
+
+    // Oscillator audio is rendered in blocks and played back one sample per updateAudio()
+    static const size_t AUDIO_BLOCK_SIZE = 32;
+    AudioBlock<AUDIO_BLOCK_SIZE> audio_block; // MOZZI_AUDIO_CHANNELS, osc_enabled latched per block
+
+    void render_audio_block(void);
     
     // Callback function types
-    typedef AudioOutput (*UpdateAudioCallback)(void);
+    typedef void (*RenderAudioCallback)(int16_t* left, int16_t* right, size_t frames);
     typedef void (*EventCallback)(ProcessorEventType, ProcessorEvent);
     
     // Callback setters
-    void set_update_audio_callback(UpdateAudioCallback callback) {
-        update_audio_callback = callback;
+    void set_render_audio_callback(RenderAudioCallback callback) {
+        render_audio_callback = callback;
     }
     
     void set_event_callback(EventCallback callback) {
         event_callback = callback;
     }
 
-    UpdateAudioCallback update_audio_callback;
+    RenderAudioCallback render_audio_callback;
     EventCallback event_callback;
 
     static constexpr float PITCHBEND_RANGE_SEMITONES = 2.0f; // Standard MIDI pitchbend range in semitones
@@ -112,26 +165,54 @@ private:
     
     // Clock frequency measurement
     static constexpr int CLOCK_TICKS_PER_BEAT = 24; // MIDI clock sends 24 ticks per quarter note
-    static constexpr unsigned long MAX_CLOCK_TICK_DURATION = 4; // Maximum clock pulse duration in ticks
-    unsigned long clock_last_time;
-    int clock_tick_count;
-    unsigned long clock_measurement_start;
-    unsigned long internal_clock_last_tick_time; // Time of last internal clock tick
+    int clock_tick_count; // External ticks within the current beat
+    ClockPll clock_pll; // External tempo tracking, owned by the MIDI task
+    volatile bool clock_lost; // External clock stopped arriving
+    SyncClock sync_clock; // SYNC_IN edges to ticks, owned by the MIDI task
+    MidiClkType clock_source; // Clock type the PLL and song position were reset for
+
+    // SYNC_OUT is a clock engine output after the OutChannels, pulsing on every tick
+    static const size_t SYNC_OUT_INDEX = OutChannelCount;
+    static const uint32_t SYNC_OUT_PULSE_US = 2000;
+    static_assert(SYNC_OUT_INDEX < ClockEngine::MAX_OUTPUTS, "No clock engine output left for SYNC_OUT");
+
+    SongPosition song_position; // Transport of the external clock, owned by the MIDI task
+    bool run_gates; // Last state set_run_gates() wrote, false (stopped) at boot
+
+    // Type and effective channel every output was last set up for. An output
+    // whose setup changes, for example with a preset switch, is re-evaluated.
+    MidiOutType output_type[OutChannelCount];
+    MidiChannel output_channel[OutChannelCount];
+    bool outputs_applied; // The first settings only record the setup
+
+    // Clock gates are written only from clock_timer, the engine is shared under clock_lock
+    ClockEngine clock_engine;
+    esp_timer_handle_t clock_timer;
+    portMUX_TYPE clock_lock;
+    std::atomic<bool> clock_kicked;
+    uint32_t clock_events_seen;
+
+    // MIDI clock out, sent from clock_timer while the internal clock is the master.
+    // A pending Start or Continue goes out right before the next clock byte.
+    std::atomic<bool> clock_tx_enabled;
+    std::atomic<uint8_t> clock_tx_pending; // Status byte, 0 if none
+
+    void apply_settings(void);
+    void apply_clock_settings(void);
+    void evaluate_output(size_t idx);
+    uint8_t get_held_channel(size_t idx);
+    void external_clock_tick(uint64_t time_us, uint32_t measured_ticks);
+    void queue_clock_tx(uint8_t status);
+    void send_clock_tx(uint32_t ticks, uint64_t next_tick_us);
+    void locate_clock(uint32_t position);
+    void set_run_gates(bool running);
+    void kick_clock(void);
+    static void clock_timer_callback(void* parameter);
+    static uint64_t to_timer_us(uint32_t time_us);
     
     void out_gate(int pwm_ch, int velocity);
     void out_pitch(int pwm_ch, int note, int pitchbend_value = 0);
+    uint8_t get_priority_note(uint8_t channel, NotePriority priority);
     
     static void midi_task(void* parameter);
-
-    inline bool is_global_channel_match(uint8_t channel) const {
-        return (state->get_midi_channel() == channel) ||
-               (state->get_midi_channel() == MidiChannelAll);
-    }
-
-    inline bool is_out_channel_match(int out_channel, uint8_t channel) const {
-        if(state->get_midi_out_channel(out_channel) == MidiChannelUnchanged) return is_global_channel_match(channel);
-
-        return (state->get_midi_out_channel(out_channel) == channel) ||
-               (state->get_midi_out_channel(out_channel) == MidiChannelAll);
-    }
 };
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdint.h>
+#include <Arduino.h>
+#include <esp_timer.h>
+
+// Busy time accounting for a task.
+// begin()/end() run on the measured task and count CPU cycles of that core,
+// report() can be called from any task and returns the load since its previous call.
+struct TaskLoad {
+    volatile uint32_t busy_cycles = 0;
+    uint32_t start_cycles = 0;
+
+    uint32_t last_busy_cycles = 0;
+    int64_t last_report_us = 0;
+
+    inline void begin(void) {
+        start_cycles = ESP.getCycleCount();
+    }
+
+    inline void end(void) {
+        busy_cycles += ESP.getCycleCount() - start_cycles;
+    }
+
+    // Percent of one core, call at least every ~15 s so the cycle counter does not wrap
+    float report(void) {
+        int64_t now_us = esp_timer_get_time();
+        uint32_t busy = busy_cycles;
+        uint32_t busy_delta = busy - last_busy_cycles;
+        int64_t window_us = now_us - last_report_us;
+
+        last_busy_cycles = busy;
+        last_report_us = now_us;
+
+        if (window_us <= 0) return 0;
+        return 100.0f * busy_delta / ((float)window_us * ESP.getCpuFreqMHz());
+    }
+};
@@ -81,7 +81,7 @@ void check_adc() {
     }
 }
 
-void display_flags(Adafruit_SSD1306* display) {
+void display_flags(AsyncDisplay* display) {
     // Update display
     display->clearDisplay();
     display->setTextSize(1);
@@ -125,7 +125,7 @@ void display_flags(Adafruit_SSD1306* display) {
     display->println(adc1_max);
     display->setCursor(ROW_X, display->getCursorY());
     
-    display->display();
+    display->present();
 }
 
 void set_dac(SignalProcessor* signal_processor) {
@@ -165,7 +165,7 @@ void set_dac(SignalProcessor* signal_processor) {
     }
 }
 
-bool test_mode(Adafruit_SSD1306* display, Input* input, SignalProcessor* signal_processor) {
+bool test_mode(AsyncDisplay* display, Input* input, SignalProcessor* signal_processor) {
     // Configure MIDI_RX_PIN as input
     pinMode(MIDI_RX_PIN, INPUT);
 
@@ -1,6 +1,6 @@
 #pragma once
 
-#include <Adafruit_SSD1306.h>
+#include "display/async_display.h"
 #include "signal_processor/signal_processor.h"
 
 class Input;
@@ -16,5 +16,5 @@ enum TestFlagIndex {
     TestFlagCount = 7
 };
 
-bool test_mode(Adafruit_SSD1306* display, Input* input, SignalProcessor* signal_processor);
+bool test_mode(AsyncDisplay* display, Input* input, SignalProcessor* signal_processor);
 
@@ -1,11 +1,12 @@
 #pragma once
 
 #include <stdint.h>
-#include <Adafruit_SSD1306.h>
 #include <Arduino.h>
+#include "board.h"
+#include "display/async_display.h"
 #include "input/input.h"
 
-typedef Adafruit_SSD1306 Display;
+typedef AsyncDisplay Display;
 
 class ScreenInterface {
 public:
@@ -20,6 +21,23 @@ public:
 
     // Called to update the screen state based on events
     virtual void update(Event* event) = 0;
+
+    // Shortest time between two updates, input arriving sooner is handled in the next one
+    virtual uint32_t get_frame_ms() { return UI_FRAME_MS; }
+
+    // Longest time between two updates without input, for values that change on their own
+    virtual uint32_t get_refresh_ms() { return UI_REFRESH_MS; }
+
+    // Frames sent to the display by all screens, for load reports
+    static uint32_t get_frame_count() { return frame_count; }
 protected:
     Display* display;
+
+    // Hands the rendered frame to the display task
+    void show() {
+        display->present();
+        frame_count++;
+    }
+private:
+    static uint32_t frame_count;
 };
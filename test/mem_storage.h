@@ -0,0 +1,73 @@
+#pragma once
+
+#include <string.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "midi/settings_store.h"
+
+// SettingsStorage in RAM, standing in for the NVS namespace in host tests
+class MemStorage : public SettingsStorage
+{
+public:
+    std::map<std::string, uint32_t> u32;
+    std::map<std::string, std::vector<uint8_t>> blobs;
+    int commits = 0;
+    int blob_writes = 0;
+    bool fail_writes = false; // set_u32() and set_blob() fail while set
+
+    bool get_u32(const char* key, uint32_t* value) override {
+        auto it = u32.find(key);
+        if (it == u32.end()) return false;
+        *value = it->second;
+        return true;
+    }
+
+    bool set_u32(const char* key, uint32_t value) override {
+        if (fail_writes) return false;
+        u32[key] = value;
+        return true;
+    }
+
+    bool get_blob(const char* key, void* data, size_t* size) override {
+        auto it = blobs.find(key);
+        if (it == blobs.end() || it->second.size() > *size) return false;
+        memcpy(data, it->second.data(), it->second.size());
+        *size = it->second.size();
+        return true;
+    }
+
+    bool set_blob(const char* key, const void* data, size_t size) override {
+        if (fail_writes) return false;
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        blobs[key] = std::vector<uint8_t>(bytes, bytes + size);
+        blob_writes++;
+        return true;
+    }
+
+    bool erase_key(const char* key) override {
+        u32.erase(key);
+        blobs.erase(key);
+        return true;
+    }
+
+    bool commit(void) override {
+        commits++;
+        return true;
+    }
+};
+
+// Same values as MidiSettingsState::set_default()
+inline void set_default_settings(MidiSettingsData* data) {
+    memset(data, 0, sizeof(*data));
+    data->bpm = 120;
+    data->midi_channel = MidiChannelAll;
+    for (size_t i = 0; i < OutChannelCount; i++) {
+        data->midi_out_type[i] = MidiOutPitch;
+        data->midi_out_channel[i] = MidiChannelAll;
+        data->note_priority[i] = NotePriorityLast;
+        data->clock_ratio[i] = {1, 1, 0, 10};
+    }
+    data->midi_clk_type = MidiClkInt;
+    data->midi_tx_type = MidiTxOff;
+}
@@ -0,0 +1,171 @@
+#include <unity.h>
+#include <math.h>
+#include "signal_processor/audio_block.h"
+#include "osc/mixer.h"
+
+// Golden output: audio played through AudioBlock must be the same samples
+// a renderer called once per sample produces, only the channel switches
+// move to the next block boundary.
+
+static const size_t BLOCK = 32;
+static const int VOICES = 8;
+static const int AUDIO_SHIFT = 2; // MOZZI_AUDIO_BITS - 8
+
+static Mixer mixer;
+static int8_t table[256];
+
+// Voice state of the renderer, what render_audio() keeps in oscs[][]
+struct Voices
+{
+    uint32_t phase[2][VOICES];
+    uint32_t inc[2][VOICES];
+    int16_t gain[2][VOICES];
+};
+static Voices voices;
+
+static void voices_reset(void) {
+    for (int ch = 0; ch < 2; ch++) {
+        for (int i = 0; i < VOICES; i++) {
+            voices.phase[ch][i] = 0;
+            voices.inc[ch][i] = 40000 + 6151 * i + 1777 * ch;
+            voices.gain[ch][i] = (int32_t)(127 - 11 * i) * Mixer::GAIN_ONE / 127;
+        }
+    }
+}
+
+// Same loop as render_audio() with steady envelopes
+static void render(int16_t* left, int16_t* right, size_t frames) {
+    int16_t norm = mixer.get_norm(VOICES);
+    for (size_t n = 0; n < frames; n++) {
+        int32_t l = 0;
+        int32_t r = 0;
+        for (int i = 0; i < VOICES; i++) {
+            voices.phase[0][i] += voices.inc[0][i];
+            voices.phase[1][i] += voices.inc[1][i];
+            l += table[(voices.phase[0][i] >> 16) & 0xFF] * voices.gain[0][i];
+            r += table[(voices.phase[1][i] >> 16) & 0xFF] * voices.gain[1][i];
+        }
+        left[n] = mixer.out(l, norm) << AUDIO_SHIFT;
+        right[n] = mixer.out(r, norm) << AUDIO_SHIFT;
+    }
+}
+
+static size_t render_calls;
+static void counting_render(int16_t* left, int16_t* right, size_t frames) {
+    render_calls++;
+    render(left, right, frames);
+}
+
+// The per sample path updateAudio() used before the blocks
+static void per_sample(const bool enabled[2], const int cv[2], int* left, int* right) {
+    *left = cv[0];
+    *right = cv[1];
+    if (enabled[0] || enabled[1]) {
+        int16_t l, r;
+        render(&l, &r, 1);
+        if (enabled[0]) *left = l;
+        if (enabled[1]) *right = r;
+    }
+}
+
+void setUp(void) {
+    voices_reset();
+}
+
+void tearDown(void) {}
+
+static void test_block_matches_per_sample(void) {
+    const size_t FRAMES = 100 * BLOCK + 7;
+    const bool enabled[2] = {true, true};
+    const int cv[2] = {0, 0};
+
+    static int golden[FRAMES][2];
+    for (size_t n = 0; n < FRAMES; n++) {
+        per_sample(enabled, cv, &golden[n][0], &golden[n][1]);
+    }
+
+    voices_reset();
+    AudioBlock<BLOCK> block;
+    for (size_t n = 0; n < FRAMES; n++) {
+        if (block.is_played()) block.render(render, enabled);
+        int left = cv[0];
+        int right = cv[1];
+        block.next(&left, &right);
+        TEST_ASSERT_EQUAL(golden[n][0], left);
+        TEST_ASSERT_EQUAL(golden[n][1], right);
+    }
+}
+
+static void test_one_channel_keeps_cv(void) {
+    const size_t FRAMES = 20 * BLOCK;
+    const bool enabled[2] = {false, true};
+    const int cv[2] = {-300, 55};
+
+    static int golden[FRAMES][2];
+    for (size_t n = 0; n < FRAMES; n++) {
+        per_sample(enabled, cv, &golden[n][0], &golden[n][1]);
+    }
+
+    voices_reset();
+    AudioBlock<BLOCK> block;
+    for (size_t n = 0; n < FRAMES; n++) {
+        if (block.is_played()) block.render(render, enabled);
+        int left = cv[0];
+        int right = cv[1];
+        block.next(&left, &right);
+        TEST_ASSERT_EQUAL(-300, left);
+        TEST_ASSERT_EQUAL(golden[n][1], right);
+    }
+}
+
+static void test_switch_on_block_boundary(void) {
+    AudioBlock<BLOCK> block;
+    bool enabled[2] = {false, false};
+    const int cv[2] = {1000, 2000};
+    render_calls = 0;
+
+    for (size_t n = 0; n < 10 * BLOCK; n++) {
+        // The channels change mid block
+        if (n == 3 * BLOCK + 5) enabled[0] = true;
+        if (n == 7 * BLOCK + 20) enabled[0] = false;
+
+        if (block.is_played()) block.render(counting_render, enabled);
+        int left = cv[0];
+        int right = cv[1];
+        block.next(&left, &right);
+
+        bool playing = n >= 4 * BLOCK && n < 8 * BLOCK;
+        TEST_ASSERT_EQUAL(playing, left != cv[0]);
+        TEST_ASSERT_EQUAL(cv[1], right);
+    }
+    // Nothing is rendered while no channel plays
+    TEST_ASSERT_EQUAL(4, render_calls);
+}
+
+static void test_no_callback(void) {
+    AudioBlock<BLOCK> block;
+    const bool enabled[2] = {true, true};
+    TEST_ASSERT_TRUE(block.is_played());
+    TEST_ASSERT_FALSE(block.render(nullptr, enabled));
+    TEST_ASSERT_FALSE(block.is_played());
+
+    int left = 7;
+    int right = 8;
+    block.next(&left, &right);
+    TEST_ASSERT_EQUAL(7, left);
+    TEST_ASSERT_EQUAL(8, right);
+}
+
+int main(void) {
+    mixer.begin();
+    for (int i = 0; i < 256; i++) {
+        table[i] = (int8_t)lround(127 * sin(2 * M_PI * i / 256));
+    }
+
+    UNITY_BEGIN();
+    RUN_TEST(test_block_matches_per_sample);
+    RUN_TEST(test_one_channel_keeps_cv);
+    RUN_TEST(test_switch_on_block_boundary);
+    RUN_TEST(test_no_callback);
+    return UNITY_END();
+}
@@ -0,0 +1,109 @@
+#include <unity.h>
+#include "input/button_debouncer.h"
+
+static ButtonDebouncer button;
+static int presses;
+static int releases;
+static uint32_t press_ms;
+static uint32_t release_ms;
+
+void setUp(void) {
+    button = ButtonDebouncer();
+    presses = 0;
+    releases = 0;
+    press_ms = 0;
+    release_ms = 0;
+}
+
+void tearDown(void) {}
+
+static void count_change(void) {
+    if (button.is_pressed()) {
+        presses++;
+        press_ms = button.get_change_ms();
+    } else {
+        releases++;
+        release_ms = button.get_change_ms();
+    }
+}
+
+// Edges as Input::handle_edge() sees them, polled before each one like the UI task
+static void feed(uint32_t time_ms, bool level_pressed) {
+    if (button.poll(time_ms)) count_change();
+    if (button.edge(level_pressed, time_ms)) count_change();
+}
+
+static void test_bouncy_press_and_release(void) {
+    feed(1000, true);
+    feed(1001, false);
+    feed(1003, true);
+    feed(1004, false);
+    feed(1006, true);
+    feed(1300, false);
+    feed(1302, true);
+    feed(1303, false);
+    feed(1305, true);
+    feed(1306, false);
+    for (uint32_t t = 1306; t < 1500; t += 20) {
+        if (button.poll(t)) count_change();
+    }
+
+    TEST_ASSERT_EQUAL(1, presses);
+    TEST_ASSERT_EQUAL(1, releases);
+    TEST_ASSERT_EQUAL(1000, press_ms);
+    TEST_ASSERT_EQUAL(1300, release_ms);
+    TEST_ASSERT_FALSE(button.is_pressed());
+}
+
+static void test_short_tap_not_lost(void) {
+    // The release edge is inside the window, poll() takes it once the window passed
+    TEST_ASSERT_TRUE(button.edge(true, 2000));
+    TEST_ASSERT_FALSE(button.edge(false, 2030));
+    TEST_ASSERT_FALSE(button.poll(2040));
+    TEST_ASSERT_TRUE(button.poll(2000 + ButtonDebouncer::DEBOUNCE_MS));
+    TEST_ASSERT_FALSE(button.is_pressed());
+    TEST_ASSERT_EQUAL(2030, button.get_change_ms());
+
+    // A spike from idle is a press, its release comes after the window
+    setUp();
+    TEST_ASSERT_TRUE(button.edge(true, 5000));
+    TEST_ASSERT_FALSE(button.edge(false, 5001));
+    TEST_ASSERT_TRUE(button.poll(5051));
+    TEST_ASSERT_FALSE(button.is_pressed());
+}
+
+static void test_tap_then_press_before_poll(void) {
+    // Polled at the time of the next edge, both changes are kept
+    button.edge(true, 3000);
+    button.edge(false, 3020);
+    TEST_ASSERT_TRUE(button.poll(3200));
+    TEST_ASSERT_FALSE(button.is_pressed());
+    TEST_ASSERT_TRUE(button.edge(true, 3200));
+    TEST_ASSERT_TRUE(button.is_pressed());
+}
+
+static void test_bounce_back_to_old_level(void) {
+    button.edge(true, 4000);
+    button.edge(false, 4010);
+    button.edge(true, 4012);
+    TEST_ASSERT_FALSE(button.poll(4100));
+    TEST_ASSERT_TRUE(button.is_pressed());
+    TEST_ASSERT_EQUAL(4000, button.get_change_ms());
+}
+
+static void test_millisecond_wrap(void) {
+    TEST_ASSERT_TRUE(button.edge(true, 0xFFFFFFF0u));
+    TEST_ASSERT_FALSE(button.edge(false, 5));
+    TEST_ASSERT_TRUE(button.edge(false, 0xFFFFFFF0u + 60));
+    TEST_ASSERT_FALSE(button.is_pressed());
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_bouncy_press_and_release);
+    RUN_TEST(test_short_tap_not_lost);
+    RUN_TEST(test_tap_then_press_before_poll);
+    RUN_TEST(test_bounce_back_to_old_level);
+    RUN_TEST(test_millisecond_wrap);
+    return UNITY_END();
+}
@@ -0,0 +1,292 @@
+#include <unity.h>
+#include <math.h>
+#include <vector>
+#include "clock/clock_engine.h"
+
+// Drives a ClockEngine like the esp_timer callback does and records
+// the rising edges of every output, with the song position they fell on
+
+static const uint32_t PULSE_US = 1000;
+
+struct Edge
+{
+    uint64_t time_us;
+    uint32_t tick; // Song position of the next tick when the edge fired
+};
+
+struct Runner
+{
+    ClockEngine engine;
+    uint64_t now_us = 0;
+    std::vector<Edge> edges[ClockEngine::MAX_OUTPUTS];
+    std::vector<uint64_t> falls[ClockEngine::MAX_OUTPUTS];
+
+    // Processes every event up to until_us
+    void run(uint64_t until_us) {
+        while (true) {
+            uint64_t next = engine.get_next_event_us();
+            if (next > until_us) break;
+            if (next > now_us) now_us = next;
+
+            uint32_t before = engine.get_gate_mask();
+            uint32_t tick = engine.get_tick_count();
+            uint32_t changed = engine.update(now_us);
+            uint32_t gates = engine.get_gate_mask();
+            for (uint32_t mask = changed; mask != 0; mask &= mask - 1) {
+                int i = __builtin_ctz(mask);
+                if ((gates >> i) & 1) {
+                    edges[i].push_back({now_us, tick});
+                } else if ((before >> i) & 1) {
+                    falls[i].push_back(now_us);
+                }
+            }
+        }
+        now_us = until_us;
+    }
+
+    // One external tick at now_us + interval_us, arriving on time and locked
+    void external_tick(uint64_t interval_us) {
+        run(now_us + interval_us - 1);
+        now_us++;
+        engine.external_tick(now_us, now_us, interval_us << ClockEngine::FRAC_BITS, true);
+        run(now_us);
+    }
+
+    void clear(void) {
+        for (size_t i = 0; i < ClockEngine::MAX_OUTPUTS; i++) {
+            edges[i].clear();
+            falls[i].clear();
+        }
+    }
+};
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static void test_internal_ticks_do_not_drift(void) {
+    // 24 PPQN at 120 bpm is 20833.33 us per tick, an hour of ticks
+    Runner r;
+    r.engine.set_bpm(120);
+    r.engine.set_output(0, 24, 1, 0, 1); // Every tick
+    r.engine.reset(0);
+
+    const uint32_t TICKS = 120 * 60 * ClockEngine::PPQN;
+    r.run((uint64_t)TICKS * 20834);
+    TEST_ASSERT_TRUE(r.edges[0].size() >= TICKS);
+    for (uint32_t n = 0; n < TICKS; n += 997) {
+        double exact = n * 60e6 / (120.0 * ClockEngine::PPQN);
+        TEST_ASSERT_INT_WITHIN(1, llround(floor(exact)), r.edges[0][n].time_us);
+    }
+    // The Q16 interval is rounded, the hour ends within a microsecond
+    TEST_ASSERT_UINT64_WITHIN(1, 3600000000ULL, r.edges[0][TICKS].time_us);
+}
+
+static void test_divisions(void) {
+    Runner r;
+    r.engine.set_bpm(100);
+    r.engine.set_output(0, 1, 1, 0, PULSE_US); // Quarter notes
+    r.engine.set_output(1, 4, 1, 0, PULSE_US); // Sixteenths
+    r.engine.set_output(2, 1, 4, 0, PULSE_US); // Bars
+    r.engine.reset(0);
+    r.run(60000000 - 1); // 100 beats
+
+    TEST_ASSERT_EQUAL(100, r.edges[0].size());
+    TEST_ASSERT_EQUAL(400, r.edges[1].size());
+    TEST_ASSERT_EQUAL(25, r.edges[2].size());
+    for (size_t i = 0; i < r.edges[0].size(); i++) {
+        TEST_ASSERT_EQUAL(i * ClockEngine::PPQN, r.edges[0][i].tick);
+        TEST_ASSERT_INT_WITHIN(1, i * 600000, r.edges[0][i].time_us);
+    }
+    for (size_t i = 0; i < r.edges[1].size(); i++) {
+        TEST_ASSERT_INT_WITHIN(1, i * 150000, r.edges[1][i].time_us);
+    }
+    // Pulses are PULSE_US long
+    for (size_t i = 0; i < r.falls[0].size(); i++) {
+        TEST_ASSERT_EQUAL_UINT64(r.edges[0][i].time_us + PULSE_US, r.falls[0][i]);
+    }
+}
+
+static void test_ratio_and_phase(void) {
+    // 3 pulses every 2 beats, evenly spaced between the ticks
+    Runner r;
+    r.engine.set_bpm(120);
+    r.engine.set_output(0, 3, 2, 0, PULSE_US);
+    r.engine.set_output(1, 3, 2, ClockEngine::get_period_units(2) / 2, PULSE_US); // Half a period late
+    r.engine.reset(0);
+    r.run(9900000); // 20 beats
+
+    TEST_ASSERT_EQUAL(30, r.edges[0].size());
+    TEST_ASSERT_EQUAL(30, r.edges[1].size());
+    const double period = 2 * 500000 / 3.0;
+    for (size_t i = 0; i < r.edges[0].size(); i++) {
+        TEST_ASSERT_INT_WITHIN(1, llround(i * period), r.edges[0][i].time_us);
+        TEST_ASSERT_INT_WITHIN(1, llround(i * period + period / 2), r.edges[1][i].time_us);
+    }
+}
+
+static void test_all_ratios_against_closed_form(void) {
+    // Every mul/div pair of the menu, four phase offsets each. Pulse k of an output
+    // sits at offset + k * PPQN * div in 1/mul tick units, so at 120 bpm it is due at
+    // that position times 20833.33 / mul us. Two periods of the slowest output are run.
+    const int MAX_RATIO = 16;
+    const uint32_t BEATS = 2 * MAX_RATIO;
+    const double tick_us = 60e6 / (120.0 * ClockEngine::PPQN);
+    const uint64_t beat_us = 500000;
+
+    for (int mul = 1; mul <= MAX_RATIO; mul++) {
+        for (int div = 1; div <= MAX_RATIO; div++) {
+            const uint32_t period = ClockEngine::get_period_units(div);
+            const uint32_t offsets[] = {0, 1, period / 2, period - 1};
+            const size_t OFFSETS = sizeof(offsets) / sizeof(offsets[0]);
+
+            Runner r;
+            r.engine.set_bpm(120);
+            for (size_t o = 0; o < OFFSETS; o++) {
+                r.engine.set_output(o, mul, div, offsets[o], PULSE_US);
+            }
+            r.engine.reset(0);
+            r.run(BEATS * beat_us - 2); // The pulse on the last beat may be 1 us early
+
+            for (size_t o = 0; o < OFFSETS; o++) {
+                uint32_t expected_count[BEATS] = {0};
+                uint32_t count[BEATS] = {0};
+                uint64_t end = (uint64_t)BEATS * ClockEngine::PPQN * mul;
+                size_t k = 0;
+                for (uint64_t pos = offsets[o]; pos < end; pos += period, k++) {
+                    expected_count[pos / (ClockEngine::PPQN * mul)]++;
+                    TEST_ASSERT_TRUE_MESSAGE(k < r.edges[o].size(), "pulse missing");
+
+                    // On a tick, or placed inside the tick before. Tick times are truncated
+                    // to us and so is the interpolated part, a placed pulse may be 2 us early.
+                    const Edge& e = r.edges[o][k];
+                    double exact = pos * tick_us / mul;
+                    TEST_ASSERT_EQUAL(pos / mul + (pos % mul != 0), e.tick);
+                    TEST_ASSERT_INT_WITHIN(pos % mul != 0 ? 2 : 1, llround(floor(exact)), e.time_us);
+
+                    // Pulses off a beat are at least a 1/16 tick from it, the ones on it may be 1 us early
+                    uint32_t beat = (e.time_us + 2) / beat_us;
+                    TEST_ASSERT_TRUE(beat < BEATS);
+                    count[beat]++;
+                }
+                TEST_ASSERT_EQUAL(k, r.edges[o].size());
+                TEST_ASSERT_EQUAL_UINT32_ARRAY(expected_count, count, BEATS);
+            }
+        }
+    }
+}
+
+static void test_pulse_clamped_to_half_period(void) {
+    // 24 pulses per beat at 240 bpm is 10416 us apart, a 20 ms pulse would merge them
+    Runner r;
+    r.engine.set_bpm(240);
+    r.engine.set_output(0, 24, 1, 0, 20000);
+    r.engine.reset(0);
+    r.run(1000000);
+
+    TEST_ASSERT_TRUE(r.edges[0].size() > 90);
+    for (size_t i = 0; i < r.falls[0].size(); i++) {
+        uint64_t width = r.falls[0][i] - r.edges[0][i].time_us;
+        TEST_ASSERT_UINT64_WITHIN(1, 10416 / 2, width);
+    }
+}
+
+static void test_tempo_change_keeps_last_tick(void) {
+    Runner r;
+    r.engine.set_bpm(120);
+    r.engine.set_output(0, 24, 1, 0, 1);
+    r.engine.reset(0);
+    r.run(100000); // Ticks at 0, 20833, ... 83333
+    TEST_ASSERT_EQUAL(5, r.edges[0].size());
+
+    r.engine.set_bpm(60);
+    // 83333.3 + 41666.7 us
+    TEST_ASSERT_UINT64_WITHIN(1, 125000, r.engine.get_next_tick_us());
+    r.run(125000);
+    TEST_ASSERT_EQUAL(6, r.edges[0].size());
+    TEST_ASSERT_UINT64_WITHIN(1, 125000, r.edges[0].back().time_us);
+}
+
+static void test_external_ticks_predicted_and_interpolated(void) {
+    Runner r;
+    r.engine.set_output(0, 1, 1, 0, PULSE_US);
+    r.engine.set_output(1, 16, 1, 0, 100); // Every 1.5 ticks, every other pulse between two ticks
+    r.engine.set_internal(false, 0);
+    r.engine.reset(0);
+
+    for (int i = 0; i < 48; i++) {
+        r.external_tick(20000);
+    }
+    TEST_ASSERT_EQUAL(2, r.edges[0].size());
+    TEST_ASSERT_EQUAL(0, r.edges[0][0].tick);
+    TEST_ASSERT_EQUAL(ClockEngine::PPQN, r.edges[0][1].tick);
+
+    // The in between pulses land half way between the ticks
+    TEST_ASSERT_EQUAL(32, r.edges[1].size());
+    for (size_t i = 0; i + 1 < r.edges[1].size(); i++) {
+        uint64_t gap = r.edges[1][i + 1].time_us - r.edges[1][i].time_us;
+        TEST_ASSERT_UINT64_WITHIN(1, 30000, gap);
+    }
+
+    // Without ticks the locked engine predicts one tick, then waits
+    uint32_t ticks = r.engine.get_tick_count();
+    r.run(r.now_us + 200000);
+    TEST_ASSERT_EQUAL(ticks + 1, r.engine.get_tick_count());
+    TEST_ASSERT_EQUAL_UINT64(ClockEngine::NO_EVENT, r.engine.get_next_event_us());
+}
+
+static void test_song_position(void) {
+    // MIDI start, song position pointer and continue as SignalProcessor handles them
+    Runner r;
+    r.engine.set_output(0, 1, 1, 0, PULSE_US); // Beats
+    r.engine.set_output(1, 1, 4, 0, PULSE_US); // Bars
+    r.engine.set_internal(false, 0);
+    r.engine.reset(0);
+    for (int i = 0; i < 100; i++) r.external_tick(20833);
+    TEST_ASSERT_EQUAL(5, r.edges[0].size());
+    for (const Edge& e : r.edges[0]) TEST_ASSERT_EQUAL(0, e.tick % 24);
+
+    // Stop, then song position 17 sixteenths (tick 102) and continue
+    r.engine.external_lost();
+    r.run(r.now_us + 500000);
+    r.clear();
+    r.engine.locate(17 * 6, r.now_us);
+    for (int i = 0; i < 200; i++) r.external_tick(20833);
+
+    TEST_ASSERT_FALSE(r.edges[0].empty());
+    TEST_ASSERT_EQUAL(120, r.edges[0][0].tick);
+    for (const Edge& e : r.edges[0]) TEST_ASSERT_EQUAL(0, e.tick % 24);
+    TEST_ASSERT_FALSE(r.edges[1].empty());
+    TEST_ASSERT_EQUAL(192, r.edges[1][0].tick);
+    for (const Edge& e : r.edges[1]) TEST_ASSERT_EQUAL(0, e.tick % 96);
+}
+
+static void test_output_disable_and_offset_range(void) {
+    Runner r;
+    r.engine.set_bpm(120);
+    r.engine.set_output(0, 1, 1, 5 * ClockEngine::PPQN + 3, PULSE_US); // Offset wraps to 3 ticks
+    r.engine.reset(0);
+    r.run(1000000);
+    TEST_ASSERT_FALSE(r.edges[0].empty());
+    TEST_ASSERT_EQUAL(3, r.edges[0][0].tick);
+
+    // A disabled output reports nothing and its gate is dropped
+    r.engine.set_output(0, 0, 1, 0, PULSE_US);
+    size_t count = r.edges[0].size();
+    r.run(3000000);
+    TEST_ASSERT_EQUAL(count, r.edges[0].size());
+    TEST_ASSERT_EQUAL(0, r.engine.get_gate_mask());
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_internal_ticks_do_not_drift);
+    RUN_TEST(test_divisions);
+    RUN_TEST(test_ratio_and_phase);
+    RUN_TEST(test_all_ratios_against_closed_form);
+    RUN_TEST(test_pulse_clamped_to_half_period);
+    RUN_TEST(test_tempo_change_keeps_last_tick);
+    RUN_TEST(test_external_ticks_predicted_and_interpolated);
+    RUN_TEST(test_song_position);
+    RUN_TEST(test_output_disable_and_offset_range);
+    return UNITY_END();
+}
@@ -0,0 +1,156 @@
+#include <unity.h>
+#include <math.h>
+#include <stdio.h>
+#include "clock/clock_pll.h"
+
+static ClockPll pll;
+static uint32_t rng_state;
+
+void setUp(void) {
+    pll = ClockPll();
+    rng_state = 1;
+}
+
+void tearDown(void) {}
+
+// Uniform -range..range, the spread of MIDI clock bytes queued behind other messages
+static int jitter(int range) {
+    rng_state = rng_state * 1664525u + 1013904223u;
+    return (int)((rng_state >> 8) % (2 * range + 1)) - range;
+}
+
+static double period_for(double bpm) {
+    return 60e6 / (bpm * ClockPll::PPQN);
+}
+
+static void test_locks_to_jittery_clock(void) {
+    // 120.5 bpm with +/-300 us of jitter
+    const double period = period_for(120.5);
+    double raw_error = 0;
+    double filtered_error = 0;
+    int samples = 0;
+
+    for (int n = 0; n < 24 * 16; n++) {
+        double exact = 1000000 + n * period;
+        uint64_t arrival = (uint64_t)llround(exact + jitter(300));
+        pll.tick(arrival);
+        if (n + 1 == (int)ClockPll::LOCK_TICKS - 1) TEST_ASSERT_FALSE(pll.is_locked());
+        if (n >= 48) {
+            raw_error += fabs((double)arrival - exact);
+            filtered_error += fabs((double)pll.get_tick_time_us() - exact);
+            samples++;
+        }
+    }
+
+    TEST_ASSERT_TRUE(pll.is_locked());
+    TEST_ASSERT_FLOAT_WITHIN(0.1, 120.5, pll.get_bpm());
+    TEST_ASSERT_TRUE(fabs(pll.get_period_us() - period) < 0.002 * period);
+    TEST_ASSERT_EQUAL_UINT64((uint64_t)llround(pll.get_period_us() * 65536), pll.get_interval_q16());
+    // Filtered tick times are closer to the true clock than the raw arrivals
+    TEST_ASSERT_TRUE(filtered_error / samples < 0.6 * raw_error / samples);
+    TEST_ASSERT_EQUAL(0, pll.get_tempo_changes());
+
+    char text[80];
+    snprintf(text, sizeof(text), "mean tick error %.1f us filtered, %.1f us raw",
+             filtered_error / samples, raw_error / samples);
+    TEST_MESSAGE(text);
+}
+
+static void test_single_glitch_is_ignored(void) {
+    const double period = period_for(120);
+    for (int n = 0; n < 48; n++) pll.tick((uint64_t)llround(n * period));
+    double before = pll.get_period_us();
+
+    // One tick 8 ms late, then the clock goes on
+    pll.tick((uint64_t)llround(48 * period) + 8000);
+    for (int n = 49; n < 60; n++) pll.tick((uint64_t)llround(n * period));
+
+    TEST_ASSERT_TRUE(pll.is_locked());
+    TEST_ASSERT_EQUAL(0, pll.get_tempo_changes());
+    TEST_ASSERT_TRUE(fabs(pll.get_period_us() - before) < 0.001 * period);
+}
+
+static void test_tempo_jump_restarts_fit(void) {
+    double t = 0;
+    for (int n = 0; n < 48; n++) {
+        pll.tick((uint64_t)llround(t));
+        t += period_for(120);
+    }
+    for (int n = 0; n < 48; n++) {
+        t += period_for(90);
+        pll.tick((uint64_t)llround(t));
+    }
+
+    TEST_ASSERT_EQUAL(1, pll.get_tempo_changes());
+    TEST_ASSERT_TRUE(pll.is_locked());
+    TEST_ASSERT_FLOAT_WITHIN(0.05, 90, pll.get_bpm());
+}
+
+static void test_follows_tempo_ramp(void) {
+    // 100 to 140 bpm over 32 beats
+    double t = 0;
+    double bpm = 100;
+    double worst = 0;
+    for (int n = 0; n < 24 * 32; n++) {
+        pll.tick((uint64_t)llround(t));
+        if (n > 24) worst = fmax(worst, fabs(pll.get_bpm() - bpm));
+        bpm += 40.0 / (24 * 32);
+        t += period_for(bpm);
+    }
+    TEST_ASSERT_TRUE(pll.is_locked());
+    TEST_ASSERT_TRUE(worst < 1.0);
+
+    char text[60];
+    snprintf(text, sizeof(text), "worst tempo lag on the ramp %.2f bpm", worst);
+    TEST_MESSAGE(text);
+}
+
+static void test_loss_and_limits(void) {
+    TEST_ASSERT_FALSE(pll.check_lost(10000000));
+    TEST_ASSERT_EQUAL(0, pll.get_bpm());
+
+    const double period = period_for(120);
+    for (int n = 0; n < 10; n++) pll.tick((uint64_t)llround(n * period));
+    uint64_t last = (uint64_t)llround(9 * period);
+    TEST_ASSERT_FALSE(pll.check_lost(last + (uint64_t)(3 * period)));
+    TEST_ASSERT_TRUE(pll.check_lost(last + (uint64_t)(5 * period)));
+    TEST_ASSERT_FALSE(pll.has_period());
+    TEST_ASSERT_FALSE(pll.check_lost(last + (uint64_t)(10 * period)));
+
+    // Intervals outside the supported range are clamped
+    pll.reset();
+    pll.tick(0);
+    pll.tick(100);
+    TEST_ASSERT_EQUAL(ClockPll::MIN_PERIOD_US, pll.get_period_us());
+    pll.reset();
+    pll.tick(0);
+    pll.tick(10000000);
+    TEST_ASSERT_EQUAL(ClockPll::MAX_PERIOD_US, pll.get_period_us());
+}
+
+static void test_edges_spanning_several_ticks(void) {
+    // 2 PPQN sync edges at 90 bpm, 12 ticks each
+    const double period = period_for(90);
+    for (int n = 0; n < 16; n++) {
+        pll.tick((uint64_t)llround(1000000 + n * 12 * period + jitter(300)), 12);
+    }
+    TEST_ASSERT_TRUE(pll.is_locked());
+    TEST_ASSERT_FLOAT_WITHIN(0.05, 90, pll.get_bpm());
+    TEST_ASSERT_EQUAL(0, pll.get_tempo_changes());
+
+    // Loss waits for LOSS_PERIODS edges, not ticks
+    uint64_t last = (uint64_t)llround(1000000 + 15 * 12 * period);
+    TEST_ASSERT_FALSE(pll.check_lost(last + (uint64_t)(3 * 12 * period)));
+    TEST_ASSERT_TRUE(pll.check_lost(last + (uint64_t)(5 * 12 * period)));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_locks_to_jittery_clock);
+    RUN_TEST(test_single_glitch_is_ignored);
+    RUN_TEST(test_tempo_jump_restarts_fit);
+    RUN_TEST(test_follows_tempo_ramp);
+    RUN_TEST(test_loss_and_limits);
+    RUN_TEST(test_edges_spanning_several_ticks);
+    return UNITY_END();
+}
@@ -0,0 +1,130 @@
+#include <unity.h>
+#include "deferred_store.h"
+
+struct Settings
+{
+    int bpm;
+    uint8_t channels[5];
+};
+
+// Runs the policy the way MidiSettingsState::write_pending() does, against a flash
+// stand-in that counts writes
+struct Store
+{
+    static const uint32_t QUIET_MS = 2000;
+    static const uint32_t MAX_DELAY_MS = 10000;
+
+    Settings data;
+    Settings flash;
+    DeferredStore<Settings> deferred;
+    int writes;
+    bool fail_writes;
+
+    Store() : deferred(QUIET_MS, MAX_DELAY_MS), writes(0), fail_writes(false) {
+        memset(&data, 0, sizeof(data));
+        memset(&flash, 0, sizeof(flash));
+        deferred.set_stored(data);
+    }
+
+    void change(int bpm, uint32_t now_ms) {
+        data.bpm = bpm;
+        deferred.mark_dirty(now_ms);
+    }
+
+    void poll(uint32_t now_ms, bool force = false) {
+        if (!deferred.dirty || !(force || deferred.is_due(now_ms))) return;
+
+        Settings snapshot = data;
+        if (!deferred.take(snapshot)) return;
+        if (fail_writes) {
+            deferred.mark_dirty(now_ms);
+            return;
+        }
+        writes++;
+        flash = snapshot;
+        deferred.set_stored(snapshot);
+    }
+};
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+static void test_burst_written_once_when_quiet(void) {
+    // A knob turned for a second, one change every 50 ms
+    Store store;
+    for (uint32_t t = 0; t < 1000; t += 50) store.change(100 + t / 50, t);
+
+    store.poll(950 + Store::QUIET_MS - 1);
+    TEST_ASSERT_EQUAL(0, store.writes);
+    store.poll(950 + Store::QUIET_MS);
+    TEST_ASSERT_EQUAL(1, store.writes);
+    TEST_ASSERT_EQUAL(119, store.flash.bpm);
+
+    for (uint32_t t = 3000; t < 20000; t += 100) store.poll(t);
+    TEST_ASSERT_EQUAL(1, store.writes);
+}
+
+static void test_continuous_changes_written_after_max_delay(void) {
+    Store store;
+    for (uint32_t t = 0; t < 25000; t += 100) {
+        store.change((int)t, t);
+        store.poll(t);
+    }
+    // 10 s after the first change, then 10 s after the first one it missed
+    TEST_ASSERT_EQUAL(2, store.writes);
+    TEST_ASSERT_EQUAL(20100, store.flash.bpm);
+}
+
+static void test_unchanged_content_not_written(void) {
+    // Changed and changed back
+    Store store;
+    store.change(5, 0);
+    store.change(0, 100);
+    store.poll(3000);
+    TEST_ASSERT_EQUAL(0, store.writes);
+    TEST_ASSERT_FALSE(store.deferred.dirty);
+}
+
+static void test_failed_write_retries_and_flush(void) {
+    Store store;
+    store.fail_writes = true;
+    store.change(7, 0);
+    store.poll(2000);
+    TEST_ASSERT_TRUE(store.deferred.dirty);
+
+    // The retry waits another quiet period
+    store.fail_writes = false;
+    store.poll(3000);
+    TEST_ASSERT_EQUAL(0, store.writes);
+    store.poll(4000);
+    TEST_ASSERT_EQUAL(1, store.writes);
+
+    // A flush writes at once
+    store.change(8, 5000);
+    store.poll(5001, true);
+    TEST_ASSERT_EQUAL(2, store.writes);
+    TEST_ASSERT_EQUAL(8, store.flash.bpm);
+    store.poll(9000);
+    TEST_ASSERT_EQUAL(2, store.writes);
+}
+
+static void test_millisecond_wrap(void) {
+    Store store;
+    uint32_t start = 0xFFFFFF00u;
+    store.change(3, start);
+    store.poll(start + 1000);
+    TEST_ASSERT_EQUAL(0, store.writes);
+    store.poll(start + Store::QUIET_MS);
+    TEST_ASSERT_EQUAL(1, store.writes);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_burst_written_once_when_quiet);
+    RUN_TEST(test_continuous_changes_written_after_max_delay);
+    RUN_TEST(test_unchanged_content_not_written);
+    RUN_TEST(test_failed_write_retries_and_flush);
+    RUN_TEST(test_millisecond_wrap);
+    return UNITY_END();
+}
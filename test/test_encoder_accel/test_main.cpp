@@ -0,0 +1,90 @@
+#include <unity.h>
+#include <stdio.h>
+#include <vector>
+#include "input/encoder_accel.h"
+#include "midi/midi_settings_data.h"
+
+static EncoderAccel accel;
+
+void setUp(void) {
+    accel.reset();
+}
+
+void tearDown(void) {}
+
+static std::vector<uint32_t> evenly(uint32_t start, int count, uint32_t step_ms) {
+    std::vector<uint32_t> times;
+    for (int i = 0; i < count; i++) times.push_back(start + i * step_ms);
+    return times;
+}
+
+// Detents at the given times, the count read every frame_ms like the UI task
+// or at every detent if frame_ms is 0. Returns the total scaled steps.
+static int turn(const std::vector<uint32_t>& times, int direction, uint32_t frame_ms) {
+    int total = 0;
+    size_t next = 0;
+    uint32_t step = frame_ms ? frame_ms : 1;
+    for (uint32_t now = times.front(); now <= times.back() + frame_ms; now += step) {
+        int detents = 0;
+        uint32_t last_ms = 0;
+        while (next < times.size() && times[next] <= now) {
+            detents++;
+            last_ms = times[next++];
+        }
+        if (detents) total += accel.update(direction * detents, last_ms);
+    }
+    return total;
+}
+
+static void test_slow_turns_one_step_per_detent(void) {
+    TEST_ASSERT_EQUAL(20, turn(evenly(1000, 20, 100), 1, 0));
+    accel.reset();
+    TEST_ASSERT_EQUAL(-20, turn(evenly(1000, 20, EncoderAccel::SLOW_MS + 5), -1, 0));
+}
+
+static void test_flick_crosses_output_types(void) {
+    // 12 to 15 detents in 150 ms reach every output type, whatever the frame rate
+    const int range = MidiOutClockRatio - MidiOutClock1_4;
+    const uint32_t frames[] = {0, 20, 30};
+    const int counts[] = {12, 15};
+    for (uint32_t frame_ms : frames) {
+        for (int count : counts) {
+            accel.reset();
+            int steps = turn(evenly(5000, count, 150 / count), 1, frame_ms);
+            TEST_ASSERT_TRUE(steps >= range);
+
+            char text[80];
+            snprintf(text, sizeof(text), "%d detents in 150 ms, read every %u ms: %d steps",
+                     count, (unsigned)frame_ms, steps);
+            TEST_MESSAGE(text);
+        }
+    }
+}
+
+static void test_moderate_speed(void) {
+    int steps = turn(evenly(1000, 10, 35), 1, 0);
+    TEST_ASSERT_TRUE(steps > 10);
+    TEST_ASSERT_TRUE(steps < 100);
+}
+
+static void test_direction_change_and_pause_start_over(void) {
+    turn(evenly(1000, 10, 10), 1, 0);
+    TEST_ASSERT_EQUAL(-1, accel.update(-1, 1100));
+
+    // Fast detents across the millisecond wrap keep their gain, a pause still resets it
+    accel.reset();
+    uint32_t time_ms = 0xFFFFFFC0u;
+    for (int i = 0; i < 10; i++, time_ms += 10) accel.update(1, time_ms);
+    TEST_ASSERT_TRUE(time_ms < 0xFFFFFFC0u);
+    TEST_ASSERT_TRUE(accel.update(1, time_ms) > 1);
+    TEST_ASSERT_EQUAL(1, accel.update(1, time_ms + 500));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_slow_turns_one_step_per_detent);
+    RUN_TEST(test_flick_crosses_output_types);
+    RUN_TEST(test_moderate_speed);
+    RUN_TEST(test_direction_change_and_pause_start_over);
+    return UNITY_END();
+}
@@ -0,0 +1,143 @@
+#include <unity.h>
+#include "osc/envelope.h"
+
+static const uint32_t RATE = 1024; // MOZZI_CONTROL_RATE
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// Ticks until the envelope leaves stage, at most limit
+static int ticks_in_stage(Envelope* env, const EnvelopeParams& params, Envelope::Stage stage, int limit) {
+    int ticks = 0;
+    while (env->stage == stage && ticks < limit) {
+        env->tick(params);
+        ticks++;
+    }
+    return ticks;
+}
+
+static void test_adsr_stages(void) {
+    EnvelopeParams params(RATE);
+    params.set_attack_ms(10);
+    params.set_decay_ms(100);
+    params.set_sustain(64);
+    params.set_release_ms(50);
+
+    Envelope env;
+    TEST_ASSERT_FALSE(env.is_active());
+    TEST_ASSERT_EQUAL(0, env.tick(params));
+
+    env.note_on();
+    // 10 ms at 1024 Hz is 10 ticks, rounding of the step may add one
+    TEST_ASSERT_INT_WITHIN(1, 10, ticks_in_stage(&env, params, Envelope::StageAttack, 1000));
+    TEST_ASSERT_EQUAL(Envelope::StageDecay, env.stage);
+
+    // Decay covers the distance to sustain at the full scale rate
+    int decay = ticks_in_stage(&env, params, Envelope::StageDecay, 1000);
+    TEST_ASSERT_INT_WITHIN(2, 102 * 63 / 127, decay);
+    TEST_ASSERT_EQUAL(Envelope::StageSustain, env.stage);
+    TEST_ASSERT_INT_WITHIN(1, 32767 * 64 / 127, env.tick(params));
+
+    env.note_off();
+    TEST_ASSERT_TRUE(env.is_active());
+    int release = ticks_in_stage(&env, params, Envelope::StageRelease, 1000);
+    TEST_ASSERT_INT_WITHIN(2, 51 * 64 / 127, release);
+    TEST_ASSERT_FALSE(env.is_active());
+    TEST_ASSERT_EQUAL(0, env.tick(params));
+}
+
+static void test_levels_are_monotonic(void) {
+    EnvelopeParams params(RATE);
+    params.set_attack_ms(30);
+    params.set_decay_ms(30);
+    params.set_sustain(100);
+    params.set_release_ms(30);
+
+    Envelope env;
+    env.note_on();
+    int16_t previous = 0;
+    while (env.stage == Envelope::StageAttack) {
+        int16_t level = env.tick(params);
+        TEST_ASSERT_GREATER_OR_EQUAL(previous, level);
+        previous = level;
+    }
+    TEST_ASSERT_EQUAL(32767, previous);
+    while (env.stage == Envelope::StageDecay) {
+        int16_t level = env.tick(params);
+        TEST_ASSERT_LESS_OR_EQUAL(previous, level);
+        previous = level;
+    }
+    env.note_off();
+    while (env.is_active()) {
+        int16_t level = env.tick(params);
+        TEST_ASSERT_LESS_OR_EQUAL(previous, level);
+        previous = level;
+    }
+    TEST_ASSERT_EQUAL(0, previous);
+}
+
+static void test_retrigger_starts_from_current_level(void) {
+    EnvelopeParams params(RATE);
+    params.set_attack_ms(100);
+    params.set_release_ms(1000);
+
+    Envelope env;
+    env.note_on();
+    for (int i = 0; i < 200; i++) env.tick(params);
+    env.note_off();
+    int16_t released = 0;
+    for (int i = 0; i < 100; i++) released = env.tick(params);
+    TEST_ASSERT_TRUE(released > 0 && released < 32767);
+
+    env.note_on();
+    TEST_ASSERT_GREATER_THAN(released, env.tick(params));
+}
+
+static void test_sustain_changes_and_zero_sustain(void) {
+    EnvelopeParams params(RATE);
+    params.set_attack_ms(1);
+    params.set_decay_ms(1);
+    params.set_sustain(127);
+
+    Envelope env;
+    env.note_on();
+    for (int i = 0; i < 10; i++) env.tick(params);
+    TEST_ASSERT_EQUAL(Envelope::StageSustain, env.stage);
+
+    // A held note follows the sustain control
+    params.set_sustain(32);
+    TEST_ASSERT_INT_WITHIN(1, 32767 * 32 / 127, env.tick(params));
+
+    // Sustain at zero ends the note without a release
+    params.set_sustain(0);
+    env.tick(params);
+    TEST_ASSERT_FALSE(env.is_active());
+
+    // note_off() of an idle envelope keeps it idle
+    env.note_off();
+    TEST_ASSERT_FALSE(env.is_active());
+}
+
+static void test_cc_to_ms(void) {
+    TEST_ASSERT_EQUAL(EnvelopeParams::MIN_TIME_MS, EnvelopeParams::cc_to_ms(0));
+    TEST_ASSERT_EQUAL(EnvelopeParams::MAX_TIME_MS, EnvelopeParams::cc_to_ms(127));
+    TEST_ASSERT_EQUAL(EnvelopeParams::MAX_TIME_MS, EnvelopeParams::cc_to_ms(200));
+    for (uint8_t v = 1; v < 128; v++) {
+        TEST_ASSERT_GREATER_OR_EQUAL(EnvelopeParams::cc_to_ms(v - 1), EnvelopeParams::cc_to_ms(v));
+    }
+
+    // Times below a tick still move
+    EnvelopeParams params(RATE);
+    params.set_attack_ms(0);
+    TEST_ASSERT_EQUAL(Envelope::FULL_SCALE, params.attack_step);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_adsr_stages);
+    RUN_TEST(test_levels_are_monotonic);
+    RUN_TEST(test_retrigger_starts_from_current_level);
+    RUN_TEST(test_sustain_changes_and_zero_sustain);
+    RUN_TEST(test_cc_to_ms);
+    return UNITY_END();
+}
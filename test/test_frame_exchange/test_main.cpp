@@ -0,0 +1,125 @@
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "frame_exchange.h"
+#include "display/frame_histogram.h"
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+static void test_swap_protocol(void) {
+    static FrameExchange<16> exchange;
+    TEST_ASSERT_FALSE(exchange.acquire());
+
+    memset(exchange.get_back(), 1, 16);
+    TEST_ASSERT_FALSE(exchange.publish());
+    memset(exchange.get_back(), 2, 16);
+    TEST_ASSERT_TRUE(exchange.publish()); // Frame 1 was never taken
+
+    TEST_ASSERT_TRUE(exchange.acquire());
+    TEST_ASSERT_EQUAL(2, exchange.get_front()[0]);
+    TEST_ASSERT_FALSE(exchange.acquire());
+
+    // Writer, reader and the latest frame each own a different buffer
+    uint32_t third = exchange.ready.load() & FrameExchange<16>::INDEX;
+    TEST_ASSERT_NOT_EQUAL(exchange.back, exchange.front);
+    TEST_ASSERT_NOT_EQUAL(exchange.back, third);
+    TEST_ASSERT_NOT_EQUAL(exchange.front, third);
+
+    memset(exchange.get_back(), 3, 16);
+    TEST_ASSERT_FALSE(exchange.publish());
+    TEST_ASSERT_TRUE(exchange.acquire());
+    TEST_ASSERT_EQUAL(3, exchange.get_front()[15]);
+}
+
+static void test_reader_thread_sees_whole_newer_frames(void) {
+    // The writer fills each 1 KB frame with its number, as fast as it can
+    const size_t SIZE = 1024;
+    static FrameExchange<SIZE> exchange;
+    std::atomic<bool> done(false);
+    uint32_t received = 0;
+    uint32_t torn = 0;
+    uint32_t backwards = 0;
+
+    std::thread reader([&]() {
+        uint32_t last = 0;
+        while (!done.load() || (exchange.ready.load() & FrameExchange<SIZE>::FRESH)) {
+            if (!exchange.acquire()) {
+                std::this_thread::yield();
+                continue;
+            }
+            const uint8_t* frame = exchange.get_front();
+            uint32_t number;
+            memcpy(&number, frame, sizeof(number));
+            for (size_t i = sizeof(number); i < SIZE; i += sizeof(number)) {
+                uint32_t word;
+                memcpy(&word, frame + i, sizeof(word));
+                if (word != number) {
+                    torn++;
+                    break;
+                }
+            }
+            if (number <= last) backwards++;
+            last = number;
+            received++;
+        }
+    });
+
+    uint32_t published = 0;
+    uint32_t dropped = 0;
+    auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(500);
+    while (std::chrono::steady_clock::now() < end) {
+        published++;
+        uint8_t* frame = exchange.get_back();
+        for (size_t i = 0; i < SIZE; i += sizeof(published)) memcpy(frame + i, &published, sizeof(published));
+        if (exchange.publish()) dropped++;
+        if ((published & 63) == 0) std::this_thread::yield();
+    }
+    done = true;
+    reader.join();
+
+    TEST_ASSERT_EQUAL(0, torn);
+    TEST_ASSERT_EQUAL(0, backwards);
+    TEST_ASSERT_EQUAL(published, received + dropped);
+    TEST_ASSERT_TRUE(received > 0);
+
+    char text[80];
+    snprintf(text, sizeof(text), "%u published, %u received, %u dropped",
+             (unsigned)published, (unsigned)received, (unsigned)dropped);
+    TEST_MESSAGE(text);
+}
+
+static void test_histogram_buckets(void) {
+    TEST_ASSERT_EQUAL(0, FrameHistogram::get_bucket(0));
+    TEST_ASSERT_EQUAL(0, FrameHistogram::get_bucket(999));
+    TEST_ASSERT_EQUAL(1, FrameHistogram::get_bucket(1000));
+    TEST_ASSERT_EQUAL(1, FrameHistogram::get_bucket(1999));
+    TEST_ASSERT_EQUAL(4, FrameHistogram::get_bucket(12000));
+    TEST_ASSERT_EQUAL(6, FrameHistogram::get_bucket(63999));
+    TEST_ASSERT_EQUAL(7, FrameHistogram::get_bucket(64000));
+    TEST_ASSERT_EQUAL(7, FrameHistogram::get_bucket(0xFFFFFFFF));
+
+    TEST_ASSERT_EQUAL(1, FrameHistogram::get_bucket_ms(0));
+    TEST_ASSERT_EQUAL(64, FrameHistogram::get_bucket_ms(6));
+    TEST_ASSERT_EQUAL(0, FrameHistogram::get_bucket_ms(FrameHistogram::BUCKET_COUNT - 1));
+
+    FrameHistogram histogram;
+    histogram.add(1500);
+    histogram.add(1600);
+    histogram.add(100000);
+    TEST_ASSERT_EQUAL(0, histogram.get_count(0));
+    TEST_ASSERT_EQUAL(2, histogram.get_count(1));
+    TEST_ASSERT_EQUAL(1, histogram.get_count(7));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_swap_protocol);
+    RUN_TEST(test_reader_thread_sees_whole_newer_frames);
+    RUN_TEST(test_histogram_buckets);
+    return UNITY_END();
+}
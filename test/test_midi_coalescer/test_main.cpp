@@ -0,0 +1,187 @@
+#include <unity.h>
+#include <stdio.h>
+#include <chrono>
+#include "midi/midi_coalescer.h"
+
+static MidiCoalescer coalescer;
+
+void setUp(void) {
+    coalescer.reset();
+}
+
+void tearDown(void) {}
+
+static MidiMessage message(uint8_t status, uint8_t data1, uint8_t data2, uint32_t time_us = 0) {
+    MidiMessage m = {time_us, status, data1, data2};
+    return m;
+}
+
+static void test_latest_value_wins(void) {
+    TEST_ASSERT_TRUE(coalescer.push(message(0xB0, 74, 10, 100)));
+    TEST_ASSERT_TRUE(coalescer.push(message(0xB0, 74, 20, 200)));
+    TEST_ASSERT_TRUE(coalescer.push(message(0xB0, 74, 30, 300)));
+    TEST_ASSERT_TRUE(coalescer.is_pending());
+
+    MidiMessage out;
+    TEST_ASSERT_TRUE(coalescer.pop(&out));
+    TEST_ASSERT_EQUAL_HEX8(0xB0, out.status);
+    TEST_ASSERT_EQUAL(74, out.data1);
+    TEST_ASSERT_EQUAL(30, out.data2);
+    TEST_ASSERT_EQUAL(300, out.time_us);
+    TEST_ASSERT_FALSE(coalescer.pop(&out));
+    TEST_ASSERT_FALSE(coalescer.is_pending());
+
+    TEST_ASSERT_EQUAL(3, coalescer.get_absorbed());
+    TEST_ASSERT_EQUAL(2, coalescer.get_coalesced());
+}
+
+static void test_pop_order(void) {
+    // Channel 3 CCs, pitch bend and aftertouch, channel 1 CC
+    coalescer.push(message(0xB2, 100, 1));
+    coalescer.push(message(0xB2, 7, 2));
+    coalescer.push(message(0xD2, 55, 0));
+    coalescer.push(message(0xE2, 0x11, 0x22));
+    coalescer.push(message(0xB0, 64, 127));
+
+    const uint8_t expected[][3] = {
+        {0xB0, 64, 127},
+        {0xE2, 0x11, 0x22},
+        {0xD2, 55, 0},
+        {0xB2, 7, 2},
+        {0xB2, 100, 1},
+    };
+    MidiMessage out;
+    for (const auto& e : expected) {
+        TEST_ASSERT_TRUE(coalescer.pop(&out));
+        TEST_ASSERT_EQUAL_HEX8(e[0], out.status);
+        TEST_ASSERT_EQUAL(e[1], out.data1);
+        TEST_ASSERT_EQUAL(e[2], out.data2);
+    }
+    TEST_ASSERT_FALSE(coalescer.pop(&out));
+}
+
+static void test_other_messages_pass(void) {
+    TEST_ASSERT_FALSE(coalescer.push(message(0x90, 60, 100)));
+    TEST_ASSERT_FALSE(coalescer.push(message(0x80, 60, 0)));
+    TEST_ASSERT_FALSE(coalescer.push(message(0xC0, 5, 0)));
+    TEST_ASSERT_FALSE(coalescer.push(message(0xA0, 60, 10))); // Poly aftertouch keeps its note
+    TEST_ASSERT_FALSE(coalescer.push(message(0xF8, 0, 0)));
+    TEST_ASSERT_FALSE(coalescer.is_pending());
+    TEST_ASSERT_EQUAL(0, coalescer.get_absorbed());
+}
+
+static void test_pop_channel(void) {
+    coalescer.push(message(0xB0, 1, 1));
+    coalescer.push(message(0xE4, 0, 0x40));
+
+    MidiMessage out;
+    TEST_ASSERT_FALSE(coalescer.pop_channel(2, &out));
+    TEST_ASSERT_FALSE(coalescer.pop_channel(0, &out));
+    TEST_ASSERT_FALSE(coalescer.pop_channel(17, &out));
+    TEST_ASSERT_TRUE(coalescer.pop_channel(5, &out));
+    TEST_ASSERT_EQUAL_HEX8(0xE4, out.status);
+    TEST_ASSERT_FALSE(coalescer.pop_channel(5, &out));
+
+    TEST_ASSERT_TRUE(coalescer.pop(&out));
+    TEST_ASSERT_EQUAL_HEX8(0xB0, out.status);
+    TEST_ASSERT_FALSE(coalescer.is_pending());
+}
+
+static void test_all_controllers_of_a_channel(void) {
+    for (int round = 0; round < 2; round++) {
+        for (uint8_t cc = 0; cc < 128; cc++) {
+            coalescer.push(message(0xBF, cc, (uint8_t)(cc ^ round)));
+        }
+    }
+    MidiMessage out;
+    for (uint8_t cc = 0; cc < 128; cc++) {
+        TEST_ASSERT_TRUE(coalescer.pop(&out));
+        TEST_ASSERT_EQUAL_HEX8(0xBF, out.status);
+        TEST_ASSERT_EQUAL(cc, out.data1);
+        TEST_ASSERT_EQUAL(cc ^ 1, out.data2);
+    }
+    TEST_ASSERT_FALSE(coalescer.pop(&out));
+    TEST_ASSERT_EQUAL(128, coalescer.get_coalesced());
+}
+
+// Handler calls for messages_per_s controller messages spread over channels,
+// flushed every flush_ticks ticks at MOZZI_CONTROL_RATE 1024
+static uint32_t handler_calls(uint32_t messages_per_s, uint32_t streams, uint32_t flush_ticks) {
+    const uint32_t TICK_US = 1000000 / 1024;
+    const uint32_t SECONDS = 10;
+    coalescer.reset();
+
+    uint32_t calls = 0;
+    uint32_t tick = 0;
+    uint64_t next_tick_us = TICK_US;
+    MidiMessage out;
+    for (uint32_t i = 0; i < messages_per_s * SECONDS; i++) {
+        uint64_t time_us = (uint64_t)i * 1000000 / messages_per_s;
+        while (time_us >= next_tick_us) {
+            if (++tick >= flush_ticks) {
+                tick = 0;
+                while (coalescer.pop(&out)) calls++;
+            }
+            next_tick_us += TICK_US;
+        }
+        uint32_t stream = i % streams;
+        coalescer.push(message(0xB0 | (stream & 0x0F), 1 + stream / 16, i & 0x7F, (uint32_t)time_us));
+    }
+    while (coalescer.pop(&out)) calls++;
+    return calls;
+}
+
+static void test_saved_handler_calls(void) {
+    // A full speed DIN stream (3 byte messages at 31250 baud) of one knob and of
+    // four knobs, and a dense USB like stream of four knobs
+    struct Case { uint32_t rate; uint32_t streams; const char* name; };
+    const Case cases[] = {
+        {1041, 1, "DIN, 1 controller"},
+        {1041, 4, "DIN, 4 controllers"},
+        {8000, 4, "8k msg/s, 4 controllers"},
+    };
+
+    for (const Case& c : cases) {
+        uint32_t messages = c.rate * 10;
+        uint32_t every_tick = handler_calls(c.rate, c.streams, 1);
+        uint32_t every_4 = handler_calls(c.rate, c.streams, 4);
+        TEST_ASSERT_LESS_OR_EQUAL(messages, every_tick);
+        TEST_ASSERT_LESS_OR_EQUAL(every_tick, every_4);
+
+        char text[120];
+        snprintf(text, sizeof(text), "%s: %u messages, %u handler calls flushing every tick, %u every 4 ticks",
+                 c.name, (unsigned)messages, (unsigned)every_tick, (unsigned)every_4);
+        TEST_MESSAGE(text);
+    }
+}
+
+static void test_throughput(void) {
+    const uint32_t COUNT = 4000000;
+    MidiMessage out;
+    uint32_t calls = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < COUNT; i++) {
+        coalescer.push(message(0xB0 | (i & 3), 1 + (i & 7), i & 0x7F, i));
+        if ((i & 15) == 15) {
+            while (coalescer.pop(&out)) calls++;
+        }
+    }
+    auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    TEST_ASSERT_GREATER_THAN(0, calls);
+
+    char text[80];
+    snprintf(text, sizeof(text), "host push and pop: %.1f ns per message", elapsed / COUNT);
+    TEST_MESSAGE(text);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_latest_value_wins);
+    RUN_TEST(test_pop_order);
+    RUN_TEST(test_other_messages_pass);
+    RUN_TEST(test_pop_channel);
+    RUN_TEST(test_all_controllers_of_a_channel);
+    RUN_TEST(test_saved_handler_calls);
+    RUN_TEST(test_throughput);
+    return UNITY_END();
+}
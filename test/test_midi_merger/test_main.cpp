@@ -0,0 +1,161 @@
+#include <unity.h>
+#include <stdio.h>
+#include <vector>
+#include "midi/midi_merger.h"
+#include "midi/midi_parser.h"
+
+typedef std::vector<uint8_t> Bytes;
+
+static MidiMerger merger;
+
+void setUp(void) {
+    merger.set_filter_timing(false);
+    merger.reset();
+}
+
+void tearDown(void) {}
+
+static Bytes drain(uint64_t now_us) {
+    Bytes out;
+    uint8_t byte;
+    while (merger.pop(now_us, &byte)) out.push_back(byte);
+    return out;
+}
+
+static void push_all(const Bytes& bytes) {
+    for (uint8_t byte : bytes) merger.push_thru(byte);
+}
+
+static void assert_bytes(const Bytes& expected, const Bytes& actual) {
+    TEST_ASSERT_EQUAL(expected.size(), actual.size());
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected.data(), actual.data(), expected.size());
+}
+
+static void test_realtime_interleaved_with_running_status(void) {
+    // Notes and controllers in running status, a generated clock due before every thru byte
+    const Bytes in = {0x90, 60, 100, 62, 100, 64, 0, 0xB0, 7, 127, 8, 1};
+    Bytes out;
+    uint64_t now_us = 0;
+    for (uint8_t byte : in) {
+        merger.push_realtime(0xF8);
+        merger.push_thru(byte);
+        Bytes sent = drain(now_us);
+        out.insert(out.end(), sent.begin(), sent.end());
+        now_us += 1000;
+    }
+    TEST_ASSERT_EQUAL(2 * in.size(), out.size());
+    TEST_ASSERT_EQUAL_HEX8(0xF8, out[0]);
+
+    // The receiving end still sees the same channel messages
+    MidiParser parser;
+    std::vector<MidiMessage> messages;
+    int clocks = 0;
+    MidiMessage message;
+    for (uint8_t byte : out) {
+        if (!parser.feed(byte, 0, &message)) continue;
+        if (message.status == 0xF8) {
+            clocks++;
+        } else {
+            messages.push_back(message);
+        }
+    }
+    TEST_ASSERT_EQUAL(12, clocks);
+    TEST_ASSERT_EQUAL(5, messages.size());
+    TEST_ASSERT_EQUAL_HEX8(0x90, messages[1].status);
+    TEST_ASSERT_EQUAL(62, messages[1].data1);
+    TEST_ASSERT_EQUAL(64, messages[2].data1);
+    TEST_ASSERT_EQUAL(0, messages[2].data2);
+    TEST_ASSERT_EQUAL_HEX8(0xB0, messages[4].status);
+    TEST_ASSERT_EQUAL(8, messages[4].data1);
+    TEST_ASSERT_EQUAL(0, parser.get_dropped_bytes());
+}
+
+static void test_timing_filter(void) {
+    // Start, clock inside a running status note, song position with a clock
+    // between its data bytes, continue, active sensing and stop
+    merger.set_filter_timing(true);
+    push_all({0xFA, 0x90, 60, 0xF8, 100, 0xF2, 0x10, 0xF8, 0x02, 0xFB, 0x90, 61, 100, 0xFE, 0xFC});
+    assert_bytes({0x90, 60, 100, 0x90, 61, 100, 0xFE}, drain(0));
+
+    // A new status ends the skipped song position
+    push_all({0xF2, 0x01, 0x90, 60, 100});
+    assert_bytes({0x90, 60, 100}, drain(0));
+
+    // Without the filter everything passes unchanged
+    merger.set_filter_timing(false);
+    const Bytes in = {0xFA, 0xF2, 1, 2, 0xF8, 0x80, 60, 0};
+    push_all(in);
+    assert_bytes(in, drain(0));
+}
+
+static void test_thru_held_for_due_clock(void) {
+    merger.set_next_realtime_us(1000);
+    push_all({0x40, 0x40, 0x40, 0x40});
+
+    // The third byte ends at 960 us, the fourth would still be sending at 1000
+    TEST_ASSERT_EQUAL(3, drain(0).size());
+    TEST_ASSERT_EQUAL_UINT64(3 * MidiMerger::BYTE_US, merger.get_line_free_us());
+    TEST_ASSERT_EQUAL(0, drain(900).size());
+
+    merger.push_realtime(0xF8);
+    assert_bytes({0xF8}, drain(1000));
+    merger.set_next_realtime_us(21000);
+    assert_bytes({0x40}, drain(1010));
+
+    // A due time more than a byte in the past holds nothing
+    merger.set_next_realtime_us(1000);
+    merger.push_thru(0x40);
+    TEST_ASSERT_EQUAL(1, drain(2000).size());
+}
+
+static void test_buffers_full(void) {
+    for (size_t i = 0; i < MidiMerger::THRU_SIZE - 1; i++) {
+        TEST_ASSERT_TRUE(merger.push_thru(0x40));
+    }
+    TEST_ASSERT_FALSE(merger.push_thru(0x40));
+    TEST_ASSERT_EQUAL(1, merger.get_dropped_bytes());
+
+    for (size_t i = 0; i < MidiMerger::REALTIME_SIZE - 1; i++) {
+        TEST_ASSERT_TRUE(merger.push_realtime(0xF8));
+    }
+    TEST_ASSERT_FALSE(merger.push_realtime(0xF8));
+    // Only real-time bytes can be generated
+    merger.reset();
+    TEST_ASSERT_FALSE(merger.push_realtime(0x90));
+}
+
+static void test_clock_delay_under_full_thru_load(void) {
+    // Thru bytes arriving at the full line rate plus a 120 bpm clock
+    merger.set_filter_timing(true);
+    const uint64_t interval = 20833;
+    uint64_t next = interval;
+    uint64_t worst = 0;
+    merger.set_next_realtime_us(next);
+    for (uint64_t t = 0; t < 2000000; t += 10) {
+        if (t % MidiMerger::BYTE_US == 0) merger.push_thru(0x40);
+        if (t >= next) {
+            uint64_t start = merger.get_line_free_us() > t ? merger.get_line_free_us() : t;
+            if (start - next > worst) worst = start - next;
+            merger.push_realtime(0xF8);
+            next += interval;
+            drain(t);
+            merger.set_next_realtime_us(next);
+        }
+        drain(t);
+    }
+    TEST_ASSERT_TRUE(worst < 100);
+
+    char text[60];
+    snprintf(text, sizeof(text), "worst clock delay %llu us", (unsigned long long)worst);
+    TEST_MESSAGE(text);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_realtime_interleaved_with_running_status);
+    RUN_TEST(test_timing_filter);
+    RUN_TEST(test_thru_held_for_due_clock);
+    RUN_TEST(test_buffers_full);
+    RUN_TEST(test_clock_delay_under_full_thru_load);
+    return UNITY_END();
+}
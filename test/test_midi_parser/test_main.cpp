@@ -0,0 +1,158 @@
+#include <unity.h>
+#include "midi/midi_parser.h"
+#include "midi/midi_receiver.h"
+
+// Feeds byte streams through the parser and the receiver ring like the
+// UART event task does, one microsecond apart unless given otherwise.
+
+static MidiParser parser;
+static MidiMessage messages[64];
+static int message_count;
+
+void setUp(void) {
+    parser = MidiParser();
+    message_count = 0;
+}
+void tearDown(void) {}
+
+static void feed(const uint8_t* bytes, size_t count, uint32_t start_us = 1000) {
+    for (size_t i = 0; i < count; i++) {
+        MidiMessage message;
+        if (parser.feed(bytes[i], start_us + i, &message)) {
+            TEST_ASSERT_TRUE(message_count < 64);
+            messages[message_count++] = message;
+        }
+    }
+}
+
+static void check_message(int index, uint8_t status, uint8_t data1, uint8_t data2) {
+    TEST_ASSERT_EQUAL_HEX8(status, messages[index].status);
+    TEST_ASSERT_EQUAL_HEX8(data1, messages[index].data1);
+    TEST_ASSERT_EQUAL_HEX8(data2, messages[index].data2);
+}
+
+static void test_running_status(void) {
+    // Note on, two more notes under running status, program change, then its running status
+    const uint8_t bytes[] = {0x90, 60, 100, 62, 90, 64, 0, 0xC1, 5, 6};
+    feed(bytes, sizeof(bytes));
+
+    TEST_ASSERT_EQUAL(5, message_count);
+    check_message(0, 0x90, 60, 100);
+    check_message(1, 0x90, 62, 90);
+    check_message(2, 0x90, 64, 0);
+    check_message(3, 0xC1, 5, 0);
+    check_message(4, 0xC1, 6, 0);
+    TEST_ASSERT_EQUAL(0, parser.get_dropped_bytes());
+}
+
+static void test_realtime_inside_message(void) {
+    // Clock, start and stop between the bytes of a note on, the note is still complete
+    const uint8_t bytes[] = {0x90, 0xF8, 60, 0xFA, 100, 0xFC, 61, 0xF8, 80};
+    feed(bytes, sizeof(bytes));
+
+    TEST_ASSERT_EQUAL(6, message_count);
+    check_message(0, 0xF8, 0, 0);
+    check_message(1, 0xFA, 0, 0);
+    check_message(2, 0x90, 60, 100);
+    check_message(3, 0xFC, 0, 0);
+    check_message(4, 0xF8, 0, 0);
+    check_message(5, 0x90, 61, 80);
+    TEST_ASSERT_EQUAL(0, parser.get_dropped_bytes());
+}
+
+static void test_sysex_skipped(void) {
+    // Data inside SysEx is neither a message nor dropped, a clock inside it still passes
+    const uint8_t bytes[] = {0x90, 60, 100, 0xF0, 0x7E, 0x10, 0xF8, 0x22, 0xF7, 0x80, 60, 0};
+    feed(bytes, sizeof(bytes));
+
+    TEST_ASSERT_EQUAL(3, message_count);
+    check_message(0, 0x90, 60, 100);
+    check_message(1, 0xF8, 0, 0);
+    check_message(2, 0x80, 60, 0);
+    TEST_ASSERT_EQUAL(0, parser.get_dropped_bytes());
+
+    // Running status does not survive SysEx
+    const uint8_t after[] = {0xF0, 1, 2, 0xF7, 62, 100};
+    feed(after, sizeof(after));
+    TEST_ASSERT_EQUAL(3, message_count);
+    TEST_ASSERT_EQUAL(2, parser.get_dropped_bytes());
+}
+
+static void test_stray_bytes_dropped(void) {
+    // Data without a status, an unfinished message cut by a new status, undefined statuses
+    const uint8_t bytes[] = {10, 20, 0xB0, 7, 0x90, 60, 100, 0xF4, 1, 0xFD, 0xE0, 0, 64};
+    feed(bytes, sizeof(bytes));
+
+    TEST_ASSERT_EQUAL(2, message_count);
+    check_message(0, 0x90, 60, 100);
+    check_message(1, 0xE0, 0, 64);
+    // 10, 20, the 7 cut short, 0xF4 and its data byte, 0xFD
+    TEST_ASSERT_EQUAL(6, parser.get_dropped_bytes());
+
+    // System common messages cancel running status
+    const uint8_t common[] = {0xF2, 0x10, 0x02, 0x11};
+    feed(common, sizeof(common));
+    TEST_ASSERT_EQUAL(3, message_count);
+    check_message(2, 0xF2, 0x10, 0x02);
+    TEST_ASSERT_EQUAL(7, parser.get_dropped_bytes());
+}
+
+static void test_timestamp_of_last_byte(void) {
+    const uint8_t bytes[] = {0x90, 60, 0xF8, 100, 62, 90};
+    feed(bytes, sizeof(bytes), 5000);
+
+    TEST_ASSERT_EQUAL(3, message_count);
+    TEST_ASSERT_EQUAL_UINT32(5002, messages[0].time_us); // Clock
+    TEST_ASSERT_EQUAL_UINT32(5003, messages[1].time_us); // Note completed by its velocity
+    TEST_ASSERT_EQUAL_UINT32(5005, messages[2].time_us); // Running status note
+}
+
+static void test_receiver_overrun(void) {
+    static MidiReceiver receiver;
+
+    // Fill the ring with notes, one slot is never used
+    const int capacity = MidiReceiver::RING_SIZE - 1;
+    TEST_ASSERT_TRUE(receiver.receive(0x90, 0));
+    for (int i = 0; i < capacity; i++) {
+        TEST_ASSERT_TRUE(receiver.receive(i & 0x7F, 2 * i + 1));
+        TEST_ASSERT_TRUE(receiver.receive(100, 2 * i + 2));
+    }
+    TEST_ASSERT_EQUAL(0, receiver.get_overruns());
+
+    // A note and a clock find the ring full, bytes that complete nothing are not overruns
+    TEST_ASSERT_TRUE(receiver.receive(1, 10000));
+    TEST_ASSERT_FALSE(receiver.receive(2, 10001));
+    TEST_ASSERT_FALSE(receiver.receive(0xF8, 10002));
+    TEST_ASSERT_EQUAL(2, receiver.get_overruns());
+    TEST_ASSERT_EQUAL(3 + 1, receiver.get_dropped_bytes());
+    receiver.count_overrun();
+    TEST_ASSERT_EQUAL(3, receiver.get_overruns());
+
+    // Queued messages come out in order with their timestamps, then new ones fit again
+    MidiMessage message;
+    for (int i = 0; i < capacity; i++) {
+        TEST_ASSERT_TRUE(receiver.read(&message));
+        TEST_ASSERT_EQUAL_HEX8(0x90, message.status);
+        TEST_ASSERT_EQUAL_HEX8(i & 0x7F, message.data1);
+        TEST_ASSERT_EQUAL_UINT32(2 * i + 2, message.time_us);
+    }
+    TEST_ASSERT_FALSE(receiver.read(&message));
+
+    TEST_ASSERT_TRUE(receiver.receive(3, 20000));
+    TEST_ASSERT_TRUE(receiver.receive(4, 20001));
+    TEST_ASSERT_TRUE(receiver.read(&message));
+    TEST_ASSERT_EQUAL_HEX8(3, message.data1);
+    TEST_ASSERT_EQUAL_UINT32(20001, message.time_us);
+    TEST_ASSERT_EQUAL(3, receiver.get_overruns());
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_running_status);
+    RUN_TEST(test_realtime_inside_message);
+    RUN_TEST(test_sysex_skipped);
+    RUN_TEST(test_stray_bytes_dropped);
+    RUN_TEST(test_timestamp_of_last_byte);
+    RUN_TEST(test_receiver_overrun);
+    return UNITY_END();
+}
@@ -0,0 +1,161 @@
+#include <unity.h>
+#include <string.h>
+#include "midi/midi_routing.h"
+
+// Compares the routing table with the per message checks it replaced in
+// SignalProcessor, for every output type and output channel.
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// Previous SignalProcessor::is_out_channel_match()
+static bool reference_channel_match(const MidiSettingsData& settings, size_t out, uint8_t channel) {
+    if (settings.midi_out_channel[out] == MidiChannelUnchanged) {
+        return (settings.midi_channel == channel) || (settings.midi_channel == MidiChannelAll);
+    }
+    return (settings.midi_out_channel[out] == channel) || (settings.midi_out_channel[out] == MidiChannelAll);
+}
+
+static bool reference_is_mozzi(const MidiSettingsData& settings, size_t out) {
+    return OUT_CHANNELS[out].type == OutTypeMozzi && settings.midi_out_type[out] == MidiOutMozzi;
+}
+
+// Outputs the previous handlers wrote to or passed on as Mozzi events
+static bool reference_note(const MidiSettingsData& settings, size_t out, uint8_t channel) {
+    MidiOutType type = settings.midi_out_type[out];
+    return reference_channel_match(settings, out, channel) &&
+           (type == MidiOutGate || type == MidiOutPitch || type == MidiOutVelocity || reference_is_mozzi(settings, out));
+}
+
+static bool reference_cc(const MidiSettingsData& settings, size_t out, uint8_t channel, uint8_t cc) {
+    MidiOutType type = settings.midi_out_type[out];
+    return reference_channel_match(settings, out, channel) &&
+           (type == MidiOutCc0 + cc || reference_is_mozzi(settings, out));
+}
+
+static bool reference_aftertouch(const MidiSettingsData& settings, size_t out, uint8_t channel) {
+    MidiOutType type = settings.midi_out_type[out];
+    return reference_channel_match(settings, out, channel) &&
+           (type == MidiOutAfterTouch || reference_is_mozzi(settings, out));
+}
+
+static bool reference_pitchbend(const MidiSettingsData& settings, size_t out, uint8_t channel) {
+    MidiOutType type = settings.midi_out_type[out];
+    return reference_channel_match(settings, out, channel) &&
+           (type == MidiOutPitch || type == MidiOutPitchBend || reference_is_mozzi(settings, out));
+}
+
+static MidiRouting::Action reference_action(const MidiSettingsData& settings, size_t out) {
+    MidiOutType type = settings.midi_out_type[out];
+    switch (type) {
+        case MidiOutGate: return MidiRouting::ActionGate;
+        case MidiOutPitch: return MidiRouting::ActionPitch;
+        case MidiOutVelocity: return MidiRouting::ActionVelocity;
+        case MidiOutAfterTouch: return MidiRouting::ActionAftertouch;
+        case MidiOutPitchBend: return MidiRouting::ActionPitchBend;
+        case MidiOutRun: return MidiRouting::ActionRun;
+        case MidiOutStop: return MidiRouting::ActionStop;
+        case MidiOutMozzi: return reference_is_mozzi(settings, out) ? MidiRouting::ActionMozzi : MidiRouting::ActionNone;
+        default: break;
+    }
+    if (is_clock_out_type(type)) return MidiRouting::ActionClock;
+    if (type >= MidiOutCc0 && type <= MidiOutCc127) return MidiRouting::ActionCc;
+    return MidiRouting::ActionNone;
+}
+
+static void settings_for(MidiSettingsData* settings, MidiOutType type, MidiChannel out_channel, MidiChannel channel) {
+    memset(settings, 0, sizeof(*settings));
+    settings->bpm = 120;
+    settings->midi_channel = channel;
+    for (size_t i = 0; i < OutChannelCount; i++) {
+        settings->midi_out_type[i] = type;
+        settings->midi_out_channel[i] = out_channel;
+        settings->clock_ratio[i] = {3, 2, 0, 10};
+    }
+}
+
+static void check_routing(const MidiSettingsData& settings, const MidiRouting& routing) {
+    for (size_t out = 0; out < OutChannelCount; out++) {
+        uint8_t bit = 1 << out;
+        MidiOutType type = settings.midi_out_type[out];
+
+        TEST_ASSERT_EQUAL(reference_action(settings, out), routing.action[out]);
+        TEST_ASSERT_EQUAL(is_clock_out_type(type), (routing.clock_mask & bit) != 0);
+        TEST_ASSERT_EQUAL(type == MidiOutRun, (routing.run_mask & bit) != 0);
+        TEST_ASSERT_EQUAL(type == MidiOutStop, (routing.stop_mask & bit) != 0);
+
+        for (uint8_t ch = MidiChannel1; ch <= MidiChannel16; ch++) {
+            TEST_ASSERT_EQUAL(reference_note(settings, out, ch), (routing.note_mask[ch] & bit) != 0);
+            TEST_ASSERT_EQUAL(reference_aftertouch(settings, out, ch), (routing.aftertouch_mask[ch] & bit) != 0);
+            TEST_ASSERT_EQUAL(reference_pitchbend(settings, out, ch), (routing.pitchbend_mask[ch] & bit) != 0);
+            for (uint8_t cc = 0; cc < MidiRouting::CC_COUNT; cc++) {
+                TEST_ASSERT_EQUAL(reference_cc(settings, out, ch, cc), (routing.cc_mask[ch][cc] & bit) != 0);
+            }
+        }
+    }
+}
+
+static void test_every_type_and_output_channel(void) {
+    // The global channel only matters for MidiChannelUnchanged, a few values cover it
+    const MidiChannel channels[] = {MidiChannel1, MidiChannel10, MidiChannelAll};
+
+    static MidiRouting routing;
+    for (int type = MidiOutClock1_4; type <= MidiOutClockRatio; type++) {
+        for (int out_channel = MidiChannelUnchanged; out_channel <= MidiChannelAll; out_channel++) {
+            for (MidiChannel channel : channels) {
+                MidiSettingsData settings;
+                settings_for(&settings, (MidiOutType)type, (MidiChannel)out_channel, channel);
+                routing.compile(settings);
+                check_routing(settings, routing);
+            }
+        }
+    }
+}
+
+static void test_clock_divisions(void) {
+    static MidiRouting routing;
+    for (int type = MidiOutClock1_4; type <= MidiOutClockRatio; type++) {
+        if (!is_clock_out_type((MidiOutType)type)) continue;
+
+        MidiSettingsData settings;
+        settings_for(&settings, (MidiOutType)type, MidiChannelAll, MidiChannelAll);
+        routing.compile(settings);
+        for (size_t out = 0; out < OutChannelCount; out++) {
+            if (type == MidiOutClockRatio) {
+                TEST_ASSERT_EQUAL(3, routing.clock_mul[out]);
+                TEST_ASSERT_EQUAL(2, routing.clock_div[out]);
+            } else {
+                // Pulses per beat times the previous ticks per pulse is one beat
+                TEST_ASSERT_EQUAL(1, routing.clock_div[out]);
+                TEST_ASSERT_EQUAL(24, routing.clock_mul[out] * get_clock_out_division_ticks((MidiOutType)type));
+            }
+        }
+    }
+}
+
+static void test_mixed_outputs(void) {
+    // Every output on its own type and channel
+    MidiSettingsData settings;
+    settings_for(&settings, MidiOutGate, MidiChannelUnchanged, MidiChannel3);
+    settings.midi_out_type[0] = MidiOutMozzi;
+    settings.midi_out_type[1] = (MidiOutType)(MidiOutCc0 + 74);
+    settings.midi_out_channel[1] = MidiChannel2;
+    settings.midi_out_type[2] = MidiOutMozzi; // Not a Mozzi output, ignored
+    settings.midi_out_type[3] = MidiOutClock1_16T;
+    settings.midi_out_type[4] = MidiOutPitch;
+    settings.midi_out_channel[4] = MidiChannelAll;
+
+    static MidiRouting routing;
+    routing.compile(settings);
+    check_routing(settings, routing);
+    TEST_ASSERT_EQUAL(MidiRouting::ActionNone, routing.action[2]);
+    TEST_ASSERT_EQUAL(1 << 1, routing.cc_mask[MidiChannel2][74] & ~1);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_every_type_and_output_channel);
+    RUN_TEST(test_clock_divisions);
+    RUN_TEST(test_mixed_outputs);
+    return UNITY_END();
+}
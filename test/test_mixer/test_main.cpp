@@ -0,0 +1,188 @@
+#include <unity.h>
+#include <math.h>
+#include <stdio.h>
+#include <chrono>
+#include "board.h"
+#include "osc/mixer.h"
+
+// Checks the fixed point mixer against the same mix done in double
+// precision, and reports the render cost per sample on the host.
+
+static Mixer mixer;
+
+// Render cost budget: the share of a sample period the voices may take on the
+// audio core, and how much slower than the host the 240 MHz ESP32 is assumed to
+// run. The NUM_OSCS choice in osc/osc.h rests on this, DEBUG_TASK_LOAD checks it.
+const double RENDER_BUDGET_SHARE = 0.5;
+const int TARGET_SLOWDOWN = 100;
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static uint32_t rng_state = 1;
+static uint32_t rng(void) {
+    rng_state = rng_state * 1664525u + 1013904223u;
+    return rng_state >> 8;
+}
+
+static double reference_curve(double x) {
+    double y = fabs(x);
+    if (y > Mixer::CLIP_KNEE) {
+        const double headroom = 127 - Mixer::CLIP_KNEE;
+        y = Mixer::CLIP_KNEE + headroom * tanh((y - Mixer::CLIP_KNEE) / headroom);
+    }
+    return x < 0 ? -y : y;
+}
+
+static void test_clip_table_matches_tanh(void) {
+    for (int i = 0; i < 2 * Mixer::CLIP_RANGE; i++) {
+        int x = i - Mixer::CLIP_RANGE;
+        TEST_ASSERT_EQUAL_INT8(lround(reference_curve(x)), mixer.clip_lut[i]);
+    }
+
+    // Linear below the knee, odd, monotonic and never past 127
+    for (int x = -Mixer::CLIP_KNEE; x <= Mixer::CLIP_KNEE; x++) {
+        TEST_ASSERT_EQUAL(x, mixer.clip_lut[x + Mixer::CLIP_RANGE]);
+    }
+    for (int x = 1; x < Mixer::CLIP_RANGE; x++) {
+        TEST_ASSERT_EQUAL(-mixer.clip_lut[x + Mixer::CLIP_RANGE], mixer.clip_lut[-x + Mixer::CLIP_RANGE]);
+        TEST_ASSERT_GREATER_OR_EQUAL(mixer.clip_lut[x - 1 + Mixer::CLIP_RANGE], mixer.clip_lut[x + Mixer::CLIP_RANGE]);
+    }
+    TEST_ASSERT_EQUAL(-127, mixer.clip_lut[0]);
+}
+
+static void test_norm_table_is_inverse_sqrt(void) {
+    TEST_ASSERT_EQUAL(1 << Mixer::NORM_BITS, mixer.get_norm(0));
+    for (int n = 1; n <= Mixer::MAX_VOICES; n++) {
+        TEST_ASSERT_EQUAL(lround((1 << Mixer::NORM_BITS) / sqrt((double)n)), mixer.get_norm(n));
+    }
+    TEST_ASSERT_EQUAL(mixer.get_norm(Mixer::MAX_VOICES), mixer.get_norm(Mixer::MAX_VOICES + 4));
+}
+
+static void test_single_voice_is_exact(void) {
+    // One voice at full gain passes the linear part of the table unchanged
+    for (int s = -Mixer::CLIP_KNEE; s <= Mixer::CLIP_KNEE; s++) {
+        TEST_ASSERT_EQUAL(s, mixer.out(s * Mixer::GAIN_ONE, mixer.get_norm(1)));
+    }
+}
+
+static void test_mix_matches_double_reference(void) {
+    // Random voice counts, samples and velocities. The sum is truncated to 24 bits
+    // before the normalization, so the table index can be one step off the rounded reference.
+    const int rounds = 200000;
+    int exact = 0;
+    for (int round = 0; round < rounds; round++) {
+        int voices = 1 + rng() % 8;
+        int32_t sum = 0;
+        double reference = 0;
+        for (int v = 0; v < voices; v++) {
+            int8_t sample = (int8_t)(rng() & 0xFF);
+            int16_t gain = (int32_t)(rng() % 128) * Mixer::GAIN_ONE / 127;
+            sum += sample * gain;
+            reference += sample * (double)gain / 32768.0;
+        }
+        int16_t norm = mixer.get_norm(voices);
+        reference *= norm / (double)(1 << Mixer::NORM_BITS);
+        if (reference < -Mixer::CLIP_RANGE) reference = -Mixer::CLIP_RANGE;
+        if (reference > Mixer::CLIP_RANGE - 1) reference = Mixer::CLIP_RANGE - 1;
+
+        int8_t fixed = mixer.out(sum, norm);
+        int8_t expected = mixer.clip_lut[lround(reference) + Mixer::CLIP_RANGE];
+        TEST_ASSERT_INT_WITHIN(1, expected, fixed);
+        TEST_ASSERT_INT_WITHIN(1, lround(reference_curve(reference)), fixed);
+        if (fixed == expected) exact++;
+    }
+
+    char message[80];
+    snprintf(message, sizeof(message), "%d of %d mixes equal the rounded double reference", exact, rounds);
+    TEST_MESSAGE(message);
+}
+
+// Host time of render_audio() for a number of voices per channel: table oscillator,
+// envelope ramp and mix of both channels, blocks of AUDIO_BLOCK_SIZE frames
+static double render_ns_per_sample(int voices, int32_t* checksum) {
+    const size_t FRAMES = 32;
+    const int BLOCKS = 20000;
+    static int8_t table[256];
+    for (int i = 0; i < 256; i++) table[i] = (int8_t)lround(127 * sin(2 * M_PI * i / 256));
+
+    uint32_t phase[2][Mixer::MAX_VOICES], inc[2][Mixer::MAX_VOICES];
+    int32_t level[2][Mixer::MAX_VOICES], level_inc[2][Mixer::MAX_VOICES];
+    int16_t target[2][Mixer::MAX_VOICES];
+    for (int ch = 0; ch < 2; ch++) {
+        for (int i = 0; i < voices; i++) {
+            phase[ch][i] = 0;
+            inc[ch][i] = 60000 + 977 * i + 13 * ch;
+            level[ch][i] = 0;
+            target[ch][i] = 20000 + 100 * i;
+        }
+    }
+
+    int16_t left[FRAMES], right[FRAMES];
+    auto start = std::chrono::steady_clock::now();
+    for (int block = 0; block < BLOCKS; block++) {
+        int16_t norm = mixer.get_norm(voices);
+        for (int ch = 0; ch < 2; ch++) {
+            for (int i = 0; i < voices; i++) {
+                target[ch][i] ^= 0x100; // New envelope target every block
+                level_inc[ch][i] = (((int32_t)target[ch][i] << 16) - level[ch][i]) / (int32_t)FRAMES;
+            }
+        }
+        for (size_t n = 0; n < FRAMES; n++) {
+            int32_t l = 0;
+            int32_t r = 0;
+            for (int i = 0; i < voices; i++) {
+                phase[0][i] += inc[0][i];
+                phase[1][i] += inc[1][i];
+                l += table[(phase[0][i] >> 16) & 0xFF] * (level[0][i] >> 16);
+                r += table[(phase[1][i] >> 16) & 0xFF] * (level[1][i] >> 16);
+                level[0][i] += level_inc[0][i];
+                level[1][i] += level_inc[1][i];
+            }
+            left[n] = mixer.out(l, norm);
+            right[n] = mixer.out(r, norm);
+        }
+        for (int ch = 0; ch < 2; ch++) {
+            for (int i = 0; i < voices; i++) {
+                level[ch][i] = (int32_t)target[ch][i] << 16;
+            }
+        }
+        *checksum += left[block % FRAMES] + right[block % FRAMES];
+    }
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / (BLOCKS * FRAMES);
+}
+
+static void test_render_cost(void) {
+    // One stereo sample has to be rendered every 1 / MOZZI_AUDIO_RATE
+    const double budget_ns = 1e9 / PWM_FREQ;
+    int32_t checksum = 0;
+    double cost[Mixer::MAX_VOICES + 1];
+    char message[160];
+    for (int voices = 1; voices <= Mixer::MAX_VOICES; voices++) {
+        cost[voices] = render_ns_per_sample(voices, &checksum);
+        snprintf(message, sizeof(message), "host render: %2d voices per channel, %6.2f ns per stereo sample, %.2f%% of %.0f ns",
+                 voices, cost[voices], 100 * cost[voices] / budget_ns, budget_ns);
+        TEST_MESSAGE(message);
+    }
+
+    // Cost grows by a fixed amount per voice, the per block work is amortized
+    double per_voice = (cost[Mixer::MAX_VOICES] - cost[1]) / (Mixer::MAX_VOICES - 1);
+    double fixed = cost[1] - per_voice;
+    int max_voices = (int)((budget_ns * RENDER_BUDGET_SHARE / TARGET_SLOWDOWN - fixed) / per_voice);
+    if (max_voices > Mixer::MAX_VOICES) max_voices = Mixer::MAX_VOICES;
+    snprintf(message, sizeof(message), "per voice %.2f ns, fixed %.2f ns, fits %d voices per channel in %.0f%% of the budget at %dx host time (checksum %d)",
+             per_voice, fixed, max_voices, 100 * RENDER_BUDGET_SHARE, TARGET_SLOWDOWN, (int)checksum);
+    TEST_MESSAGE(message);
+}
+
+int main(void) {
+    mixer.begin();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_clip_table_matches_tanh);
+    RUN_TEST(test_norm_table_is_inverse_sqrt);
+    RUN_TEST(test_single_voice_is_exact);
+    RUN_TEST(test_mix_matches_double_reference);
+    RUN_TEST(test_render_cost);
+    return UNITY_END();
+}
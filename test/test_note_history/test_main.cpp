@@ -0,0 +1,293 @@
+#include <unity.h>
+#include <stdio.h>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include "midi/note_history.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// Held notes in push order with their ids, what the linked list kept
+struct ReferenceHistory
+{
+    std::vector<std::pair<uint8_t, uint8_t>> held;
+
+    bool push(uint8_t note, uint8_t* out_id) {
+        for (auto& h : held) if (h.first == note) return false;
+        uint8_t id = 0;
+        while (std::any_of(held.begin(), held.end(), [id](const std::pair<uint8_t, uint8_t>& h) { return h.second == id; })) id++;
+        held.push_back({note, id});
+        *out_id = id;
+        return true;
+    }
+
+    bool pop(uint8_t note, uint8_t* out_id) {
+        for (size_t i = 0; i < held.size(); i++) {
+            if (held[i].first == note) {
+                *out_id = held[i].second;
+                held.erase(held.begin() + i);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    uint8_t last() { return held.empty() ? NoteHistory::NO_NOTE : held.back().first; }
+    uint8_t highest() {
+        uint8_t n = NoteHistory::NO_NOTE;
+        for (auto& h : held) if (n == NoteHistory::NO_NOTE || h.first > n) n = h.first;
+        return n;
+    }
+    uint8_t lowest() {
+        uint8_t n = NoteHistory::NO_NOTE;
+        for (auto& h : held) if (h.first < n) n = h.first;
+        return n;
+    }
+};
+
+// The linked list NoteHistory this one replaced, without its logging, to time against.
+// Its pop() indexed history[NO_NOTE] when the oldest note went, here that is guarded.
+struct ListHistory
+{
+    static const uint8_t NO_NOTE = NoteHistory::NO_NOTE;
+    struct Note
+    {
+        uint8_t prev;
+        uint8_t next;
+        bool in_use;
+        uint8_t id;
+    };
+    Note history[127];
+    uint8_t last;
+    int count;
+
+    ListHistory() { reset(); }
+
+    void reset(void) {
+        for (Note& n : history) n = {NO_NOTE, NO_NOTE, false, 0};
+        last = NO_NOTE;
+        count = 0;
+    }
+
+    bool push(uint8_t note, uint8_t* out_id) {
+        if (history[note].in_use) return false;
+        uint8_t new_id = 0;
+        if (last != NO_NOTE) {
+            uint8_t used_ids[127];
+            uint8_t ids_count = 0;
+            uint8_t current = last;
+            do {
+                used_ids[ids_count++] = history[current].id;
+                current = history[current].prev;
+            } while (current != NO_NOTE);
+            std::sort(used_ids, used_ids + ids_count);
+            for (uint8_t i = 0; i < ids_count; i++) {
+                if (used_ids[i] != i) {
+                    new_id = i;
+                    break;
+                }
+                new_id = i + 1;
+            }
+        }
+        history[note] = {last, NO_NOTE, true, new_id};
+        if (last != NO_NOTE) history[last].next = note;
+        last = note;
+        count++;
+        *out_id = new_id;
+        return true;
+    }
+
+    bool pop(uint8_t note, uint8_t* out_id) {
+        if (!history[note].in_use) return false;
+        uint8_t prev = history[note].prev;
+        uint8_t next = history[note].next;
+        if (note != last) {
+            if (prev != NO_NOTE) history[prev].next = next;
+            history[next].prev = prev;
+        } else {
+            last = prev;
+            if (prev != NO_NOTE) history[prev].next = NO_NOTE;
+        }
+        *out_id = history[note].id;
+        history[note] = {NO_NOTE, NO_NOTE, false, 0};
+        count--;
+        return true;
+    }
+
+    uint8_t get_current(void) {
+        if (last == NO_NOTE) return NO_NOTE;
+        uint8_t max_note = last;
+        for (uint8_t current = history[last].prev; current != NO_NOTE; current = history[current].prev) {
+            if (current > max_note) max_note = current;
+        }
+        return max_note;
+    }
+};
+
+static uint32_t rng_state = 1;
+static uint32_t rng(void) {
+    rng_state = rng_state * 1664525u + 1013904223u;
+    return rng_state >> 8;
+}
+
+static void test_push_pop_ids(void) {
+    NoteHistory history;
+    uint8_t id;
+
+    TEST_ASSERT_TRUE(history.is_empty());
+    TEST_ASSERT_TRUE(history.push(60, &id));
+    TEST_ASSERT_EQUAL(0, id);
+    TEST_ASSERT_TRUE(history.push(64, &id));
+    TEST_ASSERT_EQUAL(1, id);
+    TEST_ASSERT_TRUE(history.push(67, &id));
+    TEST_ASSERT_EQUAL(2, id);
+    TEST_ASSERT_FALSE(history.push(64, &id));
+    TEST_ASSERT_EQUAL(3, history.get_count());
+
+    // The freed id is the lowest one and is reused first
+    TEST_ASSERT_TRUE(history.pop(64, &id));
+    TEST_ASSERT_EQUAL(1, id);
+    TEST_ASSERT_FALSE(history.pop(64, &id));
+    TEST_ASSERT_TRUE(history.push(72, &id));
+    TEST_ASSERT_EQUAL(1, id);
+
+    TEST_ASSERT_FALSE(history.push(128, &id));
+    TEST_ASSERT_FALSE(history.pop(200, &id));
+    TEST_ASSERT_FALSE(history.is_in_use(200));
+}
+
+static void test_priority_lookups(void) {
+    NoteHistory history;
+    TEST_ASSERT_EQUAL(NoteHistory::NO_NOTE, history.get_last());
+    TEST_ASSERT_EQUAL(NoteHistory::NO_NOTE, history.get_highest());
+    TEST_ASSERT_EQUAL(NoteHistory::NO_NOTE, history.get_lowest());
+
+    history.push(40, nullptr);
+    history.push(127, nullptr);
+    history.push(0, nullptr);
+    history.push(63, nullptr);
+    TEST_ASSERT_EQUAL(63, history.get_last());
+    TEST_ASSERT_EQUAL(127, history.get_highest());
+    TEST_ASSERT_EQUAL(0, history.get_lowest());
+
+    history.pop(63, nullptr);
+    TEST_ASSERT_EQUAL(0, history.get_last());
+    history.pop(127, nullptr);
+    TEST_ASSERT_EQUAL(40, history.get_highest());
+}
+
+static void test_order_depth_overflow(void) {
+    NoteHistory history;
+    for (uint8_t n = 0; n < NoteHistory::ORDER_DEPTH + 4; n++) {
+        history.push(n, nullptr);
+    }
+    TEST_ASSERT_EQUAL(NoteHistory::ORDER_DEPTH + 3, history.get_last());
+
+    // Once the remembered notes are released the last note falls back to the highest held
+    for (uint8_t n = 4; n < NoteHistory::ORDER_DEPTH + 4; n++) {
+        history.pop(n, nullptr);
+    }
+    TEST_ASSERT_EQUAL(4, history.get_count());
+    TEST_ASSERT_EQUAL(3, history.get_last());
+}
+
+static void test_matches_reference(void) {
+    // Random play on a narrow range so notes are often held twice or released unheld,
+    // at most ORDER_DEPTH notes held so the last note is always remembered
+    NoteHistory history;
+    ReferenceHistory reference;
+
+    for (int step = 0; step < 200000; step++) {
+        uint8_t note = 36 + rng() % 24;
+        uint8_t id = 0xFF, ref_id = 0xFF;
+
+        if ((rng() & 1) && reference.held.size() < NoteHistory::ORDER_DEPTH) {
+            TEST_ASSERT_EQUAL(reference.push(note, &ref_id), history.push(note, &id));
+        } else {
+            TEST_ASSERT_EQUAL(reference.pop(note, &ref_id), history.pop(note, &id));
+        }
+        TEST_ASSERT_EQUAL(ref_id, id);
+        TEST_ASSERT_EQUAL((int)reference.held.size(), history.get_count());
+        TEST_ASSERT_EQUAL(reference.last(), history.get_last());
+        TEST_ASSERT_EQUAL(reference.highest(), history.get_highest());
+        TEST_ASSERT_EQUAL(reference.lowest(), history.get_lowest());
+    }
+}
+
+static void test_all_notes_held(void) {
+    NoteHistory history;
+    uint8_t id;
+    for (int n = 0; n < (int)NoteHistory::MIDI_NOTES_COUNT; n++) {
+        TEST_ASSERT_TRUE(history.push(n, &id));
+        TEST_ASSERT_EQUAL(n, id);
+    }
+    TEST_ASSERT_EQUAL(127, history.get_highest());
+    TEST_ASSERT_EQUAL(0, history.get_lowest());
+
+    history.reset();
+    TEST_ASSERT_TRUE(history.is_empty());
+    TEST_ASSERT_FALSE(history.is_in_use(0));
+    TEST_ASSERT_EQUAL(NoteHistory::NO_NOTE, history.get_last());
+}
+
+// A chord pressed and released note by note in shuffled order, the current note
+// looked up after every event as handle_note_on/off do. Returns ns per event.
+template <typename History, typename Current>
+static double time_chords(History& history, const uint8_t* notes, int size, Current current, uint32_t* checksum) {
+    const int REPEATS = 20000 / size + 1;
+    uint8_t id;
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < REPEATS; r++) {
+        for (int i = 0; i < size; i++) {
+            history.push(notes[i], &id);
+            *checksum += id + current(history);
+        }
+        for (int i = size - 1; i >= 0; i--) {
+            history.pop(notes[(i * 7) % size], &id);
+            *checksum += id + current(history);
+        }
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    return ns / (REPEATS * 2.0 * size);
+}
+
+static void test_chord_benchmark(void) {
+    const int sizes[] = {10, 64, 127};
+    for (int size : sizes) {
+        // 7 is coprime to every size here, so (i * 7) % size releases each note once
+        uint8_t notes[127];
+        for (int i = 0; i < size; i++) notes[i] = (uint8_t)((i * 37 + 11) % 127);
+        std::sort(notes, notes + size);
+        for (int i = size - 1; i > 0; i--) std::swap(notes[i], notes[rng() % (i + 1)]);
+
+        static NoteHistory bitmap;
+        static ListHistory list;
+        bitmap.reset();
+        list.reset();
+        uint32_t bitmap_sum = 0;
+        uint32_t list_sum = 0;
+        double bitmap_ns = time_chords(bitmap, notes, size, [](NoteHistory& h) { return h.get_highest(); }, &bitmap_sum);
+        double list_ns = time_chords(list, notes, size, [](ListHistory& h) { return h.get_current(); }, &list_sum);
+
+        // Same ids and same current notes from both
+        TEST_ASSERT_EQUAL_UINT32(list_sum, bitmap_sum);
+        TEST_ASSERT_TRUE(bitmap.is_empty());
+
+        char text[100];
+        snprintf(text, sizeof(text), "%d note chord: %.1f ns per event with bitmaps, %.1f ns with the list",
+                 size, bitmap_ns, list_ns);
+        TEST_MESSAGE(text);
+    }
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_push_pop_ids);
+    RUN_TEST(test_priority_lookups);
+    RUN_TEST(test_order_depth_overflow);
+    RUN_TEST(test_matches_reference);
+    RUN_TEST(test_all_notes_held);
+    RUN_TEST(test_chord_benchmark);
+    return UNITY_END();
+}
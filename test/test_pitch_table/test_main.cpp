@@ -0,0 +1,90 @@
+#include <unity.h>
+#include <math.h>
+#include <stdio.h>
+#include "osc/pitch_table.h"
+
+// Pitch error of the note and bend tables against the equal tempered
+// frequency, in cents
+
+static const size_t CELLS = 256;
+static const uint32_t AUDIO_RATE = 32768; // PWM_FREQ
+static const float BEND_SEMITONES = 2.0f;
+
+static PitchTable table;
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static double phase_inc_to_freq(uint32_t inc) {
+    return (double)inc * AUDIO_RATE / CELLS / (1UL << PitchTable::PHASE_INC_BITS);
+}
+
+static double cents(double freq, double reference) {
+    return 1200.0 * log2(freq / reference);
+}
+
+static void test_note_table(void) {
+    double worst = 0;
+    for (int n = 0; n < 128; n++) {
+        double reference = 440.0 * pow(2.0, (n - 69) / 12.0);
+        double error = fabs(cents(phase_inc_to_freq(table.note_phase_inc[n]), reference));
+        if (error > worst) worst = error;
+        TEST_ASSERT_TRUE(error < 0.25);
+    }
+    // A4 lands on an exact increment at these rates
+    TEST_ASSERT_EQUAL_UINT32(440 * CELLS * 2, table.note_phase_inc[69]);
+
+    char message[60];
+    snprintf(message, sizeof(message), "note table worst error %.4f cents", worst);
+    TEST_MESSAGE(message);
+}
+
+static void test_bend_table(void) {
+    TEST_ASSERT_EQUAL(PitchTable::BEND_NONE, table.bend_ratio(0));
+
+    double worst = 0;
+    uint16_t previous = 0;
+    for (int value = -8192; value <= 8191; value++) {
+        uint16_t ratio = table.bend_ratio(value);
+        TEST_ASSERT_GREATER_OR_EQUAL(previous, ratio);
+        previous = ratio;
+
+        double reference = pow(2.0, value / 8192.0 * BEND_SEMITONES / 12.0);
+        double error = fabs(cents((double)ratio / PitchTable::BEND_NONE, reference));
+        if (error > worst) worst = error;
+        // One table step is 4 semitones / 1024 = 0.39 cents
+        TEST_ASSERT_TRUE(error < 0.45);
+    }
+
+    // Full range ends and out of range values clamp
+    TEST_ASSERT_INT_WITHIN(1, lround(pow(2.0, -BEND_SEMITONES / 12.0) * PitchTable::BEND_NONE), table.bend_ratio(-8192));
+    TEST_ASSERT_EQUAL(table.bend_ratio(-8192), table.bend_ratio(-20000));
+    TEST_ASSERT_EQUAL(table.bend_table[PitchTable::BEND_TABLE_SIZE - 1], table.bend_ratio(20000));
+
+    char message[60];
+    snprintf(message, sizeof(message), "bend table worst error %.4f cents", worst);
+    TEST_MESSAGE(message);
+}
+
+static void test_bent_notes(void) {
+    // Note and bend together, as Osc::setFreq() uses them
+    for (int n = 0; n < 128; n++) {
+        for (int value = -8192; value <= 8191; value += 257) {
+            uint32_t inc = table.phase_inc(n, table.bend_ratio(value));
+            double reference = 440.0 * pow(2.0, (n - 69 + value / 8192.0 * BEND_SEMITONES) / 12.0);
+            TEST_ASSERT_TRUE(fabs(cents(phase_inc_to_freq(inc), reference)) < 0.75);
+        }
+        TEST_ASSERT_EQUAL_UINT32(table.note_phase_inc[n], table.phase_inc(n, PitchTable::BEND_NONE));
+    }
+    TEST_ASSERT_EQUAL_UINT32(table.note_phase_inc[1], table.phase_inc(129, PitchTable::BEND_NONE));
+}
+
+int main(void) {
+    table.begin(CELLS, AUDIO_RATE, BEND_SEMITONES);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_note_table);
+    RUN_TEST(test_bend_table);
+    RUN_TEST(test_bent_notes);
+    return UNITY_END();
+}
@@ -0,0 +1,195 @@
+#include <unity.h>
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "../mem_storage.h"
+#include "midi/preset_bank.h"
+#include "seqlock.h"
+
+static MidiSettingsData defaults;
+
+void setUp(void) {
+    set_default_settings(&defaults);
+}
+
+void tearDown(void) {}
+
+// Every field derived from p, so a mix of two presets is detectable
+static void make_preset(MidiSettingsData* data, int p) {
+    set_default_settings(data);
+    data->bpm = 60 + p;
+    data->midi_channel = (MidiChannel)(1 + p);
+    data->midi_clk_type = (MidiClkType)(p % 4);
+    for (size_t i = 0; i < OutChannelCount; i++) {
+        data->midi_out_type[i] = (MidiOutType)((p * 5 + i) % 40);
+        data->midi_out_channel[i] = (MidiChannel)(1 + (p + i) % 16);
+        data->note_priority[i] = (NotePriority)(p % 3);
+        data->clock_ratio[i] = {(uint8_t)(1 + p), (uint8_t)(1 + i), (uint8_t)(p * 3), (uint8_t)(10 + p)};
+    }
+}
+
+static void test_upgrade_from_single_blob(void) {
+    // Firmware without presets stored one settings blob, every preset starts as a copy
+    MemStorage storage;
+    MidiSettingsData old_settings;
+    make_preset(&old_settings, 3);
+    SettingsBlob::save(&storage, old_settings);
+
+    PresetBank bank;
+    TEST_ASSERT_EQUAL(SettingsBlob::SourceBlob, bank.load(&storage, defaults));
+    for (size_t i = 0; i < PresetBank::PRESET_COUNT; i++) {
+        TEST_ASSERT_EQUAL_MEMORY(&old_settings, &bank.presets[i], sizeof(old_settings));
+    }
+    TEST_ASSERT_EQUAL(0, bank.active);
+    TEST_ASSERT_EQUAL(PresetBank::PRESET_COUNT, storage.blobs.size());
+
+    // The next boot reads the same bank and writes nothing
+    int writes = storage.blob_writes;
+    PresetBank again;
+    again.load(&storage, defaults);
+    TEST_ASSERT_EQUAL(writes, storage.blob_writes);
+    TEST_ASSERT_EQUAL_MEMORY(&bank, &again, sizeof(bank));
+}
+
+static void test_legacy_keys_fill_every_preset(void) {
+    MemStorage storage;
+    storage.u32["bpm"] = 99;
+    PresetBank bank;
+    TEST_ASSERT_EQUAL(SettingsBlob::SourceLegacy, bank.load(&storage, defaults));
+    TEST_ASSERT_EQUAL(99, bank.presets[0].bpm);
+    TEST_ASSERT_EQUAL(99, bank.presets[PresetBank::PRESET_COUNT - 1].bpm);
+    TEST_ASSERT_EQUAL(0, storage.u32.count("bpm"));
+}
+
+static void test_select_keeps_working_copy(void) {
+    PresetBank bank;
+    for (size_t i = 0; i < PresetBank::PRESET_COUNT; i++) make_preset(&bank.presets[i], i);
+    MidiSettingsData working = bank.presets[0];
+    working.bpm = 150;
+
+    TEST_ASSERT_TRUE(bank.select(4, &working));
+    TEST_ASSERT_EQUAL(150, bank.presets[0].bpm);
+    TEST_ASSERT_EQUAL_MEMORY(&bank.presets[4], &working, sizeof(working));
+    TEST_ASSERT_EQUAL(4, bank.active);
+
+    // Already active or out of range
+    TEST_ASSERT_FALSE(bank.select(4, &working));
+    TEST_ASSERT_FALSE(bank.select(PresetBank::PRESET_COUNT, &working));
+    TEST_ASSERT_EQUAL(4, bank.active);
+}
+
+static void test_save_writes_only_changes(void) {
+    MemStorage storage;
+    PresetBank bank;
+    bank.load(&storage, defaults);
+    PresetBank stored = bank;
+
+    MidiSettingsData working = bank.presets[0];
+    working.bpm = 150;
+    bank.select(4, &working);
+
+    int writes = storage.blob_writes;
+    int commits = storage.commits;
+    TEST_ASSERT_TRUE(bank.save(&storage, stored));
+    TEST_ASSERT_EQUAL(writes + 1, storage.blob_writes); // Preset 0
+    TEST_ASSERT_EQUAL(commits + 1, storage.commits);
+    TEST_ASSERT_EQUAL(4, storage.u32[PresetBank::ACTIVE_KEY]);
+
+    PresetBank loaded;
+    loaded.load(&storage, defaults);
+    TEST_ASSERT_EQUAL(4, loaded.active);
+    TEST_ASSERT_EQUAL(150, loaded.presets[0].bpm);
+
+    writes = storage.blob_writes;
+    TEST_ASSERT_TRUE(loaded.save(&storage, loaded));
+    TEST_ASSERT_EQUAL(writes, storage.blob_writes);
+
+    // A bad active index is ignored
+    storage.u32[PresetBank::ACTIVE_KEY] = 77;
+    PresetBank bad;
+    bad.load(&storage, defaults);
+    TEST_ASSERT_EQUAL(0, bad.active);
+
+    storage.fail_writes = true;
+    working.bpm = 90;
+    loaded.select(1, &working);
+    TEST_ASSERT_FALSE(loaded.save(&storage, bank));
+}
+
+static void test_corrupt_preset_copies_first(void) {
+    MemStorage storage;
+    PresetBank bank;
+    bank.load(&storage, defaults);
+    storage.blobs[PresetBank::get_key(2)][8] ^= 1;
+    MidiSettingsData first;
+    make_preset(&first, 1);
+    SettingsBlob::save(&storage, first);
+
+    PresetBank loaded;
+    loaded.load(&storage, defaults);
+    TEST_ASSERT_EQUAL_MEMORY(&first, &loaded.presets[2], sizeof(first));
+    TEST_ASSERT_EQUAL_MEMORY(&defaults, &loaded.presets[3], sizeof(defaults));
+}
+
+static void test_switch_published_whole(void) {
+    // Switching and publishing as MidiSettingsState does, while two readers take
+    // snapshots like the audio task: every snapshot is exactly one preset
+    PresetBank bank;
+    for (size_t i = 0; i < PresetBank::PRESET_COUNT; i++) make_preset(&bank.presets[i], i);
+    MidiSettingsData working = bank.presets[0];
+    Seqlock<MidiSettingsData> published;
+    published.write(working);
+
+    std::atomic<bool> done(false);
+    std::atomic<long> snapshots(0);
+    std::atomic<long> torn(0);
+    auto reader = [&]() {
+        MidiSettingsData snapshot;
+        uint32_t version = 0;
+        while (!done) {
+            if (!published.read(&snapshot, &version)) continue;
+            snapshots++;
+            bool whole = false;
+            for (size_t p = 0; p < PresetBank::PRESET_COUNT; p++) {
+                MidiSettingsData expected;
+                make_preset(&expected, p);
+                whole |= memcmp(&expected, &snapshot, sizeof(snapshot)) == 0;
+            }
+            if (!whole) torn++;
+        }
+    };
+    std::thread reader1(reader);
+    std::thread reader2(reader);
+
+    long switches = 0;
+    auto start = std::chrono::steady_clock::now();
+    while (std::chrono::steady_clock::now() - start < std::chrono::milliseconds(500)) {
+        bank.select((switches * 3 + 1) % PresetBank::PRESET_COUNT, &working);
+        published.write(working);
+        switches++;
+        // Presets change at human speed, give the readers room
+        std::this_thread::sleep_for(std::chrono::microseconds(20));
+    }
+    done = true;
+    reader1.join();
+    reader2.join();
+
+    TEST_ASSERT_EQUAL(0, torn.load());
+    TEST_ASSERT_TRUE(snapshots.load() > 1000);
+
+    char text[80];
+    snprintf(text, sizeof(text), "%ld switches, %ld snapshots", switches, snapshots.load());
+    TEST_MESSAGE(text);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_upgrade_from_single_blob);
+    RUN_TEST(test_legacy_keys_fill_every_preset);
+    RUN_TEST(test_select_keeps_working_copy);
+    RUN_TEST(test_save_writes_only_changes);
+    RUN_TEST(test_corrupt_preset_copies_first);
+    RUN_TEST(test_switch_published_whole);
+    return UNITY_END();
+}
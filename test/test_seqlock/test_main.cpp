@@ -0,0 +1,194 @@
+#include <unity.h>
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include "seqlock.h"
+#include "midi/midi_settings_data.h"
+
+// Every field holds the same counter, so a copy mixing two writes is detectable
+struct Snapshot
+{
+    uint32_t fields[32];
+};
+
+static void fill(Snapshot* snapshot, uint32_t n) {
+    for (size_t i = 0; i < 32; i++) snapshot->fields[i] = n;
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+static void test_single_thread_versions(void) {
+    Seqlock<Snapshot> lock;
+    Snapshot out;
+    uint32_t known = lock.get_version();
+    TEST_ASSERT_FALSE(lock.read(&out, &known));
+
+    Snapshot in;
+    fill(&in, 7);
+    lock.write(in);
+    TEST_ASSERT_TRUE(lock.read(&out, &known));
+    TEST_ASSERT_EQUAL(7, out.fields[31]);
+    TEST_ASSERT_EQUAL(0, known & 1);
+    TEST_ASSERT_EQUAL(known, lock.get_version());
+    // Nothing new, out is left alone
+    out.fields[0] = 0;
+    TEST_ASSERT_FALSE(lock.read(&out, &known));
+    TEST_ASSERT_EQUAL(0, out.fields[0]);
+}
+
+static void test_reader_never_sees_torn_copy(void) {
+    static Seqlock<Snapshot> lock;
+    std::atomic<bool> done(false);
+    uint32_t reads = 0;
+    uint32_t torn = 0;
+    uint32_t backwards = 0;
+
+    std::thread reader([&]() {
+        Snapshot out;
+        uint32_t known = 0;
+        uint32_t last = 0;
+        while (!done.load()) {
+            if (!lock.read(&out, &known)) {
+                std::this_thread::yield();
+                continue;
+            }
+            for (size_t i = 1; i < 32; i++) {
+                if (out.fields[i] != out.fields[0]) {
+                    torn++;
+                    break;
+                }
+            }
+            if (out.fields[0] < last) backwards++;
+            last = out.fields[0];
+            reads++;
+        }
+    });
+
+    Snapshot in;
+    uint32_t writes = 0;
+    auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(500);
+    while (std::chrono::steady_clock::now() < end) {
+        fill(&in, ++writes);
+        lock.write(in);
+        // Back to back writes would starve the reader, which retries on every overlap
+        if ((writes & 15) == 0) std::this_thread::yield();
+    }
+    done = true;
+    reader.join();
+
+    TEST_ASSERT_EQUAL(0, torn);
+    TEST_ASSERT_EQUAL(0, backwards);
+    TEST_ASSERT_TRUE(reads > 1000);
+
+    char text[80];
+    snprintf(text, sizeof(text), "%u writes, %u snapshots read", (unsigned)writes, (unsigned)reads);
+    TEST_MESSAGE(text);
+}
+
+// Per event cost of reading the settings a note needs: five outputs, three
+// fields each, as SignalProcessor::handle_note_on() does
+static const int EVENTS = 200000;
+static const int GETTERS_PER_EVENT = 15;
+
+struct MutexSettings
+{
+    std::mutex mutex;
+    MidiSettingsData data;
+
+    int get_out_type(size_t idx) {
+        std::lock_guard<std::mutex> guard(mutex);
+        return data.midi_out_type[idx];
+    }
+    int get_out_channel(size_t idx) {
+        std::lock_guard<std::mutex> guard(mutex);
+        return data.midi_out_channel[idx];
+    }
+    int get_priority(size_t idx) {
+        std::lock_guard<std::mutex> guard(mutex);
+        return data.note_priority[idx];
+    }
+    void set_bpm(int bpm) {
+        std::lock_guard<std::mutex> guard(mutex);
+        data.bpm = bpm;
+    }
+};
+
+// A UI-like writer changing the settings every 100 us while the events run
+template <typename Write>
+static double time_events(Write write, int (*event)(void)) {
+    std::atomic<bool> done(false);
+    std::thread writer([&]() {
+        int n = 0;
+        while (!done.load()) {
+            write(++n);
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    });
+    int checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < EVENTS; i++) checksum += event();
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    done = true;
+    writer.join();
+    TEST_ASSERT_TRUE(checksum != 0);
+    return ns / EVENTS;
+}
+
+static MutexSettings mutex_settings;
+static Seqlock<MidiSettingsData> published;
+static MidiSettingsData local_copy;
+static uint32_t local_version;
+
+static int mutex_event(void) {
+    int sum = 0;
+    for (size_t i = 0; i < OutChannelCount; i++) {
+        sum += mutex_settings.get_out_type(i) + mutex_settings.get_out_channel(i) + mutex_settings.get_priority(i);
+    }
+    return sum;
+}
+
+static int seqlock_event(void) {
+    // The processor refreshes its copy when the version moved, then reads plain fields
+    published.read(&local_copy, &local_version);
+    int sum = 0;
+    for (size_t i = 0; i < OutChannelCount; i++) {
+        sum += local_copy.midi_out_type[i] + local_copy.midi_out_channel[i] + local_copy.note_priority[i];
+    }
+    return sum;
+}
+
+static void test_event_cost_mutex_vs_seqlock(void) {
+    MidiSettingsData data;
+    memset(&data, 0, sizeof(data));
+    for (size_t i = 0; i < OutChannelCount; i++) {
+        data.midi_out_type[i] = MidiOutPitch;
+        data.midi_out_channel[i] = MidiChannelAll;
+        data.note_priority[i] = NotePriorityLast;
+    }
+    mutex_settings.data = data;
+    published.write(data);
+    local_version = 0;
+
+    double mutex_ns = time_events([](int n) { mutex_settings.set_bpm(n); }, mutex_event);
+    double seqlock_ns = time_events([&](int n) {
+        data.bpm = n;
+        published.write(data);
+    }, seqlock_event);
+
+    char text[120];
+    snprintf(text, sizeof(text), "host per event: %.1f ns with %d mutex getters, %.1f ns with the seqlock snapshot",
+             mutex_ns, GETTERS_PER_EVENT, seqlock_ns);
+    TEST_MESSAGE(text);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_single_thread_versions);
+    RUN_TEST(test_reader_never_sees_torn_copy);
+    RUN_TEST(test_event_cost_mutex_vs_seqlock);
+    return UNITY_END();
+}
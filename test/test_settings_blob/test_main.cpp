@@ -0,0 +1,239 @@
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include "../mem_storage.h"
+#include "midi/settings_store.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static bool same(const MidiSettingsData& a, const MidiSettingsData& b) {
+    return memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+// The nvs.csv factory image, version 0 keys
+static void write_factory_image(MemStorage* storage) {
+    storage->u32["bpm"] = 120;
+    storage->u32["midi_channel"] = 17;
+    storage->u32["midi_clk_type"] = 0;
+    storage->u32["midi_tx"] = 0;
+    const uint32_t types[OutChannelCount] = {13, 9, 8, 0, 6};
+    for (size_t i = 0; i < OutChannelCount; i++) {
+        char key[10];
+        snprintf(key, sizeof(key), "out_t%zu", i); storage->u32[key] = types[i];
+        snprintf(key, sizeof(key), "out_c%zu", i); storage->u32[key] = 17;
+        snprintf(key, sizeof(key), "out_p%zu", i); storage->u32[key] = 1;
+        snprintf(key, sizeof(key), "out_m%zu", i); storage->u32[key] = 1;
+        snprintf(key, sizeof(key), "out_d%zu", i); storage->u32[key] = 1;
+        snprintf(key, sizeof(key), "out_o%zu", i); storage->u32[key] = 0;
+        snprintf(key, sizeof(key), "out_w%zu", i); storage->u32[key] = 10;
+    }
+}
+
+static void test_crc32_check_value(void) {
+    TEST_ASSERT_EQUAL_HEX32(0xCBF43926, SettingsBlob::crc32((const uint8_t*)"123456789", 9));
+}
+
+static void test_round_trip(void) {
+    MemStorage storage;
+    MidiSettingsData saved;
+    set_default_settings(&saved);
+    saved.bpm = 133;
+    saved.midi_channel = MidiChannel5;
+    saved.midi_clk_type = MidiClkSync4;
+    saved.midi_tx_type = MidiTxClockThru;
+    for (size_t i = 0; i < OutChannelCount; i++) {
+        saved.midi_out_type[i] = (MidiOutType)(MidiOutCc0 + i * 30);
+        saved.midi_out_channel[i] = (MidiChannel)(i + 1);
+        saved.note_priority[i] = NotePriorityLowest;
+        saved.clock_ratio[i] = {(uint8_t)(i + 2), 3, (uint8_t)(i * 10), 25};
+    }
+
+    TEST_ASSERT_TRUE(SettingsBlob::save(&storage, saved));
+    TEST_ASSERT_EQUAL(SettingsBlob::SIZE, storage.blobs[SettingsBlob::KEY].size());
+
+    MidiSettingsData loaded;
+    set_default_settings(&loaded);
+    TEST_ASSERT_EQUAL(SettingsBlob::SourceBlob, SettingsBlob::load(&storage, &loaded));
+    TEST_ASSERT_TRUE(same(saved, loaded));
+}
+
+static void test_factory_image_migrates(void) {
+    MemStorage storage;
+    write_factory_image(&storage);
+
+    MidiSettingsData data;
+    set_default_settings(&data);
+    TEST_ASSERT_EQUAL(SettingsBlob::SourceLegacy, SettingsBlob::load(&storage, &data));
+    TEST_ASSERT_EQUAL(MidiOutMozzi, data.midi_out_type[0]);
+    TEST_ASSERT_EQUAL(MidiOutPitch, data.midi_out_type[1]);
+    TEST_ASSERT_EQUAL(MidiOutGate, data.midi_out_type[2]);
+    TEST_ASSERT_EQUAL(MidiOutClock1_4, data.midi_out_type[3]);
+    TEST_ASSERT_EQUAL(MidiOutRun, data.midi_out_type[4]);
+
+    // The keys go once the blob is written, the next boot reads the blob
+    TEST_ASSERT_TRUE(storage.u32.empty());
+    TEST_ASSERT_EQUAL(1, storage.blobs.count(SettingsBlob::KEY));
+    MidiSettingsData reloaded;
+    set_default_settings(&reloaded);
+    TEST_ASSERT_EQUAL(SettingsBlob::SourceBlob, SettingsBlob::load(&storage, &reloaded));
+    TEST_ASSERT_TRUE(same(data, reloaded));
+}
+
+static void test_partial_legacy_keeps_defaults(void) {
+    // Older firmware without the clock ratio and MIDI out keys
+    MemStorage storage;
+    storage.u32["bpm"] = 90;
+    storage.u32["out_t3"] = MidiOutClock1_16;
+
+    MidiSettingsData data, expected;
+    set_default_settings(&data);
+    set_default_settings(&expected);
+    expected.bpm = 90;
+    expected.midi_out_type[3] = MidiOutClock1_16;
+
+    TEST_ASSERT_EQUAL(SettingsBlob::SourceLegacy, SettingsBlob::load(&storage, &data));
+    TEST_ASSERT_TRUE(same(expected, data));
+}
+
+static void test_every_bit_flip_is_rejected(void) {
+    MidiSettingsData saved;
+    set_default_settings(&saved);
+    saved.bpm = 77;
+    uint8_t blob[SettingsBlob::SIZE];
+    size_t size = SettingsBlob::encode(saved, blob);
+    TEST_ASSERT_EQUAL(SettingsBlob::SIZE, size);
+
+    for (size_t i = 0; i < size; i++) {
+        for (int bit = 0; bit < 8; bit++) {
+            uint8_t corrupt[SettingsBlob::SIZE];
+            memcpy(corrupt, blob, size);
+            corrupt[i] ^= 1 << bit;
+
+            MidiSettingsData data, untouched;
+            set_default_settings(&data);
+            set_default_settings(&untouched);
+            TEST_ASSERT_FALSE(SettingsBlob::decode(corrupt, size, &data));
+            TEST_ASSERT_TRUE(same(untouched, data));
+        }
+    }
+}
+
+static void test_corrupt_blob_falls_back_to_defaults(void) {
+    MidiSettingsData saved;
+    set_default_settings(&saved);
+    saved.bpm = 77;
+    uint8_t blob[SettingsBlob::SIZE];
+    size_t size = SettingsBlob::encode(saved, blob);
+    blob[10] ^= 0x40;
+
+    MemStorage storage;
+    storage.blobs[SettingsBlob::KEY] = std::vector<uint8_t>(blob, blob + size);
+
+    MidiSettingsData data, defaults;
+    set_default_settings(&data);
+    set_default_settings(&defaults);
+    TEST_ASSERT_EQUAL(SettingsBlob::SourceDefaults, SettingsBlob::load(&storage, &data));
+    TEST_ASSERT_TRUE(same(defaults, data));
+
+    // The defaults replaced the corrupt blob
+    MidiSettingsData reloaded;
+    set_default_settings(&reloaded);
+    TEST_ASSERT_EQUAL(SettingsBlob::SourceBlob, SettingsBlob::load(&storage, &reloaded));
+}
+
+static void test_corrupt_blob_with_legacy_keys(void) {
+    // Power cut during a migration: the keys are still there
+    MemStorage storage;
+    write_factory_image(&storage);
+    storage.blobs[SettingsBlob::KEY] = std::vector<uint8_t>(10, 0xAB);
+
+    MidiSettingsData data;
+    set_default_settings(&data);
+    TEST_ASSERT_EQUAL(SettingsBlob::SourceLegacy, SettingsBlob::load(&storage, &data));
+    TEST_ASSERT_EQUAL(MidiOutMozzi, data.midi_out_type[0]);
+}
+
+static void test_bad_length_and_version(void) {
+    MidiSettingsData saved;
+    set_default_settings(&saved);
+    uint8_t blob[SettingsBlob::SIZE];
+    size_t size = SettingsBlob::encode(saved, blob);
+
+    MidiSettingsData data;
+    set_default_settings(&data);
+    TEST_ASSERT_FALSE(SettingsBlob::decode(blob, size - 1, &data));
+    TEST_ASSERT_FALSE(SettingsBlob::decode(blob, 3, &data));
+
+    blob[2] = SettingsBlob::VERSION + 1;
+    TEST_ASSERT_FALSE(SettingsBlob::decode(blob, size, &data));
+}
+
+static void test_failed_write_keeps_legacy_keys(void) {
+    MemStorage storage;
+    write_factory_image(&storage);
+    storage.fail_writes = true;
+
+    MidiSettingsData data;
+    set_default_settings(&data);
+    TEST_ASSERT_EQUAL(SettingsBlob::SourceLegacy, SettingsBlob::load(&storage, &data));
+    TEST_ASSERT_FALSE(storage.u32.empty());
+}
+
+static void test_default_note_priority_is_last(void) {
+    MemStorage storage;
+    write_factory_image(&storage);
+
+    MidiSettingsData data;
+    set_default_settings(&data);
+    for (size_t i = 0; i < OutChannelCount; i++) {
+        TEST_ASSERT_EQUAL(NotePriorityLast, data.note_priority[i]);
+    }
+    TEST_ASSERT_EQUAL(SettingsBlob::SourceLegacy, SettingsBlob::load(&storage, &data));
+    for (size_t i = 0; i < OutChannelCount; i++) {
+        TEST_ASSERT_EQUAL(NotePriorityLast, data.note_priority[i]);
+    }
+}
+
+static void test_note_priority_out_of_range(void) {
+    // A blob with a valid crc but a priority the firmware does not know
+    MidiSettingsData saved;
+    set_default_settings(&saved);
+    saved.note_priority[1] = NotePriorityLowest;
+    saved.note_priority[2] = (NotePriority)7;
+    saved.note_priority[3] = (NotePriority)0xFF;
+    uint8_t blob[SettingsBlob::SIZE];
+    size_t size = SettingsBlob::encode(saved, blob);
+
+    MidiSettingsData data;
+    set_default_settings(&data);
+    TEST_ASSERT_TRUE(SettingsBlob::decode(blob, size, &data));
+    TEST_ASSERT_EQUAL(NotePriorityLast, data.note_priority[0]);
+    TEST_ASSERT_EQUAL(NotePriorityLowest, data.note_priority[1]);
+    TEST_ASSERT_EQUAL(NotePriorityLast, data.note_priority[2]);
+    TEST_ASSERT_EQUAL(NotePriorityLast, data.note_priority[3]);
+
+    MemStorage storage;
+    storage.u32["out_p0"] = NotePriorityHighest;
+    storage.u32["out_p4"] = 3;
+    set_default_settings(&data);
+    TEST_ASSERT_EQUAL(SettingsBlob::SourceLegacy, SettingsBlob::load(&storage, &data));
+    TEST_ASSERT_EQUAL(NotePriorityHighest, data.note_priority[0]);
+    TEST_ASSERT_EQUAL(NotePriorityLast, data.note_priority[4]);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_crc32_check_value);
+    RUN_TEST(test_round_trip);
+    RUN_TEST(test_factory_image_migrates);
+    RUN_TEST(test_partial_legacy_keeps_defaults);
+    RUN_TEST(test_every_bit_flip_is_rejected);
+    RUN_TEST(test_corrupt_blob_falls_back_to_defaults);
+    RUN_TEST(test_corrupt_blob_with_legacy_keys);
+    RUN_TEST(test_bad_length_and_version);
+    RUN_TEST(test_failed_write_keeps_legacy_keys);
+    RUN_TEST(test_default_note_priority_is_last);
+    RUN_TEST(test_note_priority_out_of_range);
+    return UNITY_END();
+}
@@ -0,0 +1,204 @@
+#include <unity.h>
+#include <vector>
+#include "clock/song_position.h"
+#include "clock/clock_pll.h"
+#include "clock/clock_engine.h"
+
+// Drives SongPosition, ClockPll and an external ClockEngine the way
+// SignalProcessor does for MIDI clock and transport messages, and records
+// the song position every output pulse fired on.
+
+static const uint32_t PULSE_US = 1000;
+static const uint32_t TICK_120_US = 20833;
+static const uint32_t TICK_100_US = 25000;
+
+struct Transport
+{
+    SongPosition song;
+    ClockPll pll;
+    ClockEngine engine;
+    uint64_t now_us = 1000000;
+    std::vector<uint32_t> pulses[2]; // Song position of each rising edge
+
+    Transport() {
+        engine.set_output(0, 1, 1, 0, PULSE_US); // Beats
+        engine.set_output(1, 1, 4, 0, PULSE_US); // Bars
+        engine.set_internal(false, now_us);
+    }
+
+    void run(uint64_t until_us) {
+        while (true) {
+            uint64_t next = engine.get_next_event_us();
+            if (next > until_us) break;
+            if (next > now_us) now_us = next;
+
+            uint32_t tick = engine.get_tick_count();
+            uint32_t changed = engine.update(now_us);
+            for (uint32_t mask = changed & engine.get_gate_mask(); mask != 0; mask &= mask - 1) {
+                pulses[__builtin_ctz(mask)].push_back(tick);
+            }
+        }
+        now_us = until_us;
+    }
+
+    // SignalProcessor::external_clock_tick()
+    void tick(uint32_t interval_us) {
+        run(now_us + interval_us - 1);
+        now_us++;
+        pll.tick(now_us);
+        if (song.tick()) {
+            engine.external_tick(now_us, pll.get_tick_time_us(),
+                                 pll.has_period() ? pll.get_interval_q16() : 0, pll.is_locked());
+        }
+        run(now_us);
+    }
+
+    void ticks(int count, uint32_t interval_us) {
+        for (int i = 0; i < count; i++) tick(interval_us);
+    }
+
+    // handle_start(), handle_continue(), handle_stop() and handle_song_position()
+    void start(void) {
+        song.start();
+        engine.locate(song.get_position(), now_us);
+    }
+    void resume(void) {
+        song.resume();
+        engine.locate(song.get_position(), now_us);
+    }
+    void stop(void) {
+        song.stop();
+        engine.external_lost();
+    }
+    void locate(uint16_t sixteenths) {
+        song.locate(sixteenths);
+        engine.locate(song.get_position(), now_us);
+    }
+
+    void clear(void) {
+        pulses[0].clear();
+        pulses[1].clear();
+    }
+};
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static void test_runs_without_transport(void) {
+    // Sources that never send Start still drive the outputs
+    Transport t;
+    TEST_ASSERT_TRUE(t.song.is_running());
+    t.ticks(100, TICK_120_US);
+    TEST_ASSERT_EQUAL(100, t.song.get_position());
+    TEST_ASSERT_EQUAL(5, t.pulses[0].size());
+    for (size_t i = 0; i < t.pulses[0].size(); i++) {
+        TEST_ASSERT_EQUAL(i * 24, t.pulses[0][i]);
+    }
+}
+
+static void test_start_resets_to_zero(void) {
+    Transport t;
+    t.ticks(50, TICK_120_US);
+    t.locate(40);
+    TEST_ASSERT_EQUAL(240, t.song.get_position());
+
+    t.start();
+    t.clear();
+    TEST_ASSERT_EQUAL(0, t.song.get_position());
+    t.ticks(49, TICK_120_US);
+    TEST_ASSERT_EQUAL(49, t.song.get_position());
+    TEST_ASSERT_EQUAL(3, t.pulses[0].size());
+    TEST_ASSERT_EQUAL(0, t.pulses[0][0]);
+    TEST_ASSERT_EQUAL(24, t.pulses[0][1]);
+    TEST_ASSERT_EQUAL(48, t.pulses[0][2]);
+    TEST_ASSERT_EQUAL(1, t.pulses[1].size());
+    TEST_ASSERT_EQUAL(0, t.pulses[1][0]);
+
+    // Start while stopped runs again
+    t.stop();
+    t.start();
+    TEST_ASSERT_TRUE(t.song.is_running());
+    TEST_ASSERT_EQUAL(0, t.song.get_position());
+}
+
+static void test_position_pointer_while_stopped_then_continue(void) {
+    Transport t;
+    t.start();
+    t.ticks(100, TICK_120_US);
+    t.stop();
+
+    // Sixteenth 17 is tick 102, ticks while stopped neither move it nor pulse
+    t.locate(17);
+    t.clear();
+    t.ticks(30, TICK_120_US);
+    TEST_ASSERT_FALSE(t.song.is_running());
+    TEST_ASSERT_EQUAL(102, t.song.get_position());
+    TEST_ASSERT_TRUE(t.pulses[0].empty());
+    TEST_ASSERT_TRUE(t.pulses[1].empty());
+
+    // Continue plays from 102, the next beat is 120 and the next bar 192
+    t.resume();
+    t.ticks(100, TICK_120_US);
+    TEST_ASSERT_EQUAL(202, t.song.get_position());
+    TEST_ASSERT_EQUAL(4, t.pulses[0].size());
+    for (size_t i = 0; i < t.pulses[0].size(); i++) {
+        TEST_ASSERT_EQUAL(120 + i * 24, t.pulses[0][i]);
+    }
+    TEST_ASSERT_EQUAL(1, t.pulses[1].size());
+    TEST_ASSERT_EQUAL(192, t.pulses[1][0]);
+}
+
+static void test_position_pointer_while_running(void) {
+    // The pointer jumps, the song keeps running from there
+    Transport t;
+    t.ticks(30, TICK_120_US);
+    t.locate(8);
+    t.clear();
+    TEST_ASSERT_TRUE(t.song.is_running());
+    t.ticks(24, TICK_120_US);
+    TEST_ASSERT_EQUAL(48 + 24, t.song.get_position());
+    TEST_ASSERT_EQUAL(1, t.pulses[0].size());
+    TEST_ASSERT_EQUAL(48, t.pulses[0][0]);
+}
+
+static void test_stop_holds_position_and_tracks_tempo(void) {
+    Transport t;
+    t.start();
+    t.ticks(96, TICK_120_US);
+    TEST_ASSERT_TRUE(t.pll.is_locked());
+    TEST_ASSERT_FLOAT_WITHIN(0.1f, 120.0f, t.pll.get_bpm());
+
+    // The clock keeps running at 100 bpm while the song is stopped
+    t.stop();
+    t.clear();
+    t.ticks(24 * 8, TICK_100_US);
+    TEST_ASSERT_EQUAL(96, t.song.get_position());
+    TEST_ASSERT_TRUE(t.pulses[0].empty());
+    TEST_ASSERT_TRUE(t.pll.is_locked());
+    TEST_ASSERT_FLOAT_WITHIN(0.1f, 100.0f, t.pll.get_bpm());
+
+    // Continue resumes at the held beat with the tempo tracked meanwhile
+    t.resume();
+    std::vector<uint64_t> times;
+    for (int i = 0; i < 72; i++) {
+        size_t before = t.pulses[0].size();
+        t.tick(TICK_100_US);
+        if (t.pulses[0].size() != before) times.push_back(t.now_us);
+    }
+    TEST_ASSERT_EQUAL(3, t.pulses[0].size());
+    TEST_ASSERT_EQUAL(96, t.pulses[0][0]);
+    TEST_ASSERT_EQUAL(120, t.pulses[0][1]);
+    TEST_ASSERT_EQUAL(3, times.size());
+    TEST_ASSERT_UINT64_WITHIN(2, 24 * TICK_100_US, times[1] - times[0]);
+    TEST_ASSERT_UINT64_WITHIN(2, 24 * TICK_100_US, times[2] - times[1]);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_runs_without_transport);
+    RUN_TEST(test_start_resets_to_zero);
+    RUN_TEST(test_position_pointer_while_stopped_then_continue);
+    RUN_TEST(test_position_pointer_while_running);
+    RUN_TEST(test_stop_holds_position_and_tracks_tempo);
+    return UNITY_END();
+}
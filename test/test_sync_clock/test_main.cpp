@@ -0,0 +1,157 @@
+#include <unity.h>
+#include <stdio.h>
+#include <vector>
+#include "clock/clock_pll.h"
+#include "clock/sync_clock.h"
+
+typedef std::vector<uint64_t> Times;
+
+static SyncClock sync;
+static ClockPll pll;
+
+void setUp(void) {
+    sync.set_ppqn(SyncClock::PPQN);
+    sync.reset();
+    pll = ClockPll();
+}
+
+void tearDown(void) {}
+
+// Feeds the edges and polls every 10 us like the MIDI task, the PLL only gets
+// the ticks on an edge. Returns all tick times, edge ticks in on_edge.
+static Times run(const Times& edges, uint64_t end_us, Times* on_edge = nullptr) {
+    Times ticks;
+    size_t next = 0;
+    uint64_t tick_us;
+    bool edge;
+    for (uint64_t now = 0; now <= end_us; now += 10) {
+        while (next < edges.size() && edges[next] <= now) sync.edge(edges[next++]);
+        while (sync.poll(now, &tick_us, &edge)) {
+            ticks.push_back(tick_us);
+            if (edge) {
+                pll.tick(tick_us, sync.get_ticks_per_edge());
+                if (on_edge) on_edge->push_back(tick_us);
+            }
+        }
+    }
+    return ticks;
+}
+
+static void test_ticks_spread_between_edges(void) {
+    const int ppqns[] = {1, 2, 4, 24};
+    for (int ppqn : ppqns) {
+        setUp();
+        sync.set_ppqn(ppqn);
+        const uint64_t period = 500000 / ppqn; // 120 bpm
+        const int per_edge = SyncClock::PPQN / ppqn;
+        Times edges;
+        for (int i = 0; i < 9; i++) edges.push_back(1000 + i * period);
+
+        Times on_edge;
+        Times ticks = run(edges, edges.back() + 2 * period, &on_edge);
+        // The first edge only measures
+        TEST_ASSERT_EQUAL(8 * per_edge, ticks.size());
+        for (size_t i = 0; i < ticks.size(); i++) {
+            TEST_ASSERT_INT_WITHIN(1, edges[1] + i * period / per_edge, ticks[i]);
+        }
+        TEST_ASSERT_EQUAL(8, on_edge.size());
+        for (size_t k = 1; k < edges.size(); k++) {
+            TEST_ASSERT_EQUAL_UINT64(edges[k], ticks[(k - 1) * per_edge]);
+            TEST_ASSERT_EQUAL_UINT64(edges[k], on_edge[k - 1]);
+        }
+        TEST_ASSERT_FLOAT_WITHIN(0.01, 120, pll.get_bpm());
+    }
+}
+
+static void test_early_edge_flushes_pending_ticks(void) {
+    sync.set_ppqn(4);
+    Times on_edge;
+    Times ticks = run({0, 125000, 250000, 312500, 375000}, 500000, &on_edge);
+
+    TEST_ASSERT_EQUAL(24, ticks.size());
+    TEST_ASSERT_EQUAL_UINT64(312500, ticks[12]);
+    TEST_ASSERT_EQUAL_UINT64(375000, ticks[18]);
+    int at_edge = 0;
+    for (uint64_t t : ticks) {
+        if (t == 312500) at_edge++;
+    }
+    TEST_ASSERT_EQUAL(4, at_edge); // 3 catch up ticks and the edge tick
+    for (size_t i = 1; i < ticks.size(); i++) {
+        TEST_ASSERT_TRUE(ticks[i] >= ticks[i - 1]);
+    }
+    // Only the edge itself counts as a measurement
+    TEST_ASSERT_EQUAL(4, on_edge.size());
+}
+
+static void test_late_edge_waits(void) {
+    sync.set_ppqn(2);
+    Times ticks = run({0, 250000, 750000}, 1300000);
+    TEST_ASSERT_EQUAL(24, ticks.size());
+    TEST_ASSERT_EQUAL_UINT64(250000 + 11 * 250000 / 12, ticks[11]);
+    TEST_ASSERT_EQUAL_UINT64(750000, ticks[12]);
+}
+
+static void test_glitch_and_loss(void) {
+    // 500300 is too close to be an edge, 5000000 after a 4 s gap only measures again
+    sync.set_ppqn(1);
+    Times ticks = run({0, 500000, 500300, 1000000, 5000000, 5500000}, 5600000);
+    TEST_ASSERT_EQUAL(24 * 2 + 5, ticks.size());
+    TEST_ASSERT_EQUAL_UINT64(1000000, ticks[24]);
+    TEST_ASSERT_EQUAL_UINT64(5500000, ticks[48]);
+}
+
+static void test_catch_up_ticks_skip_pll(void) {
+    // 4 PPQN stepping from 100 to 160 bpm with +/-200 us edge jitter. The first short
+    // edge period leaves two ticks pending, they go out at the edge time.
+    sync.set_ppqn(4);
+    uint32_t rng = 1;
+    Times edges;
+    double t = 0;
+    for (int i = 0; i < 4 * 24; i++) {
+        rng = rng * 1664525u + 1013904223u;
+        int jitter = (int)((rng >> 8) % 401) - 200;
+        edges.push_back((uint64_t)(t + 1000 + jitter));
+        t += 60e6 / ((i < 4 * 8 ? 100 : 160) * 4);
+    }
+
+    Times on_edge;
+    Times ticks = run(edges, edges.back() + 10000, &on_edge);
+    TEST_ASSERT_TRUE(pll.is_locked());
+    TEST_ASSERT_FLOAT_WITHIN(0.2, 160, pll.get_bpm());
+
+    // Replay: the PLL fed from the edges never reads past the new tempo,
+    // one fed every tick sees the catch up ticks as zero length intervals
+    ClockPll edge_pll;
+    ClockPll every_tick;
+    int catch_up = 0;
+    float edge_max = 0;
+    float every_max = 0;
+    size_t next_edge = 0;
+    for (size_t i = 0; i < ticks.size(); i++) {
+        if (i > 0 && ticks[i] == ticks[i - 1]) catch_up++;
+        if (i % sync.get_ticks_per_edge() == 0) {
+            TEST_ASSERT_EQUAL_UINT64(on_edge[next_edge++], ticks[i]);
+            edge_pll.tick(ticks[i], sync.get_ticks_per_edge());
+            if (edge_pll.get_bpm() > edge_max) edge_max = edge_pll.get_bpm();
+        }
+        every_tick.tick(ticks[i]);
+        if (every_tick.get_bpm() > every_max) every_max = every_tick.get_bpm();
+    }
+    TEST_ASSERT_EQUAL(2, catch_up);
+    TEST_ASSERT_TRUE(edge_max < 162);
+
+    char text[100];
+    snprintf(text, sizeof(text), "highest tempo read %.1f bpm from edges, %.1f bpm feeding every tick",
+             edge_max, every_max);
+    TEST_MESSAGE(text);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_ticks_spread_between_edges);
+    RUN_TEST(test_early_edge_flushes_pending_ticks);
+    RUN_TEST(test_late_edge_waits);
+    RUN_TEST(test_glitch_and_loss);
+    RUN_TEST(test_catch_up_ticks_skip_pll);
+    return UNITY_END();
+}
@@ -0,0 +1,168 @@
+#include <unity.h>
+#include <string.h>
+#include "osc/voice_pool.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+typedef VoicePool<4> Pool;
+
+// Both lists together hold every voice once, the free list matches free_mask,
+// the level index holds exactly the held voices
+static void check_lists(const Pool& pool) {
+    uint32_t seen = 0;
+    int held = 0;
+    uint32_t by_level[Pool::LEVELS] = {0};
+    for (uint8_t v = pool.head; v != Pool::NO_VOICE; v = pool.next[v]) {
+        TEST_ASSERT_TRUE(pool.is_held(v));
+        seen |= 1u << v;
+        held++;
+        by_level[pool.level[v]] |= 1u << v;
+    }
+    for (size_t l = 0; l < Pool::LEVELS; l++) {
+        TEST_ASSERT_EQUAL_HEX32(by_level[l], pool.level_voices[l]);
+        TEST_ASSERT_EQUAL(by_level[l] != 0, (pool.level_used[l / 32] >> (l % 32)) & 1);
+    }
+    int free_count = 0;
+    for (uint8_t v = pool.free_head; v != Pool::NO_VOICE; v = pool.next[v]) {
+        TEST_ASSERT_FALSE(pool.is_held(v));
+        seen |= 1u << v;
+        free_count++;
+    }
+    TEST_ASSERT_EQUAL(4, held + free_count);
+    TEST_ASSERT_EQUAL_HEX32(0xF, seen);
+    TEST_ASSERT_EQUAL(__builtin_popcount(pool.free_mask), free_count);
+}
+
+static void test_allocates_in_order(void) {
+    Pool pool;
+    for (uint8_t i = 0; i < 4; i++) {
+        TEST_ASSERT_EQUAL(i, pool.allocate(60 + i, 100, VoiceStealOldest));
+    }
+    check_lists(pool);
+}
+
+static void test_prefers_silent_free_voice(void) {
+    Pool pool;
+    for (uint8_t i = 0; i < 4; i++) pool.allocate(60 + i, 100, VoiceStealOldest);
+
+    // Voice 0 is still in its release, voice 1 has finished
+    TEST_ASSERT_EQUAL(0, pool.release(60));
+    TEST_ASSERT_EQUAL(1, pool.release(61));
+    TEST_ASSERT_EQUAL(1, pool.allocate(70, 100, VoiceStealOldest, 1u << 0));
+    check_lists(pool);
+}
+
+static void test_takes_longest_released_when_all_sound(void) {
+    Pool pool;
+    for (uint8_t i = 0; i < 4; i++) pool.allocate(60 + i, 100, VoiceStealOldest);
+
+    pool.release(62);
+    pool.release(60);
+    pool.release(61);
+    const uint32_t all = 0xF;
+    TEST_ASSERT_EQUAL(2, pool.allocate(70, 100, VoiceStealOldest, all));
+    TEST_ASSERT_EQUAL(0, pool.allocate(71, 100, VoiceStealOldest, all));
+    TEST_ASSERT_EQUAL(1, pool.allocate(72, 100, VoiceStealOldest, all));
+    check_lists(pool);
+}
+
+static void test_retrigger_and_same_note(void) {
+    Pool pool;
+    uint8_t voice = pool.allocate(60, 100, VoiceStealSameNote);
+    pool.allocate(62, 100, VoiceStealSameNote);
+    TEST_ASSERT_EQUAL(voice, pool.allocate(60, 80, VoiceStealSameNote));
+
+    // A released note comes back on its voice even while it still sounds
+    pool.release(60);
+    pool.allocate(64, 100, VoiceStealSameNote, 1u << voice);
+    TEST_ASSERT_EQUAL(voice, pool.allocate(60, 100, VoiceStealSameNote, 1u << voice));
+
+    // Other policies take the longest released silent voice instead
+    Pool other;
+    other.allocate(60, 100, VoiceStealOldest);
+    other.allocate(62, 100, VoiceStealOldest);
+    other.release(60);
+    TEST_ASSERT_EQUAL(2, other.allocate(60, 100, VoiceStealOldest, 1u << 0));
+    check_lists(pool);
+    check_lists(other);
+}
+
+static void test_steals_when_full(void) {
+    Pool pool;
+    pool.allocate(60, 90, VoiceStealOldest);
+    pool.allocate(61, 20, VoiceStealOldest);
+    pool.allocate(62, 50, VoiceStealOldest);
+    pool.allocate(63, 70, VoiceStealOldest);
+
+    TEST_ASSERT_EQUAL(0, pool.allocate(64, 100, VoiceStealOldest));
+    TEST_ASSERT_EQUAL(1, pool.allocate(65, 100, VoiceStealQuietest));
+    // The stolen notes no longer release anything
+    TEST_ASSERT_EQUAL(Pool::NO_VOICE, pool.release(60));
+    TEST_ASSERT_EQUAL(Pool::NO_VOICE, pool.release(61));
+    TEST_ASSERT_EQUAL(Pool::NO_VOICE, pool.release(99));
+    check_lists(pool);
+}
+
+static void test_quietest_follows_releases(void) {
+    Pool pool;
+    pool.allocate(60, 30, VoiceStealQuietest);
+    pool.allocate(61, 10, VoiceStealQuietest);
+    pool.allocate(62, 10, VoiceStealQuietest);
+    pool.allocate(63, 40, VoiceStealQuietest);
+
+    // Equal levels go to the lower voice
+    TEST_ASSERT_EQUAL(1, pool.allocate(64, 100, VoiceStealQuietest));
+    TEST_ASSERT_EQUAL(2, pool.allocate(65, 100, VoiceStealQuietest));
+    // Releasing the quietest held voice moves the choice to the next level
+    pool.release(60);
+    TEST_ASSERT_EQUAL(0, pool.allocate(66, 120, VoiceStealQuietest));
+    TEST_ASSERT_EQUAL(3, pool.allocate(67, 120, VoiceStealQuietest));
+    // A retrigger reindexes the voice at its new level
+    TEST_ASSERT_EQUAL(1, pool.allocate(64, 5, VoiceStealQuietest));
+    TEST_ASSERT_EQUAL(1, pool.allocate(68, 127, VoiceStealQuietest));
+    check_lists(pool);
+}
+
+static void test_random_play_keeps_lists(void) {
+    Pool pool;
+    uint32_t state = 7;
+    for (int step = 0; step < 100000; step++) {
+        state = state * 1664525u + 1013904223u;
+        uint8_t note = 48 + ((state >> 8) % 12);
+        uint32_t sounding = (state >> 20) & 0xF;
+        VoiceStealPolicy policy = (VoiceStealPolicy)((state >> 24) % 3);
+        if ((state >> 16) & 1) {
+            // A quietest steal takes a held voice at the lowest held level
+            bool steal = pool.free_mask == 0 && policy == VoiceStealQuietest &&
+                         !(pool.note_voice[note] != Pool::NO_VOICE && pool.voice_note[pool.note_voice[note]] == note);
+            uint8_t min_level = 0xFF;
+            for (uint8_t v = pool.head; v != Pool::NO_VOICE; v = pool.next[v]) {
+                if (pool.level[v] < min_level) min_level = pool.level[v];
+            }
+            uint8_t levels[4];
+            memcpy(levels, pool.level, sizeof(levels));
+            uint8_t voice = pool.allocate(note, (state >> 4) & 0x7F, policy, sounding);
+            TEST_ASSERT_TRUE(voice < 4);
+            TEST_ASSERT_TRUE(pool.is_held(voice));
+            if (steal) {
+                TEST_ASSERT_EQUAL(min_level, levels[voice]);
+            }
+        } else {
+            pool.release(note);
+        }
+        check_lists(pool);
+    }
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_allocates_in_order);
+    RUN_TEST(test_prefers_silent_free_voice);
+    RUN_TEST(test_takes_longest_released_when_all_sound);
+    RUN_TEST(test_retrigger_and_same_note);
+    RUN_TEST(test_steals_when_full);
+    RUN_TEST(test_quietest_follows_releases);
+    RUN_TEST(test_random_play_keeps_lists);
+    return UNITY_END();
+}
@@ -0,0 +1,125 @@
+#include <unity.h>
+#include <math.h>
+#include <string.h>
+#include "osc/wavetable.h"
+
+static const size_t N = WavetableBank::CELLS;
+
+static WavetableBank bank;
+static int8_t source[N]; // Stands in for the Mozzi chebyshev table
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// Amplitude of harmonic h of a table, in table units
+static double harmonic(const int8_t* table, size_t h) {
+    double re = 0;
+    double im = 0;
+    for (size_t n = 0; n < N; n++) {
+        re += table[n] * cos(2 * M_PI * h * n / N);
+        im += table[n] * sin(2 * M_PI * h * n / N);
+    }
+    return 2 * sqrt(re * re + im * im) / N;
+}
+
+static void test_tables_are_normalized(void) {
+    for (int w = 0; w < WaveCount; w++) {
+        for (size_t level = 0; level < WavetableBank::LEVELS; level++) {
+            const int8_t* table = bank.tables[w][level];
+            int peak = 0;
+            long sum = 0;
+            for (size_t n = 0; n < N; n++) {
+                if (abs(table[n]) > peak) peak = abs(table[n]);
+                sum += table[n];
+            }
+            TEST_ASSERT_EQUAL(127, peak);
+            TEST_ASSERT_TRUE(labs(sum) < (long)N);
+        }
+    }
+}
+
+static void test_levels_are_band_limited(void) {
+    // Above its harmonic limit a level holds only rounding noise
+    for (int w = 0; w < WaveCount; w++) {
+        for (size_t level = 1; level < WavetableBank::LEVELS; level++) {
+            const int8_t* table = bank.tables[w][level];
+            size_t limit = WavetableBank::MAX_HARMONICS >> level;
+            double strongest = 0;
+            for (size_t h = 1; h <= limit; h++) {
+                strongest = fmax(strongest, harmonic(table, h));
+            }
+            for (size_t h = limit + 1; h <= N / 2; h++) {
+                TEST_ASSERT_TRUE(harmonic(table, h) < 0.01 * strongest);
+            }
+        }
+    }
+}
+
+static void test_sine_and_saw_shapes(void) {
+    for (size_t n = 0; n < N; n++) {
+        TEST_ASSERT_INT_WITHIN(1, lround(127 * sin(2 * M_PI * n / N)), bank.tables[WaveSine][0][n]);
+    }
+    // Saw harmonics fall as 1/h
+    const int8_t* saw = bank.tables[WaveSaw][3];
+    double fundamental = harmonic(saw, 1);
+    for (size_t h = 2; h <= WavetableBank::MAX_HARMONICS >> 3; h++) {
+        TEST_ASSERT_DOUBLE_WITHIN(0.02 * fundamental, fundamental / h, harmonic(saw, h));
+    }
+}
+
+static void test_full_level_reproduces_source(void) {
+    // Level 0 keeps every harmonic, so it is the source without DC, rescaled to 127
+    const int8_t* table = bank.tables[WaveChebyshev][0];
+    double mean = 0;
+    int peak = 0;
+    for (size_t n = 0; n < N; n++) mean += source[n];
+    mean /= N;
+    for (size_t n = 0; n < N; n++) {
+        if (fabs(source[n] - mean) > peak) peak = (int)ceil(fabs(source[n] - mean));
+    }
+    double scale = 127.0 / peak;
+    for (size_t n = 0; n < N; n++) {
+        TEST_ASSERT_INT_WITHIN(2, lround((source[n] - mean) * scale), table[n]);
+    }
+}
+
+static void test_get_picks_richest_table_without_aliasing(void) {
+    const uint32_t nyquist = (1UL << 16) * N / 2;
+    for (uint32_t inc = 1; inc < (1UL << 24); inc = inc * 9 / 8 + 1) {
+        const int8_t* table = bank.get(WaveSaw, inc);
+        size_t level = (table - bank.tables[WaveSaw][0]) / N;
+        TEST_ASSERT_TRUE(level < WavetableBank::LEVELS);
+
+        if (level < WavetableBank::LEVELS - 1) {
+            TEST_ASSERT_TRUE((uint64_t)(WavetableBank::MAX_HARMONICS >> level) * inc <= nyquist);
+        }
+        if (level > 0) {
+            TEST_ASSERT_TRUE((uint64_t)(WavetableBank::MAX_HARMONICS >> (level - 1)) * inc > nyquist);
+        }
+    }
+    TEST_ASSERT_EQUAL_PTR(bank.tables[WaveSquare][0], bank.get(WaveSquare, 0));
+}
+
+static void test_names(void) {
+    TEST_ASSERT_EQUAL_STRING("sine", WavetableBank::get_name(WaveSine));
+    TEST_ASSERT_EQUAL_STRING("chebyshev", WavetableBank::get_name(WaveChebyshev));
+    TEST_ASSERT_EQUAL_STRING("unknown", WavetableBank::get_name(WaveCount));
+}
+
+int main(void) {
+    // A waveshaped sine with DC and a sharp step, like the Mozzi table
+    for (size_t n = 0; n < N; n++) {
+        double x = sin(2 * M_PI * n / N);
+        source[n] = (int8_t)lround(90 * tanh(3 * x) + (n < N / 8 ? 20 : 0) + 5);
+    }
+    bank.begin(source);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_tables_are_normalized);
+    RUN_TEST(test_levels_are_band_limited);
+    RUN_TEST(test_sine_and_saw_shapes);
+    RUN_TEST(test_full_level_reproduces_source);
+    RUN_TEST(test_get_picks_richest_table_without_aliasing);
+    RUN_TEST(test_names);
+    return UNITY_END();
+}